@@ -1,691 +1,7477 @@
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
 
 #ifdef _WIN32
     #include <windows.h>
-    #define CLEAR_SCREEN() system("cls")
+    #include <io.h>
+    #ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+        #define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+    #endif
 #else
-    #define CLEAR_SCREEN() system("clear")
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/ioctl.h>
+    #include <unistd.h>
+    #include <pthread.h>
+    #include <signal.h>
 #endif
 
+// Sequencias ANSI usadas pelo renderizador
+#define ANSI_CURSOR_INICIO "\x1b[H"
+#define ANSI_LIMPAR_TELA "\x1b[2J"
+#define ANSI_LIMPAR_LINHA "\x1b[2K"
+#define ANSI_LIMPAR_ABAIXO "\x1b[J"
+
+// Tamanhos da instrumentacao, usados nas estruturas abaixo
+#define NUM_FAIXAS_SONDAGEM 16
+#define NUM_FAIXAS_LATENCIA 40
+#define TAMANHO_SAIDA_JSON 16384
+
+// Separa dados escritos por threads diferentes
+#define LINHA_DE_CACHE 64
+
+// Nome de sala procedural: tipo e numero da sala
+#define TAMANHO_NOME_GERADO 40
+
 // --- Estruturas de dados
 // ---
 
-// Sala (comodo)
-typedef struct Sala {
-    char nome[50];
-    char pista[100];
-    struct Sala *esquerda;
-    struct Sala *direita;
-    int visitada; // marcar se a sala foi visitada
-} Sala;
+// Arena da sessao (alocador sequencial em blocos encadeados)
+typedef struct BlocoArena {
+    struct BlocoArena *anterior;
+    size_t capacidade;
+    size_t usado;
+    unsigned char *dados;
+} BlocoArena;
+
+typedef struct Arena {
+    BlocoArena *atual;
+    size_t tamanhoProximoBloco; // dobra a cada bloco novo, ate o limite
+    size_t alocacoes;           // pedidos atendidos, para medicao
+    size_t blocosAlocados;      // chamadas a malloc, para medicao
+} Arena;
+
+// Histograma de latencia de um tipo de acao: faixa k conta as acoes
+// que levaram de 2^k a 2^(k+1) - 1 nanossegundos
+typedef struct HistogramaLatencia {
+    uint64_t contagem;
+    uint64_t totalNanos;
+    uint64_t maximoNanos;
+    uint64_t faixas[NUM_FAIXAS_LATENCIA];
+} HistogramaLatencia;
+
+// Tipos de acao medidos em processarNavegacaoComPistas
+typedef enum TipoAcao {
+    ACAO_ESQUERDA,
+    ACAO_DIREITA,
+    ACAO_PASSAGEM,
+    ACAO_SAIR,
+    ACAO_BUSCA,
+    ACAO_DESFAZER,
+    ACAO_INVALIDA,
+    NUM_TIPOS_ACAO
+} TipoAcao;
+
+// Instrumentacao: contadores preenchidos so quando o ponteiro para esta
+// estrutura nao e NULL; desligada, cada ponto medido custa um teste
+typedef struct Estatisticas {
+    const char *destino;            // arquivo do JSON; "-" e a saida de erro
+    const struct Arena *arenaPrincipal;
+    uint64_t consultasHash;         // buscas em buscarIdPista
+    uint64_t sondagensHash;
+    uint64_t maiorSondagem;
+    uint64_t faixasSondagem[NUM_FAIXAS_SONDAGEM]; // 1, 2, ... e a ultima acumula o resto
+    HistogramaLatencia acoes[NUM_TIPOS_ACAO];
+} Estatisticas;
+
+// JSON montado sem alocacao nem stdio, para caber num tratador de sinal
+typedef struct SaidaJson {
+    char dados[TAMANHO_SAIDA_JSON];
+    size_t tamanho;
+} SaidaJson;
+
+// Parte fria da sala: textos so lidos para exibicao. Textos sao
+// deslocamentos no pool da mansao.
+typedef struct TextoSala {
+    uint32_t nome;
+    uint32_t pista;    // deslocamento 0 e a string vazia (sala sem pista)
+} TextoSala;
+
+// Saida de uma sala para outra. As saidas de cada sala ficam juntas no
+// vetor da mansao: primeiro a da esquerda, depois a da direita e por fim
+// as passagens sem lado, na ordem do cenario.
+typedef struct Saida {
+    uint32_t destino;
+    uint16_t custo;    // passos para atravessar; 1 num corredor comum
+    char tecla;        // 'e', 'd' ou 0 numa passagem
+    uint8_t reservado;
+} Saida;
+
+// Saida ainda sem ordem, como descrita no cenario, usada so na montagem
+typedef struct LigacaoSala {
+    uint32_t origem;
+    Saida saida;
+} LigacaoSala;
+
+// Par pista -> suspeito do cenario, tambem em deslocamentos do pool
+typedef struct ParPistaSuspeito {
+    uint32_t pista;
+    uint32_t suspeito;
+    float peso;        // quanto a pista pesa contra o suspeito; 1 por padrao
+} ParPistaSuspeito;
 
-// Pista (BST)
+// Mansao: salas, pares e textos, na arena ou mapeados direto do arquivo.
+// As salas ficam em ordem de largura (BFS) a partir do Hall, indice 0, e
+// o grafo de saidas e guardado em linhas comprimidas (CSR): as saidas da
+// sala i sao saidas[inicioSaidas[i] .. inicioSaidas[i + 1]), contiguas
+// no vetor. Nomes e pistas ficam separados, na parte fria.
+typedef struct Mansao {
+    const uint32_t *inicioSaidas; // numSalas + 1 posicoes em saidas
+    const Saida *saidas;
+    uint32_t numSaidas;
+    int arvore;               // saidas so 'e'/'d', uma entrada por sala e nenhum ciclo
+    const uint32_t *rumoAoHall; // proxima sala no caminho mais curto ao Hall; SEM_SALA no Hall
+    const TextoSala *textosSala;
+    uint32_t numSalas;
+    const ParPistaSuspeito *pares;
+    uint32_t numPares;
+    const char *textos;
+    uint32_t tamanhoTextos;
+    uint32_t culpado;         // deslocamento do nome; 0 se o cenario nao informa
+    const uint32_t *pistasInternadas; // id da pista de cada sala (SEM_PISTA se nao ha)
+    void *mapeamento;         // arquivo compilado mapeado (NULL se na arena)
+    size_t tamanhoMapeamento;
+    struct MansaoProcedural *procedural; // salas geradas sob demanda; NULL se montadas
+} Mansao;
+
+// Sala de uma mansao procedural, gerada da semente quando e alcancada
+typedef struct SalaGerada {
+    uint32_t sala;          // SEM_SALA numa via livre
+    uint32_t idPista;       // SEM_PISTA se a sala nao tem pista
+    uint32_t grau;
+    Saida saidas[2];
+    uint64_t ultimoUso;     // relogio do cache na ultima consulta
+    const char *pista;      // texto do conjunto de pares; "" sem pista
+    char nome[TAMANHO_NOME_GERADO];
+} SalaGerada;
+
+// Mansao procedural: so a semente define o mapa. As salas seguem a
+// numeracao de heap (filhos de s em 2s+1 e 2s+2), entao o caminho de volta
+// e o pai e nada precisa ser montado na partida. A mansao so diz o tamanho
+// do cache; as salas geradas ficam no CacheSalas de quem joga
+typedef struct MansaoProcedural {
+    uint32_t semente;
+    uint32_t numConjuntos;    // potencia de 2
+    const uint32_t *idsDosPares; // id da pista de cada par, resolvido na carga
+} MansaoProcedural;
+
+// Salas geradas de uma mansao procedural, num cache associativo de
+// VIAS_CACHE_PROCEDURAL vias por conjunto; a falta substitui a via usada
+// ha mais tempo e a sala despejada e gerada de novo, igual, se for
+// alcancada outra vez. Um por sessao ou trabalhador: a mansao continua
+// somente leitura e compartilhada entre as threads
+typedef struct CacheSalas {
+    SalaGerada *vias;
+    uint32_t mascaraConjuntos;
+    uint64_t relogio;
+    uint64_t geradas;         // inclui as geradas de novo depois de despejadas
+    uint64_t despejadas;
+} CacheSalas;
+
+// Item da fila de prioridade do caminho mais curto de volta ao Hall
+typedef struct ItemFilaRumo {
+    uint64_t distancia;
+    uint32_t sala;
+} ItemFilaRumo;
+
+// Montagem de uma mansao na arena (mapa embutido e cenarios em texto)
+typedef struct ConstrutorMansao {
+    Arena *arena;
+    TextoSala *salas;
+    uint32_t numSalas;
+    uint32_t capacidadeSalas;
+    LigacaoSala *ligacoes;
+    uint32_t numLigacoes;
+    uint32_t capacidadeLigacoes;
+    ParPistaSuspeito *pares;
+    uint32_t numPares;
+    uint32_t capacidadePares;
+    char *textos;
+    size_t tamanhoTextos;
+    size_t capacidadeTextos;
+    uint32_t culpado;
+} ConstrutorMansao;
+
+// Cabecalho do cenario compilado; as secoes vem logo em seguida no arquivo.
+// Alem do mapa, o arquivo traz o que a carga de um cenario em texto
+// calcula: rumos ao Hall, id da pista de cada sala e a tabela de pistas
+// ja ordenada, com entradas do hash e matriz de pesos
+typedef struct CabecalhoCenario {
+    char assinatura[4];
+    uint32_t versao;
+    uint32_t numSalas;
+    uint32_t numPares;
+    uint32_t tamanhoTextos;
+    uint32_t culpado;
+    uint32_t numSaidas;
+    uint32_t arvore;
+    uint32_t numPistas;
+    uint32_t numSuspeitos;
+    uint32_t passoPesos;
+    uint32_t capacidadeHash;
+    uint64_t deslocamentoInicioSaidas;
+    uint64_t deslocamentoSaidas;
+    uint64_t deslocamentoTextosSala;
+    uint64_t deslocamentoPares;
+    uint64_t deslocamentoRumos;
+    uint64_t deslocamentoPistasSala;
+    uint64_t deslocamentoPistas;
+    uint64_t deslocamentoSuspeitos;
+    uint64_t deslocamentoEntradas;
+    uint64_t deslocamentoPesos;
+    uint64_t deslocamentoTextos;
+} CabecalhoCenario;
+
+// Pista do cenario compilado: a PistaInternada com o texto em
+// deslocamento do pool, na ordem dos ids
+typedef struct PistaCenario {
+    uint32_t texto;
+    uint32_t hash;
+    int32_t indiceSuspeito;
+} PistaCenario;
+
+// Registro de visitas: um bit por sala visitada e contador de salas
+// distintas, mais um bit por sala cuja pista ja foi recolhida. Numa
+// mansao procedural seria um bit por sala possivel; ali as salas
+// visitadas ficam num conjunto por hash que cresce com a exploracao
+typedef struct RegistroVisitas {
+    uint64_t *bits;             // NULL no modo esparso
+    uint64_t *pistasColetadas;
+    uint32_t numSalas;
+    uint32_t salasVisitadas;
+    Arena *arena;               // modo esparso: onde o conjunto cresce
+    uint32_t *salasEsparsas;    // SEM_SALA nas posicoes livres
+    unsigned char *pistasEsparsas; // 1 quando a pista da sala ja foi recolhida
+    size_t capacidadeEsparsa;   // potencia de 2
+} RegistroVisitas;
+
+// Pista (BST balanceada AVL)
+// Ordenada pelo id internado, que segue a ordem alfabetica das pistas.
+// Persistente: um no ligado a uma versao nunca muda, a insercao copia so
+// o caminho ate a folha e divide o resto com as versoes anteriores
 typedef struct PistaNode {
-    char pista[100];
+    uint32_t idPista;
+    int altura; // altura da subarvore, usada no balanceamento
+    uint32_t referencias; // pais e versoes que apontam para o no
     struct PistaNode *esquerda;
     struct PistaNode *direita;
 } PistaNode;
 
-// Hash (pista -> suspeito)
+// Uma AVL com altura h tem pelo menos Fib(h+2)-1 nos: com ids de 32 bits
+// a altura nunca passa de 45, entao a pilha do iterador tem tamanho fixo
+#define ALTURA_MAXIMA_PISTAS 48
+
+// Cursor em ordem sobre o caderno, sem recursao: a pilha guarda os
+// ancestrais cuja subarvore direita ainda nao foi visitada
+typedef struct IteradorPistas {
+    const PistaNode *pilha[ALTURA_MAXIMA_PISTAS];
+    int topo;
+} IteradorPistas;
+
+// Palavras maiores sao indexadas pelos primeiros bytes; o limite tambem
+// fixa a profundidade da arvore radix e a pilha do cursor
+#define TAMANHO_MAXIMO_PALAVRA 64
+#define MAX_TERMOS_BUSCA 8
+#define MAX_RESULTADOS_BUSCA 20
+#define MAX_SUGESTOES_BUSCA 5
+
+// Texto indexado que contem a palavra; posicao e a ordem da palavra
+// no texto, usada para nao repetir o mesmo texto numa consulta
+typedef struct OcorrenciaBusca {
+    const char *texto;
+    uint32_t id;          // id da pista ou indice do suspeito
+    uint32_t posicao;
+    struct OcorrenciaBusca *proxima;
+    struct OcorrenciaBusca *anterior; // a remocao procura a partir do fim
+} OcorrenciaBusca;
+
+// No da arvore radix de palavras, sem diferenca de maiusculas. O rotulo
+// aponta para o proprio texto indexado, que ja vive numa arena ou no pool
+typedef struct NoBusca {
+    const char *rotulo;
+    uint32_t tamanhoRotulo;
+    uint32_t quantidade;          // ocorrencias que terminam neste no
+    uint32_t total;               // ocorrencias em toda a subarvore
+    struct NoBusca *filho;        // filhos em ordem alfabetica da primeira letra
+    struct NoBusca *irmao;
+    OcorrenciaBusca *ocorrencias; // na ordem em que foram indexadas
+    OcorrenciaBusca *ultima;
+} NoBusca;
+
+typedef struct IndiceBusca {
+    NoBusca raiz;
+    Arena *arena;
+    OcorrenciaBusca *livres; // ocorrencias removidas, reaproveitadas na insercao
+} IndiceBusca;
+
+// Percurso em pre-ordem de uma subarvore, com pilha de tamanho fixo:
+// cada nivel consome ao menos um byte da palavra
+typedef struct CursorBusca {
+    const NoBusca *pilha[TAMANHO_MAXIMO_PALAVRA + 2];
+    uint32_t base[TAMANHO_MAXIMO_PALAVRA + 2]; // bytes da palavra antes do rotulo
+    const NoBusca *inicio;
+    int topo;
+    char palavra[TAMANHO_MAXIMO_PALAVRA + 1];  // palavra do ultimo no devolvido
+} CursorBusca;
+
+typedef struct SugestaoBusca {
+    char palavra[TAMANHO_MAXIMO_PALAVRA + 1];
+    uint32_t ocorrencias;
+} SugestaoBusca;
+
+// Hash (pista -> suspeito), enderecamento aberto com sondagem linear
 typedef struct HashNode {
-    char pista[100];
-    char suspeito[50];
-    struct HashNode *proximo;
+    uint32_t hash;        // hash cacheado; 0 marca posicao vazia
+    uint32_t idPista;     // indice em TabelaHash.pistas
 } HashNode;
 
+// Pista internada: cada texto distinto recebe um id pequeno na carga;
+// as estruturas quentes guardam e comparam so o id
+typedef struct PistaInternada {
+    const char *texto;    // na arena ou no pool da mansao
+    uint32_t hash;
+    int indiceSuspeito;   // suspeito de maior peso; -1 quando nenhum
+} PistaInternada;
+
+// Peso lido na carga; vira a matriz depois que os ids sao renumerados
+typedef struct PesoDeclarado {
+    const char *pista;
+    int suspeito;
+    float peso;
+} PesoDeclarado;
+
+typedef struct TabelaHash {
+    HashNode *entradas;
+    size_t capacidade;    // sempre potencia de dois
+    size_t quantidade;
+    PistaInternada *pistas; // id -> texto e suspeito
+    uint32_t capacidadePistas;
+    const char **suspeitos; // registro de suspeitos, na ordem de cadastro
+    int numSuspeitos;
+    int capacidadeSuspeitos;
+    Arena *arena;
+    IndiceBusca indiceSuspeitos; // palavras dos nomes, para completar a acusacao
+    PesoDeclarado *pesosDeclarados; // na ordem da carga
+    uint32_t numPesosDeclarados;
+    uint32_t capacidadePesosDeclarados;
+    // Matriz pista x suspeito: uma linha de passoPesos floats por id,
+    // alinhada e completada com zeros ate um multiplo de LARGURA_VETOR_PESOS
+    float *pesos;
+    uint32_t passoPesos;
+    // Hash perfeito do caso embutido: com semente, a pista so pode estar
+    // em (hash * semente) >> deslocamento e a tabela e somente leitura
+    uint32_t sementePerfeita;
+    uint32_t deslocamentoPerfeito;
+    int indiceCulpado;    // -1 quando a tabela nao conhece o culpado
+    Estatisticas *estatisticas; // NULL desliga a contagem de sondagens
+} TabelaHash;
+
+// Versao do caderno: a raiz guarda uma referencia propria, entao a
+// arvore continua legivel enquanto a versao existir
+typedef struct VersaoCaderno {
+    PistaNode *raiz;
+    int totalPistas;
+    uint32_t sala;          // sala cuja pista criou a versao; SEM_SALA se nao veio de uma coleta
+    uint32_t idPista;       // pista que criou a versao; SEM_PISTA no caderno vazio
+    float *pontuacao;       // placar da versao, passoPesos posicoes
+} VersaoCaderno;
+
+// Caderno de investigacao: pistas coletadas e pontuacao por suspeito
+typedef struct Caderno {
+    PistaNode *raiz;
+    int totalPistas;
+    uint32_t salaDaVersao;
+    uint32_t pistaDaVersao;
+    float *pontuacao;       // soma das linhas de peso coletadas, passoPesos posicoes
+    int numSuspeitos;
+    const TabelaHash *tabela;
+    IndiceBusca palavras;   // palavras das pistas coletadas
+    PistaNode *livres;      // nos sem referencias, ligados pela esquerda
+    VersaoCaderno *historico; // anel com as versoes que ainda podem ser desfeitas
+    uint32_t inicioHistorico;
+    uint32_t numHistorico;
+} Caderno;
+
+// Posicao de um suspeito na classificacao do julgamento
+typedef struct PosicaoSuspeito {
+    float pontuacao;
+    int indice;
+} PosicaoSuspeito;
+
+// Texto acumulado em memoria, crescendo por realloc
+typedef struct BufferTexto {
+    char *dados;
+    size_t tamanho;
+    size_t capacidade;
+} BufferTexto;
+
+// Terminal: de onde vem a entrada e para onde vai o texto do jogo.
+// No modo headless a entrada e um roteiro em memoria e o texto pode
+// ser descartado; a transcricao registra cada entrada consumida.
+// No modo interativo o texto forma quadros: cada quadro e montado em
+// memoria e enviado num unico write(), redesenhando so as linhas que
+// mudaram desde o quadro anterior
+typedef struct Terminal {
+    const char *roteiro;   // NULL le da entrada padrao
+    size_t tamanhoRoteiro;
+    size_t posicao;
+    int interativo;        // limpa a tela e pausa entre as jogadas
+    FILE *saida;           // NULL descarta o texto do jogo
+    FILE *transcricao;     // NULL desliga a transcricao
+    BufferTexto quadro;    // texto ainda nao enviado
+    BufferTexto tela;      // o que esta na tela desde o ultimo redesenho
+    BufferTexto envio;     // sequencia montada para o write()
+    int quadroNovo;        // o proximo envio redesenha a partir do topo
+    uint64_t nanosEmEspera; // tempo bloqueado lendo a entrada padrao
+} Terminal;
+
+// Instantaneo salvo de uma investigacao. Depois do cabecalho vem o bitset
+// de salas visitadas, o de pistas recolhidas e os ids anotados no caderno
+typedef struct CabecalhoInstantaneo {
+    char assinatura[4];
+    uint32_t versao;
+    uint64_t impressaoMansao; // recusa salvamentos de outra mansao
+    uint64_t acoes;           // acoes do diario ja incluidas no instantaneo
+    uint32_t numSalas;
+    uint32_t salaAtual;
+    uint32_t salasVisitadas;
+    uint32_t numPistas;
+} CabecalhoInstantaneo;
+
+// Diario: cabecalho e depois um registro por sala em que o jogador entrou
+typedef struct CabecalhoDiario {
+    char assinatura[4];
+    uint32_t versao;
+    uint64_t impressaoMansao;
+} CabecalhoDiario;
+
+typedef struct RegistroDiario {
+    uint32_t sequencia; // numero da acao; uma lacuna encerra a releitura
+    uint32_t sala;
+} RegistroDiario;
+
+// Salvamento de uma sessao: instantaneo compacto mais diario so de acrescimo
+typedef struct Salvamento {
+    char *caminhoInstantaneo;
+    char *caminhoTemporario;    // o instantaneo novo e escrito aqui e renomeado
+    char *caminhoDiario;
+    char *caminhoDiretorio;     // sincronizado apos o rename do instantaneo
+    FILE *diario;               // aberto para acrescimo; NULL ate o primeiro instantaneo
+    uint64_t impressaoMansao;
+    uint64_t acoes;             // acoes desde o inicio da investigacao
+    uint64_t acoesNoInstantaneo;
+} Salvamento;
+
+// Eventos estruturados da partida, gravados num log binario
+typedef enum TipoEvento {
+    EVENTO_SALA,        // sala: onde entrou; valor: de onde veio
+    EVENTO_PISTA,       // sala, valor: id da pista; suspeito associado
+    EVENTO_REVISITA,    // sala ja vista; detalhe 1 quando o jogador aceita voltar
+    EVENTO_ACUSACAO,    // suspeito acusado; valor: posicao no placar; detalhe 1 se condenou
+    EVENTO_FIM_SESSAO,  // valor: pistas no caderno; detalhe 1 se condenou
+    NUM_TIPOS_EVENTO
+} TipoEvento;
+
+// Registro de 16 bytes, gravado como esta na memoria
+typedef struct Evento {
+    uint8_t tipo;
+    uint8_t detalhe;
+    uint16_t suspeito;  // SEM_SUSPEITO_EVENTO quando nao se aplica
+    uint32_t sessao;
+    uint32_t sala;
+    uint32_t valor;
+} Evento;
+
+// Log de eventos: cabecalho e depois os registros, na ordem em que o
+// gravador os retira dos aneis
+typedef struct CabecalhoEventos {
+    char assinatura[4];
+    uint32_t versao;
+    uint32_t tamanhoEvento;
+    uint32_t numAneis;
+} CabecalhoEventos;
+
+// Anel de um produtor e um consumidor, sem travas: so a thread do jogo
+// avanca a cabeca e so o gravador avanca a cauda. Cada indice tem sua
+// linha de cache para que os dois lados nao disputem a mesma
+typedef struct AnelEventos {
+    Evento *eventos;
+    size_t mascara;             // capacidade - 1, potencia de 2
+    _Alignas(LINHA_DE_CACHE) atomic_size_t cabeca;
+    size_t caudaVista;          // ultima cauda lida pelo produtor
+    atomic_uint_least64_t perdidos; // eventos descartados com o anel cheio
+    _Alignas(LINHA_DE_CACHE) atomic_size_t cauda;
+} AnelEventos;
+
+// Fluxo de eventos: um anel por thread de jogo e uma thread gravadora
+// que esvazia todos em lotes. O jogo nunca espera pelo disco
+typedef struct FluxoEventos {
+    AnelEventos *aneis;
+    int numAneis;
+    FILE *arquivo;
+    const char *caminho;
+    char *buffer;               // buffer do arquivo: um fwrite por lote
+    atomic_int encerrar;
+    uint64_t gravados;          // so o gravador escreve; lido depois do join
+    int falhou;
+#ifndef _WIN32
+    pthread_t gravador;
+    int gravadorAtivo;
+#endif
+} FluxoEventos;
+
+// Sessao de jogo: estado mutavel de um jogador sobre uma mansao compartilhada
+typedef struct Sessao {
+    Arena *arena;          // caderno e visitas; liberada ao fim da sessao
+    const Mansao *mansao;
+    const TabelaHash *tabelaHash;
+    Caderno caderno;
+    RegistroVisitas visitas;
+    CacheSalas *cache;      // salas geradas; NULL numa mansao montada
+    uint32_t salaAtual;
+    Terminal *terminal;
+    Salvamento *salvamento; // NULL nao salva
+    Estatisticas *estatisticas; // NULL desliga a instrumentacao
+    AnelEventos *eventos;   // NULL desliga os eventos
+    uint32_t numero;        // sessao nos eventos
+} Sessao;
+
+// Pool de sessoes headless: os trabalhadores retiram indices de sessao
+// de um contador atomico. Mansao e tabela sao somente leitura e
+// compartilhadas sem travas; cada trabalhador tem sua propria arena
+typedef struct PoolSessoes {
+    const Mansao *mansao;
+    const TabelaHash *tabelaHash;
+    const char *roteiro;
+    size_t tamanhoRoteiro;
+    long totalSessoes;
+    atomic_long proximaSessao;
+    atomic_long condenacoes;
+    FluxoEventos *eventos;  // NULL sem eventos; um anel por trabalhador
+    atomic_int proximoAnel;
+} PoolSessoes;
+
+// Formato das mansoes sinteticas usadas na suite de benchmark
+typedef enum FormaMansao {
+    FORMA_BALANCEADA,  // arvore completa
+    FORMA_DEGENERADA,  // corredor so com caminhos a esquerda
+    FORMA_ALEATORIA,   // cada sala nova ligada a um caminho livre sorteado
+    FORMA_LABIRINTO,   // aleatoria mais passagens sorteadas, com ciclos e atalhos
+    NUM_FORMAS_MANSAO
+} FormaMansao;
+
+// Ponto de partida de um caso da suite: arena e memoria residente no inicio
+typedef struct MarcoBenchmark {
+    Arena arena;
+    long rssKb;
+} MarcoBenchmark;
+
+// Candidato a rota de um suspeito: sala onde uma pista dele e recolhida
+// e quantos movimentos a rota gasta com ela
+typedef struct CandidatoRota {
+    uint32_t custo;
+    uint32_t sala;     // SEM_SALA quando nao ha candidato
+    uint32_t idPista;
+} CandidatoRota;
+
+// Melhores rotas de um suspeito. Os pares guardam os dois melhores
+// candidatos com pistas distintas, o que basta para combinar duas descidas
+typedef struct MelhoresRotas {
+    CandidatoRota unica;       // uma descida que ja passa por duas pistas do suspeito
+    CandidatoRota parcial[2];  // ultima descida, que para na sala
+    CandidatoRota completa[2]; // descida ate uma folha, com volta ao Hall
+} MelhoresRotas;
+
+// Pistas distintas de um suspeito no caminho do Hall ate a sala atual
+typedef struct PistasNoCaminho {
+    uint32_t ids[2];
+    int quantidade;
+} PistasNoCaminho;
+
+// Planejador de rotas: tabelas por sala calculadas uma vez e lidas sem
+// travas por todas as threads. As subarvores da fronteira sao retiradas
+// de um contador atomico, como no pool de sessoes
+typedef struct PlanoRotas {
+    const Mansao *mansao;
+    const TabelaHash *tabelaHash;
+    uint32_t *pai;              // SEM_SALA no Hall
+    uint32_t *profundidade;
+    uint32_t *folhaMaisProxima; // profundidade da folha mais rasa da subarvore
+    uint32_t inicioFronteira;   // um nivel inteiro, contiguo na ordem BFS
+    uint32_t fimFronteira;
+    atomic_uint proximaRaiz;
+} PlanoRotas;
+
+typedef struct TrabalhadorRotas {
+    PlanoRotas *plano;
+    MelhoresRotas *melhores;   // resultado parcial, um por suspeito
+} TrabalhadorRotas;
+
+// Como o jogador simulado escolhe a saida a cada movimento
+typedef enum PoliticaSimulacao {
+    POLITICA_ALEATORIA, // qualquer saida, com a mesma chance
+    POLITICA_GULOSA,    // sala ainda nao visitada quando houver
+    NUM_POLITICAS_SIMULACAO
+} PoliticaSimulacao;
+
+// Faixa [inicio, fim) de sessoes de um trabalhador num so inteiro, inicio
+// nos 32 bits altos: o dono retira lotes do inicio e quem ficou sem
+// trabalho rouba a metade do fim, cada um com um compare-and-swap.
+// Uma linha de cache por faixa, para os donos nao disputarem a mesma
+typedef struct FaixaSimulacao {
+    _Alignas(LINHA_DE_CACHE) atomic_uint_least64_t faixa;
+} FaixaSimulacao;
+
+// Contagens de um trabalhador, somadas pela thread principal no fim
+typedef struct ResultadoSimulacao {
+    uint64_t sessoes;
+    uint64_t condenacoes;
+    uint64_t acertos;           // culpado real acusado e condenado
+    uint64_t salasVisitadas;    // soma, para a media
+    uint64_t movimentos;
+    uint64_t roubos;            // lotes tirados da faixa de outro trabalhador
+    uint64_t *pistasPorSessao;  // [k]: sessoes que terminaram com k pistas
+    uint64_t *acusacoes;        // por suspeito
+    uint64_t *condenados;
+    uint64_t *condenaveis;      // sessoes em que a pontuacao bastaria para condenar
+} ResultadoSimulacao;
+
+// Simulacao Monte Carlo: mansao e tabela somente leitura, como no pool de
+// sessoes; cada sessao sorteia a partir de semente e indice, entao o
+// resultado nao depende de qual thread a jogou
+typedef struct Simulacao {
+    const Mansao *mansao;
+    const TabelaHash *tabelaHash;
+    PoliticaSimulacao politica;
+    uint32_t passos;            // movimentos antes do julgamento
+    uint32_t semente;
+    int indiceCulpado;          // -1 quando o caso nao informa
+    int numTrabalhadores;
+    FaixaSimulacao *faixas;     // uma por trabalhador
+    FluxoEventos *eventos;      // NULL sem eventos; anel do indice do trabalhador
+} Simulacao;
+
+typedef struct TrabalhadorSimulacao {
+    Simulacao *simulacao;
+    int indice;
+    ResultadoSimulacao resultado;
+} TrabalhadorSimulacao;
+
 // Constantes
-#define TAMANHO_HASH 10
+#define CAPACIDADE_INICIAL_HASH 32
+#define CARGA_MAXIMA_HASH_NUM 7   // cresce ao passar de 70% de ocupacao
+#define CARGA_MAXIMA_HASH_DEN 10
+#define TAMANHO_BLOCO_ARENA 4096
+#define TAMANHO_MAXIMO_BLOCO_ARENA (1024 * 1024)
+#define ALINHAMENTO_ARENA 16
+#define SEM_SALA UINT32_MAX
+#define SALA_HALL 0
+#define SEM_PISTA UINT32_MAX
+#define ASSINATURA_CENARIO "DQC1"
+#define ASSINATURA_INSTANTANEO "DQS1"
+#define ASSINATURA_DIARIO "DQJ1"
+#define VERSAO_SALVAMENTO 1
+#define INTERVALO_INSTANTANEO 1024 // acoes no diario antes de um novo instantaneo
+#define VERSAO_CENARIO 5
+#define MAXIMO_SALAS (1u << 30)
+#define MAXIMO_SAIDAS (1u << 31)
+#define CUSTO_MAXIMO_SAIDA 65535
+#define NUM_SUSPEITOS_SINTETICOS 8
+#define LIMIAR_CONDENACAO 2       // pontuacao que condena um suspeito (pistas de peso 1)
+#define LARGURA_VETOR_PESOS 8     // floats por bloco da matriz: 32 bytes, um registrador AVX
+#define TOLERANCIA_PESO 1e-4f     // folga do limiar para somas como 10 x 0.2
+#define PESO_MAXIMO 1e6f
+#define BITS_MAXIMOS_HASH_EMBUTIDO 12 // o gerador desiste acima de 4096 posicoes
+#define TENTATIVAS_HASH_EMBUTIDO 100000 // sementes sorteadas por tamanho de tabela
+#define FRONTEIRA_POR_THREAD 8    // subarvores por thread no planejador de rotas
+#define NIVEIS_MAXIMOS_FRONTEIRA 32
+#define LOTE_SIMULACAO 64         // sessoes retiradas da faixa de uma vez
+#define PASSOS_SIMULACAO 64
+#define VIAS_CACHE_PROCEDURAL 4   // o codigo do jogo segura no maximo duas salas
+#define CAPACIDADE_CACHE_PROCEDURAL 4096
+#define SALAS_PROCEDURAIS (SEM_SALA - 1)
+#define CAPACIDADE_INICIAL_VISITAS 64
+#define MAXIMO_VERSOES_CADERNO 64 // pistas que ainda podem ser desfeitas
+#define ASSINATURA_EVENTOS "DQE1"
+#define VERSAO_EVENTOS 1
+#define CAPACIDADE_ANEL_EVENTOS (1u << 16) // 1 MB de eventos por thread de jogo
+#define TAMANHO_BUFFER_EVENTOS (1u << 20)
+#define PAUSA_GRAVADOR_EVENTOS 1000000L   // ns de espera com os aneis vazios
+#define SEM_SUSPEITO_EVENTO UINT16_MAX
+
+// O planejador de rotas combina no maximo duas descidas
+_Static_assert(LIMIAR_CONDENACAO >= 1 && LIMIAR_CONDENACAO <= 2, "LIMIAR_CONDENACAO deve ser 1 ou 2");
 
 // Protótipos
 
+// Arena
+void inicializarArena(Arena* arena);
+void* alocarNaArena(Arena* arena, size_t tamanho);
+void* alocarAlinhadoNaArena(Arena* arena, size_t tamanho, size_t alinhamento);
+void reiniciarArena(Arena* arena);
+void liberarArena(Arena* arena);
+
 // Mapa
-Sala* criarSala(const char* nome, const char* pista);
-Sala* montarMapaMansao();
-void construirEstruturaMapa(Sala* hallEntrada, Sala* salaEstar, Sala* cozinha, Sala* biblioteca, 
-                           Sala* quartoHospedes, Sala* jardim, Sala* salaJantar, Sala* escritorio, 
-                           Sala* porao, Sala* terraco, Sala* quartoPrincipal, Sala* banheiro);
-
-// Pistas (BST)
-PistaNode* criarNoPista(const char* pista);
-PistaNode* inserirPista(PistaNode* raiz, const char* pista);
-void exibirPistasEmOrdem(PistaNode* raiz);
-void liberarArvorePistas(PistaNode* raiz);
+void iniciarConstrucaoMansao(ConstrutorMansao* construtor, Arena* arena, uint32_t numSalas, uint32_t numLigacoes, uint32_t numPares, size_t capacidadeTextos);
+uint32_t guardarTextoNaMansao(ConstrutorMansao* construtor, const char* texto);
+uint32_t criarSala(ConstrutorMansao* construtor, const char* nome, const char* pista);
+void adicionarParPista(ConstrutorMansao* construtor, const char* pista, const char* suspeito, float peso);
+void ligarSalas(ConstrutorMansao* construtor, uint32_t origem, char tecla, uint32_t destino, uint32_t custo);
+int concluirMansao(ConstrutorMansao* construtor, Mansao* mansao);
+int itemFilaRumoMenor(ItemFilaRumo a, ItemFilaRumo b);
+void empilharFilaRumo(ItemFilaRumo* fila, size_t* tamanho, ItemFilaRumo item);
+ItemFilaRumo retirarFilaRumo(ItemFilaRumo* fila, size_t* tamanho);
+void calcularRumosAoHall(Arena* arena, Mansao* mansao);
+int validarSaidas(const uint32_t* inicioSaidas, const Saida* saidas, uint32_t numSalas, uint32_t numSaidas, int arvore);
+const char* textoDaMansao(const Mansao* mansao, uint32_t deslocamento);
+const char* nomeSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+const char* pistaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+const Saida* saidasDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+uint32_t grauDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+uint32_t salaPelaTecla(const Mansao* mansao, CacheSalas* cache, uint32_t sala, char tecla);
+uint32_t salaEsquerda(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+uint32_t salaDireita(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+uint32_t idPistaDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+uint32_t rumoDaSala(const Mansao* mansao, uint32_t sala);
+
+// Mansao procedural
+uint32_t misturarSemente(uint32_t semente, uint32_t valor);
+void criarMansaoProcedural(Arena* arena, Mansao* mansao, uint32_t semente, uint32_t numSalas, uint32_t capacidadeCache);
+void gerarSala(const Mansao* mansao, uint32_t sala, SalaGerada* destino);
+CacheSalas* criarCacheSalas(Arena* arena, const Mansao* mansao);
+void relatarCacheSalas(FILE* saida, const Mansao* mansao, const CacheSalas* cache);
+const SalaGerada* salaGerada(const Mansao* mansao, CacheSalas* cache, uint32_t sala);
+
+// Cenarios
+char* lerArquivoNaArena(Arena* arena, const char* caminho, size_t* tamanho);
+char* aparaTexto(char* texto);
+int linhaComecaCom(const char* linha, const char* tipo);
+int separarCampos(char* linha, char* campos[], int maximo);
+int carregarCenarioTexto(Arena* arena, char* conteudo, size_t tamanho, Mansao* mansao);
+int secaoNoArquivo(uint64_t deslocamento, uint64_t tamanhoSecao, uint64_t alinhamento, size_t tamanho);
+int validarConteudoCenario(const unsigned char* dados);
+int validarCenarioBinario(const unsigned char* dados, size_t tamanho);
+void* mapearArquivo(const char* caminho, size_t* tamanho);
+void desmapearArquivo(void* dados, size_t tamanho);
+int mapearCenarioBinario(const char* caminho, Mansao* mansao);
+TabelaHash* abrirTabelaDoCenario(Arena* arena, const Mansao* mansao);
+int carregarCenario(Arena* arena, const char* caminho, Mansao* mansao);
+uint64_t alinharDeslocamento(uint64_t deslocamento, uint64_t alinhamento);
+int gravarSecao(FILE* arquivo, uint64_t* posicao, uint64_t deslocamento, const void* dados, size_t tamanho);
+int compilarCenario(const char* entrada, const char* saida);
+void carregarPistasDaMansao(TabelaHash* tabela, const Mansao* mansao);
+void internarPistasDaMansao(TabelaHash* tabela, Mansao* mansao);
+void liberarMansao(Mansao* mansao);
+
+// Pistas (BST balanceada AVL)
+PistaNode* criarNoPista(Arena* arena, PistaNode** livres, uint32_t idPista);
+PistaNode* reterPista(PistaNode* no);
+void soltarPista(PistaNode** livres, PistaNode* no);
+int alturaPista(PistaNode* no);
+void atualizarAlturaPista(PistaNode* no);
+PistaNode* rotacionarDireita(PistaNode* raiz);
+PistaNode* rotacionarEsquerda(PistaNode* raiz);
+PistaNode* balancearPista(PistaNode* raiz);
+PistaNode* copiarCaminhoPista(Arena* arena, PistaNode** livres, const PistaNode* raiz, uint32_t idPista);
+PistaNode* inserirPista(Arena* arena, PistaNode** livres, PistaNode* raiz, uint32_t idPista);
+PistaNode* buscarPista(PistaNode* raiz, uint32_t idPista);
+PistaNode* ligarPistasOrdenadas(PistaNode* nos, const uint32_t* ids, uint32_t inicio, uint32_t fim);
+PistaNode* construirPistasOrdenadas(Arena* arena, const uint32_t* ids, uint32_t quantidade);
+void inicializarCaderno(Caderno* caderno, Arena* arena, const TabelaHash* tabela);
+void guardarVersaoNoHistorico(Caderno* caderno);
+void limparHistoricoCaderno(Caderno* caderno);
+int registrarPistaNoCaderno(Arena* arena, Caderno* caderno, uint32_t idPista, uint32_t sala);
+int desfazerPistaNoCaderno(Caderno* caderno, uint32_t* sala);
+int carregarPistasNoCaderno(Arena* arena, Caderno* caderno, const uint32_t* ids, uint32_t quantidade);
+void descerPelaEsquerda(IteradorPistas* iterador, const PistaNode* no);
+void iniciarIteradorPistas(IteradorPistas* iterador, const PistaNode* raiz);
+const PistaNode* proximaPista(IteradorPistas* iterador);
+void exibirPistasEmOrdem(Terminal* terminal, const TabelaHash* tabela, PistaNode* raiz);
+
+// Busca (arvore radix de palavras)
+int caractereDePalavra(unsigned char c);
+char minuscula(char c);
+void inicializarIndiceBusca(IndiceBusca* indice, Arena* arena);
+NoBusca* criarNoBusca(IndiceBusca* indice, const char* rotulo, uint32_t tamanho);
+void indexarPalavra(IndiceBusca* indice, const char* palavra, uint32_t tamanho, const char* texto, uint32_t id, uint32_t posicao);
+void indexarTexto(IndiceBusca* indice, const char* texto, uint32_t id);
+int removerPalavra(IndiceBusca* indice, const char* palavra, uint32_t tamanho, uint32_t id, uint32_t posicao);
+void removerTexto(IndiceBusca* indice, const char* texto, uint32_t id);
+uint32_t iniciarCursorBusca(CursorBusca* cursor, const IndiceBusca* indice, const char* prefixo, uint32_t tamanho);
+const NoBusca* proximoNoBusca(CursorBusca* cursor);
+int primeiraPalavraComPrefixo(const char* texto, const char* prefixo, uint32_t tamanho);
+int separarTermos(const char* consulta, const char* termos[], uint32_t tamanhos[], int maximo);
+int consultarIndiceBusca(const IndiceBusca* indice, const char* consulta, uint32_t* ids, int maximo);
+int completarPalavra(const IndiceBusca* indice, const char* prefixo, uint32_t tamanho, SugestaoBusca* sugestoes, int maximo);
 
 // Hash
-HashNode** criarTabelaHash(int tamanho);
-int calcularHash(const char* pista, int tamanho);
-void inserirNaHash(HashNode** tabela, int tamanho, const char* pista, const char* suspeito);
-char* encontrarSuspeito(HashNode** tabela, int tamanho, const char* pista);
-void inicializarTabelaHash(HashNode** tabela, int tamanho);
-void liberarTabelaHash(HashNode** tabela, int tamanho);
-void revelarCulpadoReal();
+char* copiarTextoNaArena(Arena* arena, const char* texto);
+TabelaHash* criarTabelaHash(Arena* arena, size_t capacidadeInicial);
+uint32_t calcularHash(const char* pista);
+void redimensionarTabelaHash(TabelaHash* tabela, size_t novaCapacidade);
+void reservarTabelaHash(TabelaHash* tabela, size_t quantidade);
+int registrarSuspeito(TabelaHash* tabela, const char* suspeito);
+int buscarIndiceSuspeitoPorNome(const TabelaHash* tabela, const char* suspeito);
+uint32_t internarPista(TabelaHash* tabela, const char* pista);
+int compararPistasInternadas(const void* a, const void* b);
+void ordenarPistasInternadas(TabelaHash* tabela);
+int compararTextos(const void* a, const void* b);
+uint32_t internarPistasEmLote(TabelaHash* tabela, const char** textos, uint32_t quantidade);
+void inserirNaHash(TabelaHash* tabela, const char* pista, const char* suspeito);
+void inserirNaHashReferencia(TabelaHash* tabela, const char* pista, const char* suspeito, float peso);
+void declararPeso(TabelaHash* tabela, const char* pista, int suspeito, float peso);
+size_t posicaoInicialHash(const TabelaHash* tabela, uint32_t hash);
+uint32_t buscarIdPista(const TabelaHash* tabela, const char* pista);
+const char* textoPista(const TabelaHash* tabela, uint32_t idPista);
+int indiceSuspeitoDaPista(const TabelaHash* tabela, uint32_t idPista);
+const char* encontrarSuspeito(const TabelaHash* tabela, const char* pista);
+void revelarCulpadoReal(Terminal* terminal, const Mansao* mansao, const TabelaHash* tabela);
+
+// Caso embutido (tabelas geradas)
+TabelaHash* abrirTabelaEmbutida(Arena* arena);
+void montarMapaMansao(Arena* arena, Mansao* mansao);
+void escreverLiteralC(FILE* saida, const char* texto);
+int gerarCasoEmbutido(FILE* saida);
+
+// Evidencias (matriz pista x suspeito)
+void montarMatrizEvidencias(TabelaHash* tabela);
+const float* linhaDePesos(const TabelaHash* tabela, uint32_t idPista);
+float* criarVetorPontuacao(Arena* arena, const TabelaHash* tabela);
+void somarLinhaPesos(float* restrict destino, const float* restrict linha, uint32_t passo);
+void pontuarCaderno(const Caderno* caderno, float* pontuacao);
+int compararPosicaoSuspeito(const void* a, const void* b);
+void classificarSuspeitos(const float* pontuacao, int numSuspeitos, PosicaoSuspeito* classificacao);
 
 // Interface
-void limparTela();
-void pausarExecucao();
-void mostrarTitulo();
-void mostrarBoasVindas();
-void mostrarDespedida();
-void mostrarStatusInvestigacao(PistaNode* raizPistas);
+void iniciarTerminal(Terminal* terminal, const char* roteiro, size_t tamanhoRoteiro, int interativo, FILE* saida, FILE* transcricao);
+void liberarTerminal(Terminal* terminal);
+void reservarBuffer(BufferTexto* buffer, size_t adicional);
+void anexarTexto(BufferTexto* buffer, const char* texto, size_t tamanho);
+int linhasDoTerminal();
+void escreverNoTerminal(Terminal* terminal, const char* dados, size_t tamanho);
+void apresentarQuadro(Terminal* terminal);
+void exibir(Terminal* terminal, const char* formato, ...);
+int lerLinha(Terminal* terminal, char* destino, size_t tamanho);
+void transcrever(Sessao* sessao, const char* entrada);
+char lerOpcao(Sessao* sessao);
+void lerComando(Sessao* sessao, char* destino, size_t tamanho);
+void lerNome(Sessao* sessao, char* destino, size_t tamanho);
+void limparTela(Terminal* terminal);
+void pausarExecucao(Terminal* terminal);
+void mostrarTitulo(Terminal* terminal);
+void mostrarBoasVindas(Terminal* terminal);
+void mostrarDespedida(Terminal* terminal);
+void mostrarStatusInvestigacao(Sessao* sessao);
 
 // Navegação
-void explorarSalasComPistas(Sala* salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash, Sala* hallEntrada);
-void processarNavegacaoComPistas(Sala** salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash, char opcao, Sala* hallEntrada);
-void mostrarCaminhosDisponiveis(Sala* salaAtual);
-int verificarFimDoCaminho(Sala* salaAtual);
-void coletarPista(Sala* salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash);
-void verificarPistaColetada(Sala* salaAtual);
-void marcarSalaComoVisitada(Sala* salaAtual);
-void resetarVisitas(Sala* raiz);
-int todasSalasVisitadas(Sala* raiz);
+void iniciarSessao(Sessao* sessao, Arena* arena, const Mansao* mansao, CacheSalas* cache, const TabelaHash* tabelaHash, Terminal* terminal);
+void explorarSalasComPistas(Sessao* sessao);
+void buscarNoCaderno(Sessao* sessao);
+void desfazerUltimaPista(Sessao* sessao);
+void processarNavegacaoComPistas(Sessao* sessao, const char* comando);
+void entrarPelaSaida(Sessao* sessao, uint32_t destino);
+void voltarAoHall(Sessao* sessao, int exibirCaminho);
+void mostrarCaminhosDisponiveis(Sessao* sessao);
+int verificarFimDoCaminho(const Mansao* mansao, CacheSalas* cache, uint32_t salaAtual);
+void anotarPistaDaSala(Sessao* sessao, uint32_t sala);
+int desfazerPistaDaSessao(Sessao* sessao, uint32_t* sala);
+void coletarPista(Sessao* sessao);
+void verificarPistaColetada(Sessao* sessao);
+int salaTemPistaPendente(const Mansao* mansao, CacheSalas* cache, const RegistroVisitas* visitas, uint32_t sala);
+void inicializarRegistroVisitas(RegistroVisitas* visitas, Arena* arena, uint32_t numSalas);
+void inicializarVisitasEsparsas(RegistroVisitas* visitas, Arena* arena, uint32_t numSalas);
+size_t posicaoVisitaEsparsa(const RegistroVisitas* visitas, uint32_t sala);
+void crescerVisitasEsparsas(RegistroVisitas* visitas);
+void marcarSalaComoVisitada(RegistroVisitas* visitas, uint32_t sala);
+int salaFoiVisitada(const RegistroVisitas* visitas, uint32_t sala);
+int pistaFoiColetada(const RegistroVisitas* visitas, uint32_t sala);
+void marcarPistaColetada(RegistroVisitas* visitas, uint32_t sala);
+void desmarcarPistaColetada(RegistroVisitas* visitas, uint32_t sala);
+void resetarVisitas(RegistroVisitas* visitas);
+int todasSalasVisitadas(const RegistroVisitas* visitas);
 
 // Julgamento final
-void verificarSuspeitoFinal(PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash);
-int contarPistasPorSuspeito(PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash, const char* suspeito);
-void listarSuspeitos();
+int resolverSuspeito(const TabelaHash* tabela, const char* digitado, int* candidatos, int maximo);
+int verificarSuspeitoFinal(Sessao* sessao);
+float pontuacaoDoSuspeito(const Caderno* caderno, const TabelaHash* tabelaHash, const char* suspeito);
+void listarSuspeitos(Terminal* terminal, const TabelaHash* tabelaHash, const PosicaoSuspeito* classificacao);
 
 // Relatórios e estatísticas
-void gerarRelatorioFinal(PistaNode* raizPistas);
-int contarTotalPistas(PistaNode* raiz);
+void gerarRelatorioFinal(Sessao* sessao);
 
 // Finalização e memória
-void liberarArvoreSalas(Sala* raiz);
-void finalizarJogo(Sala* hallEntrada, PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash);
+int finalizarJogo(Sessao* sessao);
+int jogarSessao(Sessao* sessao);
 
-// Implementação
+// Salvamento
+uint64_t impressaoDigitalMansao(const Mansao* mansao);
+char* caminhoComExtensao(Arena* arena, const char* base, const char* extensao);
+char* diretorioDoCaminho(Arena* arena, const char* caminho);
+int sincronizarArquivo(FILE* arquivo, int soDados);
+int sincronizarDiretorio(const char* caminho);
+void abrirSalvamento(Salvamento* salvamento, Arena* arena, const char* base, const Mansao* mansao);
+void fecharSalvamento(Salvamento* salvamento);
+void escreverIdsEmOrdem(FILE* arquivo, const PistaNode* raiz);
+int gravarInstantaneo(Sessao* sessao);
+void registrarAcao(Sessao* sessao, uint32_t sala);
+int restaurarInstantaneo(Sessao* sessao, const unsigned char* dados, size_t tamanho);
+int aplicarMovimento(Sessao* sessao, uint32_t sala);
+int retomarSessao(Sessao* sessao, FILE* relatorio);
 
-// --- Mapa
+// Instrumentacao
+void iniciarEstatisticas(Estatisticas* estatisticas, const char* destino, const Arena* arenaPrincipal);
+void registrarSondagens(Estatisticas* estatisticas, uint64_t sondagens);
+TipoAcao tipoDaAcao(const char* comando);
+void registrarLatenciaAcao(Estatisticas* estatisticas, TipoAcao tipo, uint64_t nanos);
+void medirAglomeradosHash(const TabelaHash* tabela, uint64_t* maiorAglomerado, uint64_t* sondagensChaves);
+void anexarJson(SaidaJson* saida, const char* texto);
+void anexarNumeroJson(SaidaJson* saida, uint64_t numero);
+void anexarCampoJson(SaidaJson* saida, const char* nome, uint64_t valor, int ultimo);
+void montarEstatisticasJson(const Sessao* sessao, SaidaJson* saida);
+void despejarEstatisticas(const Sessao* sessao);
+#ifndef _WIN32
+void tratarSinalEstatisticas(int sinal);
+#endif
+void instrumentarSessao(Sessao* sessao, Estatisticas* estatisticas);
+void encerrarInstrumentacao(Sessao* sessao);
 
-Sala* criarSala(const char* nome, const char* pista) {
-    Sala* novaSala = (Sala*)malloc(sizeof(Sala));
-    if (novaSala == NULL) {
-        printf("Erro: Nao foi possivel alocar memoria para a sala.\n");
-        exit(1);
-    }
-    
-    strcpy(novaSala->nome, nome);
-    strcpy(novaSala->pista, pista);
-    novaSala->esquerda = NULL;
-    novaSala->direita = NULL;
-    novaSala->visitada = 0; // Inicialmente não visitada
-    
-    return novaSala;
-}
+// Eventos
+const char* nomeTipoEvento(TipoEvento tipo);
+int abrirFluxoEventos(FluxoEventos* fluxo, Arena* arena, const char* caminho, int numAneis);
+void publicarEvento(AnelEventos* anel, const Evento* evento);
+void registrarEvento(Sessao* sessao, TipoEvento tipo, uint32_t sala, uint32_t valor, int suspeito, int detalhe);
+size_t drenarAnelEventos(FluxoEventos* fluxo, AnelEventos* anel);
+size_t drenarFluxoEventos(FluxoEventos* fluxo);
+void* gravadorEventos(void* argumento);
+int fecharFluxoEventos(FluxoEventos* fluxo, FILE* relatorio);
+int exibirLogEventos(const char* caminho);
 
-Sala* montarMapaMansao() {
-    struct {
-        const char* nome;
-        const char* pista;
-    } salas_dados[] = {
-        {"Hall de Entrada", "Porta principal arrombada"},
-        {"Sala de Estar", "Copo de vinho pela metade"},
-        {"Cozinha", "Faca desaparecida do bloco"},
-        {"Biblioteca", "Livro sobre venenos aberto"},
-        {"Quarto de Hospedes", "Mala com documentos secretos"},
-        {"Jardim", "Pegadas de barro frescas"},
-        {"Sala de Jantar", "Cadeira desencaixada da mesa"},
-        {"Escritorio Secreto", "Cofre aberto e vazio"},
-        {"Porao", "Manchas escuras no chao"},
-        {"Terraco", "Cinzas de cigarro raro"},
-        {"Quarto Principal", "Relogio parado as 23:45"},
-        {"Banheiro", "Toalha com manchas vermelhas"}
-    };
+// Modo headless
+int executarRoteiro(const Mansao* mansao, const TabelaHash* tabelaHash, const char* roteiro, size_t tamanhoRoteiro,
+                    FILE* saida, FILE* transcricao, long repeticoes, Salvamento* salvamento,
+                    Estatisticas* estatisticas, FluxoEventos* eventos);
+void* trabalhadorSessoes(void* argumento);
+int executarSessoesParalelas(const Mansao* mansao, const TabelaHash* tabelaHash, const char* roteiro, size_t tamanhoRoteiro,
+                             long totalSessoes, int numThreads, FluxoEventos* eventos);
 
-    const int NUM_SALAS = sizeof(salas_dados) / sizeof(salas_dados[0]);
-    Sala* salas[NUM_SALAS];
+// Planejador de rotas
+int numeroDeNucleos();
+int candidatoRotaMenor(const CandidatoRota* a, const CandidatoRota* b);
+void inserirCandidatoRota(CandidatoRota melhores[2], CandidatoRota candidato);
+void prepararPlanoRotas(PlanoRotas* plano, Arena* arena, const Mansao* mansao, const TabelaHash* tabelaHash, int numThreads);
+void avaliarSalaNaRota(const PlanoRotas* plano, MelhoresRotas* rotas, uint32_t sala, uint32_t idPista, int temOutraPista);
+int caminhoTemOutraPista(const PlanoRotas* plano, uint32_t sala, uint32_t idPista, int suspeito);
+int anotarPistaNoCaminho(PistasNoCaminho* caminho, uint32_t idPista);
+void* trabalhadorRotas(void* argumento);
+MelhoresRotas* calcularMelhoresRotas(PlanoRotas* plano, Arena* arena, int numThreads);
+void anexarCaminhoAteSala(BufferTexto* rota, const PlanoRotas* plano, uint32_t sala);
+void anexarDescidaAteFolha(BufferTexto* rota, const PlanoRotas* plano, uint32_t sala);
+long montarRota(const PlanoRotas* plano, const MelhoresRotas* rotas, BufferTexto* rota);
+int pesosSaoUnitarios(const TabelaHash* tabelaHash);
+int planejarRotas(const Mansao* mansao, const TabelaHash* tabelaHash, int numThreads);
 
-    for (int i = 0; i < NUM_SALAS; i++) {
-        salas[i] = criarSala(salas_dados[i].nome, salas_dados[i].pista);
-    }
+// Simulacao Monte Carlo
+const char* nomePoliticaSimulacao(PoliticaSimulacao politica);
+int lerPoliticaSimulacao(const char* texto, PoliticaSimulacao* politica);
+uint64_t empacotarFaixa(uint32_t inicio, uint32_t fim);
+int retirarLote(FaixaSimulacao* faixa, uint32_t* inicio, uint32_t* fim);
+int roubarLotes(Simulacao* simulacao, int ladrao, uint32_t* inicio, uint32_t* fim);
+uint32_t escolherSaida(const Sessao* sessao, PoliticaSimulacao politica, uint32_t* estado);
+void responderNoTerminal(Terminal* terminal, const char* resposta, size_t tamanho);
+void simularSessao(Simulacao* simulacao, Arena* arena, CacheSalas* cache, uint32_t indice, AnelEventos* eventos, ResultadoSimulacao* resultado);
+void* trabalhadorSimulacao(void* argumento);
+uint32_t percentilPistas(const uint64_t* pistasPorSessao, uint32_t maximo, uint64_t sessoes, double fracao);
+void exibirResultadoSimulacao(const Simulacao* simulacao, const ResultadoSimulacao* total, uint32_t maximoPistas);
+int simularPartidas(const Mansao* mansao, const TabelaHash* tabelaHash, long totalSessoes, PoliticaSimulacao politica,
+                    uint32_t passos, uint32_t semente, int numThreads, FluxoEventos* eventos);
 
-    construirEstruturaMapa(salas[0], salas[1], salas[2], salas[3], salas[4],
-                          salas[5], salas[6], salas[7], salas[8], salas[9], salas[10], salas[11]);
+// Benchmark
+uint64_t agoraNanos();
+uint32_t proximoAleatorio(uint32_t* estado);
+void executarBenchmarkHash();
+int alturaMaximaAvl(uint32_t numNos);
+int executarBenchmarkPistasOrdenadas();
 
-    return salas[0];
-}
+// Carga sintetica e suite de benchmark
+const char* nomeFormaMansao(FormaMansao forma);
+int lerFormaMansao(const char* texto, FormaMansao* forma);
+void gerarMansaoSintetica(Arena* arena, Mansao* mansao, FormaMansao forma, uint32_t numSalas, uint32_t numPistas, uint32_t semente);
+int escreverCenarioTexto(const Mansao* mansao, const char* caminho);
+long lerMemoriaDoProcesso(const char* campo);
+void marcarCasoBenchmark(MarcoBenchmark* marco, const Arena* arena);
+void imprimirLinhaBenchmark(const char* caso, FormaMansao forma, uint32_t numSalas, uint32_t numPistas,
+                            size_t operacoes, uint64_t nanos, const Arena* arena, const MarcoBenchmark* antes);
+void executarSuiteBenchmark(FormaMansao forma, uint32_t numSalas, uint32_t numPistas);
 
-void construirEstruturaMapa(Sala* hallEntrada, Sala* salaEstar, Sala* cozinha, Sala* biblioteca, 
-                           Sala* quartoHospedes, Sala* jardim, Sala* salaJantar, Sala* escritorio, 
-                           Sala* porao, Sala* terraco, Sala* quartoPrincipal, Sala* banheiro) {
-    // Usar as salas ja criadas em vez de criar novas
-    hallEntrada->esquerda = salaEstar;
-    hallEntrada->direita = cozinha;
-    
-    salaEstar->esquerda = biblioteca;
-    salaEstar->direita = quartoHospedes;
-    
-    cozinha->esquerda = jardim;
-    cozinha->direita = salaJantar;
-    
-    biblioteca->esquerda = escritorio;
-    biblioteca->direita = porao;
-    
-    quartoHospedes->esquerda = terraco;
-    quartoHospedes->direita = quartoPrincipal;
-    
-    jardim->direita = banheiro;
-}
+// Implementação
 
-// --- Pistas (BST)
+// --- Arena
 
-PistaNode* criarNoPista(const char* pista) {
-    PistaNode* novoNo = (PistaNode*)malloc(sizeof(PistaNode));
-    if (novoNo == NULL) {
-        printf("Erro: Nao foi possivel alocar memoria para a pista.\n");
-        exit(1);
-    }
-    
-    strcpy(novoNo->pista, pista);
-    novoNo->esquerda = NULL;
-    novoNo->direita = NULL;
-    
-    return novoNo;
+void inicializarArena(Arena* arena) {
+    arena->atual = NULL;
+    arena->tamanhoProximoBloco = TAMANHO_BLOCO_ARENA;
+    arena->alocacoes = 0;
+    arena->blocosAlocados = 0;
 }
 
-PistaNode* inserirPista(PistaNode* raiz, const char* pista) {
-    if (raiz == NULL) {
-        return criarNoPista(pista);
-    }
-    
-    int comparacao = strcmp(pista, raiz->pista);
-    
-    if (comparacao < 0) {
-        raiz->esquerda = inserirPista(raiz->esquerda, pista);
-    } else if (comparacao > 0) {
-        raiz->direita = inserirPista(raiz->direita, pista);
+void* alocarNaArena(Arena* arena, size_t tamanho) {
+    // Arredonda para manter todos os nos alinhados dentro do bloco
+    size_t tamanhoAlinhado = (tamanho + ALINHAMENTO_ARENA - 1) & ~(size_t)(ALINHAMENTO_ARENA - 1);
+    BlocoArena* bloco = arena->atual;
+
+    if (bloco == NULL || bloco->capacidade - bloco->usado < tamanhoAlinhado) {
+        size_t capacidade = arena->tamanhoProximoBloco;
+        if (capacidade < tamanhoAlinhado) {
+            capacidade = tamanhoAlinhado;
+        }
+
+        bloco = (BlocoArena*)malloc(sizeof(BlocoArena) + ALINHAMENTO_ARENA + capacidade);
+        if (bloco == NULL) {
+            printf("Erro: Nao foi possivel alocar memoria para a arena.\n");
+            exit(1);
+        }
+
+        uintptr_t inicio = (uintptr_t)(bloco + 1);
+        inicio = (inicio + ALINHAMENTO_ARENA - 1) & ~(uintptr_t)(ALINHAMENTO_ARENA - 1);
+        bloco->dados = (unsigned char*)inicio;
+        bloco->capacidade = capacidade;
+        bloco->usado = 0;
+        bloco->anterior = arena->atual;
+        arena->atual = bloco;
+        arena->blocosAlocados++;
+
+        if (arena->tamanhoProximoBloco < TAMANHO_MAXIMO_BLOCO_ARENA) {
+            arena->tamanhoProximoBloco *= 2;
+        }
     }
-    
-    return raiz;
+
+    void* memoria = bloco->dados + bloco->usado;
+    bloco->usado += tamanhoAlinhado;
+    arena->alocacoes++;
+    return memoria;
 }
 
-void exibirPistasEmOrdem(PistaNode* raiz) {
-    if (raiz != NULL) {
-        exibirPistasEmOrdem(raiz->esquerda);
-        printf("- %s\n", raiz->pista);
-        exibirPistasEmOrdem(raiz->direita);
-    }
+void* alocarAlinhadoNaArena(Arena* arena, size_t tamanho, size_t alinhamento) {
+    // Para alinhamentos maiores que o da arena: sobra reservada na frente
+    uintptr_t inicio = (uintptr_t)alocarNaArena(arena, tamanho + alinhamento - ALINHAMENTO_ARENA);
+    inicio = (inicio + alinhamento - 1) & ~(uintptr_t)(alinhamento - 1);
+    return (void*)inicio;
 }
 
-void liberarArvorePistas(PistaNode* raiz) {
-    if (raiz == NULL) {
+void reiniciarArena(Arena* arena) {
+    // Fica so o bloco mais recente, o maior, esvaziado: uma arena
+    // reaproveitada a cada sessao para de chamar malloc depois das primeiras
+    BlocoArena* bloco = arena->atual;
+    if (bloco == NULL) {
         return;
     }
-    
-    liberarArvorePistas(raiz->esquerda);
-    liberarArvorePistas(raiz->direita);
-    free(raiz);
+    BlocoArena* anterior = bloco->anterior;
+    while (anterior != NULL) {
+        BlocoArena* proximo = anterior->anterior;
+        free(anterior);
+        anterior = proximo;
+    }
+    bloco->anterior = NULL;
+    bloco->usado = 0;
 }
 
-// --- Hash
-
-HashNode** criarTabelaHash(int tamanho) {
-    HashNode** tabela = (HashNode**)malloc(tamanho * sizeof(HashNode*));
-    if (tabela == NULL) {
-        printf("Erro: Nao foi possivel alocar memoria para a tabela hash.\n");
-        exit(1);
-    }
-    
-    for (int i = 0; i < tamanho; i++) {
-        tabela[i] = NULL;
+void liberarArena(Arena* arena) {
+    BlocoArena* bloco = arena->atual;
+    while (bloco != NULL) {
+        BlocoArena* anterior = bloco->anterior;
+        free(bloco);
+        bloco = anterior;
     }
-    
-    return tabela;
+    // Os contadores sobrevivem: uma arena reaproveitada acumula a medicao
+    arena->atual = NULL;
+    arena->tamanhoProximoBloco = TAMANHO_BLOCO_ARENA;
 }
 
-int calcularHash(const char* pista, int tamanho) {
-    int hash = 0;
-    for (int i = 0; pista[i] != '\0'; i++) {
-        hash = (hash * 31 + pista[i]) % tamanho;
-    }
-    return hash;
+// --- Mapa
+
+void iniciarConstrucaoMansao(ConstrutorMansao* construtor, Arena* arena, uint32_t numSalas, uint32_t numLigacoes, uint32_t numPares, size_t capacidadeTextos) {
+    construtor->arena = arena;
+    construtor->salas = (TextoSala*)alocarNaArena(arena, (size_t)numSalas * sizeof(TextoSala));
+    construtor->numSalas = 0;
+    construtor->capacidadeSalas = numSalas;
+    construtor->ligacoes = (LigacaoSala*)alocarNaArena(arena, (size_t)numLigacoes * sizeof(LigacaoSala));
+    construtor->numLigacoes = 0;
+    construtor->capacidadeLigacoes = numLigacoes;
+    construtor->pares = (ParPistaSuspeito*)alocarNaArena(arena, (size_t)numPares * sizeof(ParPistaSuspeito));
+    construtor->numPares = 0;
+    construtor->capacidadePares = numPares;
+
+    // O deslocamento 0 do pool e sempre a string vazia ("sem pista")
+    construtor->textos = (char*)alocarNaArena(arena, capacidadeTextos + 1);
+    construtor->textos[0] = '\0';
+    construtor->tamanhoTextos = 1;
+    construtor->capacidadeTextos = capacidadeTextos + 1;
+    construtor->culpado = 0;
 }
 
-void inserirNaHash(HashNode** tabela, int tamanho, const char* pista, const char* suspeito) {
-    int indice = calcularHash(pista, tamanho);
-    
-    HashNode* novoNo = (HashNode*)malloc(sizeof(HashNode));
-    if (novoNo == NULL) {
-        printf("Erro: Nao foi possivel alocar memoria para o no hash.\n");
+uint32_t guardarTextoNaMansao(ConstrutorMansao* construtor, const char* texto) {
+    size_t tamanho = strlen(texto);
+    if (tamanho == 0) {
+        return 0;
+    }
+    if (construtor->tamanhoTextos + tamanho + 1 > construtor->capacidadeTextos) {
+        printf("Erro: Pool de textos da mansao esgotado.\n");
         exit(1);
     }
-    
-    strcpy(novoNo->pista, pista);
-    strcpy(novoNo->suspeito, suspeito);
-    novoNo->proximo = tabela[indice];
-    tabela[indice] = novoNo;
-}
 
-char* encontrarSuspeito(HashNode** tabela, int tamanho, const char* pista) {
-    int indice = calcularHash(pista, tamanho);
-    HashNode* atual = tabela[indice];
-    
-    while (atual != NULL) {
-        if (strcmp(atual->pista, pista) == 0) {
-            return atual->suspeito;
-        }
-        atual = atual->proximo;
-    }
-    
-    return "Desconhecido";
+    uint32_t deslocamento = (uint32_t)construtor->tamanhoTextos;
+    memcpy(construtor->textos + deslocamento, texto, tamanho + 1);
+    construtor->tamanhoTextos += tamanho + 1;
+    return deslocamento;
 }
 
-void inicializarTabelaHash(HashNode** tabela, int tamanho) {
-    
-    // Joao
-    inserirNaHash(tabela, tamanho, "Porta principal arrombada", "Joao");
-    inserirNaHash(tabela, tamanho, "Pegadas de barro frescas", "Joao");
-    inserirNaHash(tabela, tamanho, "Relogio parado as 23:45", "Joao");
-    inserirNaHash(tabela, tamanho, "Cartao de acesso roubado", "Joao");
-    inserirNaHash(tabela, tamanho, "Dinheiro em especie escondido", "Joao");
-
-    // Maria
-    inserirNaHash(tabela, tamanho, "Copo de vinho pela metade", "Maria");
-    inserirNaHash(tabela, tamanho, "Cadeira desencaixada da mesa", "Maria");
-    inserirNaHash(tabela, tamanho, "Toalha com manchas vermelhas", "Maria");
-    inserirNaHash(tabela, tamanho, "Luvas de latex encontradas", "Maria");
-    inserirNaHash(tabela, tamanho, "Celular com ligacoes suspeitas", "Maria");
-
-    // Carlos
-    inserirNaHash(tabela, tamanho, "Faca desaparecida do bloco", "Carlos");
-    inserirNaHash(tabela, tamanho, "Cofre aberto e vazio", "Carlos");
-    inserirNaHash(tabela, tamanho, "Computador com emails suspeitos", "Carlos");
-    inserirNaHash(tabela, tamanho, "Documentos falsificados", "Carlos");
-
-    // Ana
-    inserirNaHash(tabela, tamanho, "Livro sobre venenos aberto", "Ana");
-    inserirNaHash(tabela, tamanho, "Manchas escuras no chao", "Ana");
-    inserirNaHash(tabela, tamanho, "Fotos comprometedoras", "Ana");
-    inserirNaHash(tabela, tamanho, "Chave mestra duplicada", "Ana");
-
-    // Pedro
-    inserirNaHash(tabela, tamanho, "Mala com documentos secretos", "Pedro");
-    inserirNaHash(tabela, tamanho, "Cinzas de cigarro raro", "Pedro");
-    inserirNaHash(tabela, tamanho, "Gravação de segurança apagada", "Pedro");
-    inserirNaHash(tabela, tamanho, "Horario alterado no sistema", "Pedro");
-}
-
-void liberarTabelaHash(HashNode** tabela, int tamanho) {
-    for (int i = 0; i < tamanho; i++) {
-        HashNode* atual = tabela[i];
-        while (atual != NULL) {
-            HashNode* proximo = atual->proximo;
-            free(atual);
-            atual = proximo;
-        }
-    }
-    free(tabela);
-}
-
-void revelarCulpadoReal() {
-    printf("\n*** O VERDADEIRO CULPADO ERA: JOAO ***\n");
-    printf("Ele tinha 4 pistas incriminadoras:\n");
-    printf("- Porta principal arrombada\n");
-    printf("- Pegadas de barro frescas\n");
-    printf("- Relogio parado as 23:45\n");
-    printf("- Cartao de acesso roubado\n");
-}
+uint32_t criarSala(ConstrutorMansao* construtor, const char* nome, const char* pista) {
+    if (construtor->numSalas == construtor->capacidadeSalas) {
+        printf("Erro: Numero de salas maior que o previsto.\n");
+        exit(1);
+    }
 
-// --- Interface
+    TextoSala* novaSala = &construtor->salas[construtor->numSalas];
+    novaSala->nome = guardarTextoNaMansao(construtor, nome);
+    novaSala->pista = guardarTextoNaMansao(construtor, pista);
 
-void limparTela() {
-    CLEAR_SCREEN();
+    return construtor->numSalas++;
 }
 
-void pausarExecucao() {
-    printf("\nPressione Enter para continuar...");
-    getchar();
-    getchar();
-}
+void adicionarParPista(ConstrutorMansao* construtor, const char* pista, const char* suspeito, float peso) {
+    if (construtor->numPares == construtor->capacidadePares) {
+        printf("Erro: Numero de pistas maior que o previsto.\n");
+        exit(1);
+    }
 
-void mostrarTitulo() {
-    printf("=== DETECTIVE QUEST - SISTEMA DE PISTAS ===\n\n");
+    ParPistaSuspeito* par = &construtor->pares[construtor->numPares++];
+    par->pista = guardarTextoNaMansao(construtor, pista);
+    par->suspeito = guardarTextoNaMansao(construtor, suspeito);
+    par->peso = peso;
 }
 
-void mostrarBoasVindas() {
-    printf("Bem-vindo ao Detective Quest - Sistema de Pistas!\n");
-    printf("Explore a mansao, colete pistas e resolva o misterio.\n");
-    printf("\n");
-    printf("Pressione Enter para comecar a investigacao...");
-}
+void ligarSalas(ConstrutorMansao* construtor, uint32_t origem, char tecla, uint32_t destino, uint32_t custo) {
+    if (construtor->numLigacoes == construtor->capacidadeLigacoes) {
+        printf("Erro: Numero de ligacoes maior que o previsto.\n");
+        exit(1);
+    }
 
-void mostrarDespedida() {
-    limparTela();
-    printf("=== INVESTIGACAO CONCLUIDA ===\n\n");
-    printf("Obrigado por jogar Detective Quest!\n");
-    printf("Aqui estao todas as pistas coletadas:\n\n");
+    // Indices e custo sao conferidos em concluirMansao, com as salas todas criadas
+    LigacaoSala* ligacao = &construtor->ligacoes[construtor->numLigacoes++];
+    ligacao->origem = origem;
+    ligacao->saida.destino = destino;
+    ligacao->saida.custo = custo <= CUSTO_MAXIMO_SAIDA ? (uint16_t)custo : 0;
+    ligacao->saida.tecla = tecla;
+    ligacao->saida.reservado = 0;
 }
 
-void mostrarStatusInvestigacao(PistaNode* raizPistas) {
-    printf("\nStatus da Investigacao:\n");
-    printf("Pistas coletadas: %d\n", contarTotalPistas(raizPistas));
-}
+int concluirMansao(ConstrutorMansao* construtor, Mansao* mansao) {
+    Arena* arena = construtor->arena;
+    uint32_t numSalas = construtor->numSalas;
+    uint32_t numLigacoes = construtor->numLigacoes;
+    const LigacaoSala* ligacoes = construtor->ligacoes;
+    if (numSalas == 0 || numSalas >= MAXIMO_SALAS) {
+        printf("Erro: Numero de salas invalido (%u).\n", numSalas);
+        return 0;
+    }
+    if (numLigacoes >= MAXIMO_SAIDAS) {
+        printf("Erro: Numero de ligacoes invalido (%u).\n", numLigacoes);
+        return 0;
+    }
 
-// --- Navegação
+    // Saidas agrupadas por sala de origem (ordenacao por contagem, estavel),
+    // ainda na numeracao do cenario; entradas conta quem chega a cada sala
+    uint32_t* inicio = (uint32_t*)alocarNaArena(arena, ((size_t)numSalas + 1) * sizeof(uint32_t));
+    uint32_t* entradas = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    memset(inicio, 0, ((size_t)numSalas + 1) * sizeof(uint32_t));
+    memset(entradas, 0, (size_t)numSalas * sizeof(uint32_t));
+    int arvore = 1;
+    for (uint32_t i = 0; i < numLigacoes; i++) {
+        const LigacaoSala* ligacao = &ligacoes[i];
+        if (ligacao->origem >= numSalas || ligacao->saida.destino >= numSalas) {
+            printf("Erro: Ligacao %u aponta para uma sala inexistente.\n", i);
+            return 0;
+        }
+        if (ligacao->saida.custo == 0) {
+            printf("Erro: Custo da ligacao %u fora de 1..%d.\n", i, CUSTO_MAXIMO_SAIDA);
+            return 0;
+        }
+        inicio[ligacao->origem + 1]++;
+        entradas[ligacao->saida.destino]++;
+        if (ligacao->saida.tecla == 0) {
+            arvore = 0;
+        }
+    }
+    for (uint32_t i = 0; i < numSalas; i++) {
+        inicio[i + 1] += inicio[i];
+        if (entradas[i] > (i == SALA_HALL ? 0u : 1u)) {
+            arvore = 0;
+        }
+    }
 
-void marcarSalaComoVisitada(Sala* salaAtual) {
-    if (salaAtual != NULL) {
-        salaAtual->visitada = 1;
+    uint32_t* cursor = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    Saida* agrupadas = (Saida*)alocarNaArena(arena, (size_t)numLigacoes * sizeof(Saida));
+    memcpy(cursor, inicio, (size_t)numSalas * sizeof(uint32_t));
+    for (uint32_t i = 0; i < numLigacoes; i++) {
+        agrupadas[cursor[ligacoes[i].origem]++] = ligacoes[i].saida;
     }
-}
 
-void resetarVisitas(Sala* raiz) {
-    if (raiz == NULL) {
-        return;
+    // Esquerda e direita vao para a frente; as passagens mantem a ordem
+    static const char teclas[2] = {'d', 'e'};
+    for (uint32_t sala = 0; sala < numSalas; sala++) {
+        for (int t = 0; t < 2; t++) {
+            uint32_t posicao = UINT32_MAX;
+            for (uint32_t k = inicio[sala]; k < inicio[sala + 1]; k++) {
+                if (agrupadas[k].tecla != teclas[t]) {
+                    continue;
+                }
+                if (posicao != UINT32_MAX) {
+                    printf("Erro: Sala %u com mais de uma saida '%c'.\n", sala, teclas[t]);
+                    return 0;
+                }
+                posicao = k;
+            }
+            if (posicao != UINT32_MAX) {
+                Saida escolhida = agrupadas[posicao];
+                memmove(&agrupadas[inicio[sala] + 1], &agrupadas[inicio[sala]], (posicao - inicio[sala]) * sizeof(Saida));
+                agrupadas[inicio[sala]] = escolhida;
+            }
+        }
     }
-    raiz->visitada = 0;
-    resetarVisitas(raiz->esquerda);
-    resetarVisitas(raiz->direita);
-}
 
-int todasSalasVisitadas(Sala* raiz) {
-    if (raiz == NULL) {
-        return 1;
+    // Renumeracao em largura: o Hall primeiro, depois as salas sem entrada e
+    // por fim as que so um ciclo alcanca. Numa arvore os filhos de uma sala
+    // ficam vizinhos no vetor, o que o planejador de rotas aproveita.
+    uint32_t* novoIndice = cursor;
+    uint32_t* ordem = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    memset(novoIndice, 0xff, (size_t)numSalas * sizeof(uint32_t));
+    uint32_t cabeca = 0;
+    uint32_t fim = 0;
+    for (int fase = 0; fase < 3; fase++) {
+        for (uint32_t raiz = 0; raiz < numSalas; raiz++) {
+            if (novoIndice[raiz] != SEM_SALA || (fase == 0 && raiz != SALA_HALL) || (fase == 1 && entradas[raiz] != 0)) {
+                continue;
+            }
+            if (fase == 2) {
+                arvore = 0;
+            }
+            novoIndice[raiz] = fim;
+            ordem[fim++] = raiz;
+            while (cabeca < fim) {
+                uint32_t sala = ordem[cabeca++];
+                for (uint32_t k = inicio[sala]; k < inicio[sala + 1]; k++) {
+                    uint32_t destino = agrupadas[k].destino;
+                    if (novoIndice[destino] == SEM_SALA) {
+                        novoIndice[destino] = fim;
+                        ordem[fim++] = destino;
+                    }
+                }
+            }
+        }
     }
-    if (!raiz->visitada) {
-        return 0;
+
+    uint32_t* inicioSaidas = (uint32_t*)alocarNaArena(arena, ((size_t)numSalas + 1) * sizeof(uint32_t));
+    Saida* saidas = (Saida*)alocarNaArena(arena, (size_t)numLigacoes * sizeof(Saida));
+    TextoSala* textosSala = (TextoSala*)alocarNaArena(arena, (size_t)numSalas * sizeof(TextoSala));
+    uint32_t numSaidas = 0;
+    inicioSaidas[0] = 0;
+    for (uint32_t i = 0; i < numSalas; i++) {
+        uint32_t sala = ordem[i];
+        for (uint32_t k = inicio[sala]; k < inicio[sala + 1]; k++) {
+            saidas[numSaidas] = agrupadas[k];
+            saidas[numSaidas++].destino = novoIndice[agrupadas[k].destino];
+        }
+        inicioSaidas[i + 1] = numSaidas;
+        textosSala[i] = construtor->salas[sala];
     }
-    return todasSalasVisitadas(raiz->esquerda) && todasSalasVisitadas(raiz->direita);
+
+    mansao->inicioSaidas = inicioSaidas;
+    mansao->saidas = saidas;
+    mansao->numSaidas = numSaidas;
+    mansao->arvore = arvore;
+    mansao->textosSala = textosSala;
+    mansao->numSalas = numSalas;
+    mansao->pares = construtor->pares;
+    mansao->numPares = construtor->numPares;
+    mansao->textos = construtor->textos;
+    mansao->tamanhoTextos = (uint32_t)construtor->tamanhoTextos;
+    mansao->culpado = construtor->culpado;
+    mansao->pistasInternadas = NULL;
+    mansao->procedural = NULL;
+    mansao->mapeamento = NULL;
+    mansao->tamanhoMapeamento = 0;
+    calcularRumosAoHall(arena, mansao);
+    return 1;
 }
 
-int verificarFimDoCaminho(Sala* salaAtual) {
-    return (salaAtual->esquerda == NULL && salaAtual->direita == NULL);
+int itemFilaRumoMenor(ItemFilaRumo a, ItemFilaRumo b) {
+    return a.distancia < b.distancia || (a.distancia == b.distancia && a.sala < b.sala);
 }
 
-void coletarPista(Sala* salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash) {
-    if (strlen(salaAtual->pista) > 0) {
-        printf("\n========================================\n");
-        printf("PISTA ENCONTRADA NA SALA: %s\n", salaAtual->nome);
-        printf("Pista: %s\n", salaAtual->pista);
-        
-        char* suspeito = encontrarSuspeito(tabelaHash, tamanhoHash, salaAtual->pista);
-        printf("Suspeito associado: %s\n", suspeito);
-        printf("========================================\n");
-        
-        *raizPistas = inserirPista(*raizPistas, salaAtual->pista);
-        printf(">>> Pista registrada no caderno de investigacao!\n");
-        strcpy(salaAtual->pista, "");
-    } else {
-        printf("Nenhuma pista nova encontrada aqui.\n");
+void empilharFilaRumo(ItemFilaRumo* fila, size_t* tamanho, ItemFilaRumo item) {
+    size_t posicao = (*tamanho)++;
+    while (posicao > 0 && itemFilaRumoMenor(item, fila[(posicao - 1) / 2])) {
+        fila[posicao] = fila[(posicao - 1) / 2];
+        posicao = (posicao - 1) / 2;
     }
+    fila[posicao] = item;
 }
 
-void verificarPistaColetada(Sala* salaAtual) {
-    if (strlen(salaAtual->pista) == 0) {
-        printf("Esta sala ja foi investigada.\n");
+ItemFilaRumo retirarFilaRumo(ItemFilaRumo* fila, size_t* tamanho) {
+    ItemFilaRumo menor = fila[0];
+    ItemFilaRumo ultimo = fila[--(*tamanho)];
+    size_t posicao = 0;
+    for (;;) {
+        size_t filho = posicao * 2 + 1;
+        if (filho >= *tamanho) {
+            break;
+        }
+        if (filho + 1 < *tamanho && itemFilaRumoMenor(fila[filho + 1], fila[filho])) {
+            filho++;
+        }
+        if (!itemFilaRumoMenor(fila[filho], ultimo)) {
+            break;
+        }
+        fila[posicao] = fila[filho];
+        posicao = filho;
     }
+    fila[posicao] = ultimo;
+    return menor;
 }
 
-void mostrarCaminhosDisponiveis(Sala* salaAtual) {
-    printf("\nCaminhos disponiveis:\n");
-    if (salaAtual->esquerda != NULL && !salaAtual->esquerda->visitada) {
-        printf("[e] Esquerda -> %s (NOVO)\n", salaAtual->esquerda->nome);
-    } else if (salaAtual->esquerda != NULL) {
-        printf("[e] Esquerda -> %s (VISITADO)\n", salaAtual->esquerda->nome);
+void calcularRumosAoHall(Arena* arena, Mansao* mansao) {
+    uint32_t numSalas = mansao->numSalas;
+    uint32_t numSaidas = mansao->numSaidas;
+    const uint32_t* inicioSaidas = mansao->inicioSaidas;
+    const Saida* saidas = mansao->saidas;
+
+    // Na volta os corredores valem nos dois sentidos: as entradas de cada
+    // sala viram um segundo CSR, o reverso, montado por contagem
+    uint32_t* inicioEntradas = (uint32_t*)alocarNaArena(arena, ((size_t)numSalas + 1) * sizeof(uint32_t));
+    uint32_t* cursor = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    Saida* entradas = (Saida*)alocarNaArena(arena, (size_t)numSaidas * sizeof(Saida));
+    int custoUnitario = 1;
+    memset(inicioEntradas, 0, ((size_t)numSalas + 1) * sizeof(uint32_t));
+    for (uint32_t k = 0; k < numSaidas; k++) {
+        inicioEntradas[saidas[k].destino + 1]++;
+        custoUnitario &= saidas[k].custo == 1;
     }
-    
-    if (salaAtual->direita != NULL && !salaAtual->direita->visitada) {
-        printf("[d] Direita  -> %s (NOVO)\n", salaAtual->direita->nome);
-    } else if (salaAtual->direita != NULL) {
-        printf("[d] Direita  -> %s (VISITADO)\n", salaAtual->direita->nome);
+    for (uint32_t i = 0; i < numSalas; i++) {
+        inicioEntradas[i + 1] += inicioEntradas[i];
+    }
+    memcpy(cursor, inicioEntradas, (size_t)numSalas * sizeof(uint32_t));
+    for (uint32_t sala = 0; sala < numSalas; sala++) {
+        for (uint32_t k = inicioSaidas[sala]; k < inicioSaidas[sala + 1]; k++) {
+            Saida* entrada = &entradas[cursor[saidas[k].destino]++];
+            *entrada = saidas[k];
+            entrada->destino = sala;
+        }
     }
-    printf("[s] Sair da investigacao\n");
-}
 
-void processarNavegacaoComPistas(Sala** salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash, char opcao, Sala* hallEntrada) {
-    switch (opcao) {
-        case 'e':
-        case 'E':
-            if ((*salaAtual)->esquerda != NULL) {
-                // Verificar se a sala já foi visitada
-                if ((*salaAtual)->esquerda->visitada) {
-                    printf("\nVoce ja visitou esta sala anteriormente!\n");
-                    printf("Deseja visitar novamente? (s/n): ");
-                    char resposta;
-                    scanf(" %c", &resposta);
-                    if (resposta != 's' && resposta != 'S') {
-                        printf("Escolha outro caminho.\n");
-                        pausarExecucao();
-                        break;
+    uint32_t* rumo = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    memset(rumo, 0xff, (size_t)numSalas * sizeof(uint32_t));
+    const uint32_t* inicios[2] = {inicioSaidas, inicioEntradas};
+    const Saida* vizinhos[2] = {saidas, entradas};
+
+    if (custoUnitario) {
+        // Todos os corredores custam 1: busca em largura a partir do Hall
+        uint32_t* fila = cursor;
+        unsigned char* alcancada = (unsigned char*)alocarNaArena(arena, numSalas);
+        memset(alcancada, 0, numSalas);
+        uint32_t cabeca = 0;
+        uint32_t fim = 0;
+        fila[fim++] = SALA_HALL;
+        alcancada[SALA_HALL] = 1;
+        while (cabeca < fim) {
+            uint32_t sala = fila[cabeca++];
+            for (int sentido = 0; sentido < 2; sentido++) {
+                for (uint32_t k = inicios[sentido][sala]; k < inicios[sentido][sala + 1]; k++) {
+                    uint32_t vizinho = vizinhos[sentido][k].destino;
+                    if (!alcancada[vizinho]) {
+                        alcancada[vizinho] = 1;
+                        rumo[vizinho] = sala;
+                        fila[fim++] = vizinho;
                     }
                 }
-                
-                *salaAtual = (*salaAtual)->esquerda;
-                marcarSalaComoVisitada(*salaAtual); // Marcar como visitada
-                printf("\n>>> Voce entrou em: %s\n", (*salaAtual)->nome);
-                if (strlen((*salaAtual)->pista) > 0) {
-                    printf(">>> Procurando por pistas...\n");
-                }
-                coletarPista(*salaAtual, raizPistas, tabelaHash, tamanhoHash);
-                
-                // Verificar se chegou ao fim do caminho - VOLTA AUTOMATICAMENTE
-                if (verificarFimDoCaminho(*salaAtual)) {
-                    printf("\n>>> Voce chegou ao fim deste caminho!\n");
-                    printf("Voltando automaticamente ao Hall de Entrada...\n");
-                    *salaAtual = hallEntrada; // Volta para o Hall de Entrada
-                    pausarExecucao();
-                } else {
-                    pausarExecucao();
-                }
-            } else {
-                printf("\nNao ha caminho a esquerda!\n");
-                pausarExecucao();
             }
-            break;
-            
-        case 'd':
-        case 'D':
-            if ((*salaAtual)->direita != NULL) {
-                // Verificar se a sala já foi visitada
-                if ((*salaAtual)->direita->visitada) {
-                    printf("\nVoce ja visitou esta sala anteriormente!\n");
-                    printf("Deseja visitar novamente? (s/n): ");
-                    char resposta;
-                    scanf(" %c", &resposta);
-                    if (resposta != 's' && resposta != 'S') {
-                        printf("Escolha outro caminho.\n");
-                        pausarExecucao();
-                        break;
+        }
+    } else {
+        // Dijkstra com heap binario; itens vencidos sao descartados ao sair,
+        // e cada corredor empilha no maximo uma vez por sentido
+        uint64_t* distancia = (uint64_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint64_t));
+        ItemFilaRumo* fila = (ItemFilaRumo*)alocarNaArena(arena, ((size_t)numSaidas * 2 + 1) * sizeof(ItemFilaRumo));
+        size_t tamanho = 0;
+        memset(distancia, 0xff, (size_t)numSalas * sizeof(uint64_t));
+        distancia[SALA_HALL] = 0;
+        empilharFilaRumo(fila, &tamanho, (ItemFilaRumo){0, SALA_HALL});
+        while (tamanho > 0) {
+            ItemFilaRumo item = retirarFilaRumo(fila, &tamanho);
+            if (item.distancia != distancia[item.sala]) {
+                continue;
+            }
+            for (int sentido = 0; sentido < 2; sentido++) {
+                for (uint32_t k = inicios[sentido][item.sala]; k < inicios[sentido][item.sala + 1]; k++) {
+                    const Saida* saida = &vizinhos[sentido][k];
+                    uint64_t nova = item.distancia + saida->custo;
+                    if (nova < distancia[saida->destino]) {
+                        distancia[saida->destino] = nova;
+                        rumo[saida->destino] = item.sala;
+                        empilharFilaRumo(fila, &tamanho, (ItemFilaRumo){nova, saida->destino});
                     }
                 }
-                
-                *salaAtual = (*salaAtual)->direita;
-                marcarSalaComoVisitada(*salaAtual); // Marcar como visitada
-                printf("\n>>> Voce entrou em: %s\n", (*salaAtual)->nome);
-                if (strlen((*salaAtual)->pista) > 0) {
-                    printf(">>> Procurando por pistas...\n");
-                }
-                coletarPista(*salaAtual, raizPistas, tabelaHash, tamanhoHash);
-                
-                // Verificar se chegou ao fim do caminho - VOLTA AUTOMATICAMENTE
-                if (verificarFimDoCaminho(*salaAtual)) {
-                    printf("\n>>> Voce chegou ao fim deste caminho!\n");
-                    printf("Voltando automaticamente ao Hall de Entrada...\n");
-                    *salaAtual = hallEntrada; // Volta para o Hall de Entrada
-                    pausarExecucao();
-                } else {
-                    pausarExecucao();
-                }
-            } else {
-                printf("\nNao ha caminho a direita!\n");
-                pausarExecucao();
-            }
-            break;
-            
-        case 's':
-        case 'S':
-            printf("\nDeseja realmente sair da investigacao? (s/n): ");
-            char confirmacao;
-            scanf(" %c", &confirmacao);
-            if (confirmacao == 's' || confirmacao == 'S') {
-                printf("Saindo do Detective Quest...\n");
-                *salaAtual = NULL;
             }
-            break;
-            
-        default:
-            printf("\nOpcao invalida! Use 'e', 'd' ou 's'.\n");
-            pausarExecucao();
-            break;
+        }
     }
+    mansao->rumoAoHall = rumo;
 }
 
-void explorarSalasComPistas(Sala* salaAtual, PistaNode** raizPistas, HashNode** tabelaHash, int tamanhoHash, Sala* hallEntrada) {
-    char opcao;
-    
-    // Marcar Hall de Entrada como visitada no início
-    marcarSalaComoVisitada(salaAtual);
-    
-    // Coletar pista apenas do Hall de Entrada no inicio
-    printf("\n>>> Voce comecou no: %s\n", salaAtual->nome);
-    if (strlen(salaAtual->pista) > 0) {
-        printf(">>> Procurando por pistas...\n");
+int validarSaidas(const uint32_t* inicioSaidas, const Saida* saidas, uint32_t numSalas, uint32_t numSaidas, int arvore) {
+    // Passada sequencial pelo CSR: posicoes crescentes, destinos dentro do
+    // vetor e no maximo uma saida 'e' e uma 'd' por sala
+    if (inicioSaidas[0] != 0 || inicioSaidas[numSalas] != numSaidas) {
+        return 0;
     }
-    coletarPista(salaAtual, raizPistas, tabelaHash, tamanhoHash);
-    pausarExecucao();
-    
-    while (salaAtual != NULL) {
-        limparTela();
-        mostrarTitulo();
-        
-        printf("Voce esta na: %s\n", salaAtual->nome);
-        verificarPistaColetada(salaAtual);
-        mostrarStatusInvestigacao(*raizPistas);
-        
-        // Verificar se todas as salas foram visitadas
-        if (todasSalasVisitadas(hallEntrada)) {
-            printf("\n>>> PARABENS! Voce explorou todas as salas da mansao!\n");
-            printf("Voce pode continuar explorando ou sair para o julgamento final.\n");
+    uint32_t ultimoFilho = 0;
+    for (uint32_t i = 0; i < numSalas; i++) {
+        if (inicioSaidas[i + 1] < inicioSaidas[i] || inicioSaidas[i + 1] > numSaidas) {
+            return 0;
+        }
+        int teclasVistas = 0;
+        for (uint32_t k = inicioSaidas[i]; k < inicioSaidas[i + 1]; k++) {
+            const Saida* saida = &saidas[k];
+            int bit = saida->tecla == 'e' ? 1 : saida->tecla == 'd' ? 2 : 0;
+            if (saida->destino >= numSalas || saida->custo == 0 || (saida->tecla != 0 && bit == 0) || (teclasVistas & bit)) {
+                return 0;
+            }
+            teclasVistas |= bit;
+            // Numa arvore os filhos crescem em largura e nunca voltam para
+            // tras: o planejador de rotas depende disso para terminar
+            if (arvore && (bit == 0 || saida->destino <= i || saida->destino <= ultimoFilho)) {
+                return 0;
+            }
+            ultimoFilho = saida->destino;
         }
-        
-        mostrarCaminhosDisponiveis(salaAtual);
-        
-        printf("\nPara onde deseja ir? ");
-        scanf(" %c", &opcao);
-        
-        processarNavegacaoComPistas(&salaAtual, raizPistas, tabelaHash, tamanhoHash, opcao, hallEntrada);
     }
+    return 1;
 }
 
-// --- Suspeitos
+const char* textoDaMansao(const Mansao* mansao, uint32_t deslocamento) {
+    // Deslocamentos invalidos de um arquivo corrompido viram texto vazio
+    return deslocamento < mansao->tamanhoTextos ? mansao->textos + deslocamento : "";
+}
 
-void listarSuspeitos() {
-    printf("\n=== SUSPEITOS ===\n");
-    printf("1. Joao\n");
-    printf("2. Maria\n");
-    printf("3. Carlos\n");
-    printf("4. Ana\n");
-    printf("5. Pedro\n");
-    printf("=================\n");
+// Numa mansao procedural o ponteiro devolvido vale ate a consulta de
+// outras duas salas: depois disso a via do cache pode ser reaproveitada
+const char* nomeSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    if (mansao->procedural != NULL) {
+        return salaGerada(mansao, cache, sala)->nome;
+    }
+    return textoDaMansao(mansao, mansao->textosSala[sala].nome);
 }
 
-int contarPistasPorSuspeito(PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash, const char* suspeito) {
-    if (raizPistas == NULL) {
-        return 0;
+const char* pistaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    if (mansao->procedural != NULL) {
+        return salaGerada(mansao, cache, sala)->pista;
     }
-    
-    int contador = 0;
-    
-    // Contar pistas da subarvore esquerda
-    contador += contarPistasPorSuspeito(raizPistas->esquerda, tabelaHash, tamanhoHash, suspeito);
-    
-    // Verificar pista atual
-    char* suspeitoDaPista = encontrarSuspeito(tabelaHash, tamanhoHash, raizPistas->pista);
-    if (strcmp(suspeitoDaPista, suspeito) == 0) {
-        contador++;
+    return textoDaMansao(mansao, mansao->textosSala[sala].pista);
+}
+
+// As saidas ja foram validadas na carga, entao nao ha checagem aqui
+const Saida* saidasDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    if (mansao->procedural != NULL) {
+        return salaGerada(mansao, cache, sala)->saidas;
     }
-    
-    // Contar pistas da subarvore direita
-    contador += contarPistasPorSuspeito(raizPistas->direita, tabelaHash, tamanhoHash, suspeito);
-    
-    return contador;
+    return mansao->saidas + mansao->inicioSaidas[sala];
 }
 
-void verificarSuspeitoFinal(PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash) {
-    char suspeito[50];
-    
-    printf("\n=== FASE DE JULGAMENTO ===\n");
-    printf("Com base nas pistas coletadas, quem e o culpado?\n");
-    
-    listarSuspeitos();
-    
-    printf("\nDigite o nome do suspeito: ");
-    scanf(" %[^\n]", suspeito);
-    
-    int pistasDoSuspeito = contarPistasPorSuspeito(raizPistas, tabelaHash, tamanhoHash, suspeito);
-    
-    printf("\n=== RESULTADO DO JULGAMENTO ===\n");
-    printf("Suspeito acusado: %s\n", suspeito);
-    printf("Pistas que apontam para %s: %d\n", suspeito, pistasDoSuspeito);
-    
-    if (pistasDoSuspeito >= 2) {
-        printf("\n*** PARABENS! ***\n");
-        printf("Voce reuniu provas suficientes para incriminar %s!\n", suspeito);
-        printf("O caso esta resolvido!\n");
+uint32_t grauDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    if (mansao->procedural != NULL) {
+        return salaGerada(mansao, cache, sala)->grau;
+    }
+    return mansao->inicioSaidas[sala + 1] - mansao->inicioSaidas[sala];
+}
+
+uint32_t salaPelaTecla(const Mansao* mansao, CacheSalas* cache, uint32_t sala, char tecla) {
+    // 'e' e 'd' sempre abrem a lista de saidas, entao bastam duas leituras
+    const Saida* saidas = saidasDaSala(mansao, cache, sala);
+    uint32_t grau = grauDaSala(mansao, cache, sala);
+    for (uint32_t k = 0; k < grau && k < 2; k++) {
+        if (saidas[k].tecla == tecla) {
+            return saidas[k].destino;
+        }
+    }
+    return SEM_SALA;
+}
+
+uint32_t salaEsquerda(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    return salaPelaTecla(mansao, cache, sala, 'e');
+}
+
+uint32_t salaDireita(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    return salaPelaTecla(mansao, cache, sala, 'd');
+}
+
+uint32_t idPistaDaSala(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    if (mansao->procedural != NULL) {
+        return salaGerada(mansao, cache, sala)->idPista;
+    }
+    return mansao->pistasInternadas[sala];
+}
+
+uint32_t rumoDaSala(const Mansao* mansao, uint32_t sala) {
+    // Na numeracao de heap o caminho mais curto ao Hall passa pelo pai
+    if (mansao->procedural != NULL) {
+        return sala == SALA_HALL ? SEM_SALA : (sala - 1) / 2;
+    }
+    return mansao->rumoAoHall[sala];
+}
+
+// --- Mansao procedural
+//
+// Startup O(1): a mansao guarda so a semente, o conjunto de pares e um
+// cache de tamanho fixo. Nome, pista e saidas de uma sala sao funcoes da
+// semente e do numero da sala, calculadas quando alguem chega nela; a
+// memoria cresce com o que foi explorado, nao com o tamanho do mapa.
+
+static const char* const TIPOS_SALA_PROCEDURAL[] = {
+    "Biblioteca", "Cozinha", "Sotao", "Porao", "Galeria", "Estufa",
+    "Capela", "Adega", "Escritorio", "Quarto de Hospedes", "Sala de Musica", "Salao de Baile",
+};
+static const char* const OBJETOS_PROCEDURAIS[] = {
+    "Luva de couro", "Bilhete rasgado", "Chave dourada", "Pegada de lama",
+    "Taca quebrada", "Lenco bordado", "Recibo amassado", "Fio de cabelo",
+};
+static const char* const LOCAIS_PROCEDURAIS[] = {
+    "sob o tapete", "atras do quadro", "na lareira", "junto a janela",
+    "no bolso do casaco", "dentro da gaveta", "perto da escada", "no vaso de flores",
+};
+static const char* const SUSPEITOS_PROCEDURAIS[] = {
+    "Mordomo", "Governanta", "Jardineiro", "Cozinheira", "Sobrinho", "Medica",
+};
+#define NUM_TIPOS_SALA_PROCEDURAL (sizeof(TIPOS_SALA_PROCEDURAL) / sizeof(TIPOS_SALA_PROCEDURAL[0]))
+#define NUM_OBJETOS_PROCEDURAIS (sizeof(OBJETOS_PROCEDURAIS) / sizeof(OBJETOS_PROCEDURAIS[0]))
+#define NUM_LOCAIS_PROCEDURAIS (sizeof(LOCAIS_PROCEDURAIS) / sizeof(LOCAIS_PROCEDURAIS[0]))
+#define NUM_SUSPEITOS_PROCEDURAIS (sizeof(SUSPEITOS_PROCEDURAIS) / sizeof(SUSPEITOS_PROCEDURAIS[0]))
+
+uint32_t misturarSemente(uint32_t semente, uint32_t valor) {
+    // Finalizador do murmur3: salas vizinhas dao sorteios independentes
+    uint32_t x = valor ^ (semente * 0x9E3779B1u);
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+void criarMansaoProcedural(Arena* arena, Mansao* mansao, uint32_t semente, uint32_t numSalas, uint32_t capacidadeCache) {
+    // Pares: cada objeto em cada local, com o suspeito sorteado pela semente
+    uint32_t numPares = (uint32_t)(NUM_OBJETOS_PROCEDURAIS * NUM_LOCAIS_PROCEDURAIS);
+    ConstrutorMansao construtor;
+    iniciarConstrucaoMansao(&construtor, arena, 0, 0, numPares, (size_t)numPares * 64 + 64);
+    char pista[64];
+    for (uint32_t k = 0; k < numPares; k++) {
+        snprintf(pista, sizeof(pista), "%s %s", OBJETOS_PROCEDURAIS[k / NUM_LOCAIS_PROCEDURAIS],
+                 LOCAIS_PROCEDURAIS[k % NUM_LOCAIS_PROCEDURAIS]);
+        adicionarParPista(&construtor, pista, SUSPEITOS_PROCEDURAIS[misturarSemente(semente, SEM_SALA - k) % NUM_SUSPEITOS_PROCEDURAIS], 1.0f);
+    }
+    construtor.culpado = guardarTextoNaMansao(&construtor, SUSPEITOS_PROCEDURAIS[semente % NUM_SUSPEITOS_PROCEDURAIS]);
+
+    // Conjuntos em potencia de 2, com pelo menos a capacidade pedida
+    uint32_t numConjuntos = 1;
+    while ((uint64_t)numConjuntos * VIAS_CACHE_PROCEDURAL < capacidadeCache) {
+        numConjuntos *= 2;
+    }
+    MansaoProcedural* procedural = (MansaoProcedural*)alocarNaArena(arena, sizeof(MansaoProcedural));
+    procedural->semente = semente;
+    procedural->numConjuntos = numConjuntos;
+    procedural->idsDosPares = NULL; // internarPistasDaMansao resolve
+
+    memset(mansao, 0, sizeof(Mansao));
+    mansao->arvore = 1;
+    mansao->numSalas = numSalas;
+    mansao->pares = construtor.pares;
+    mansao->numPares = construtor.numPares;
+    mansao->textos = construtor.textos;
+    mansao->tamanhoTextos = (uint32_t)construtor.tamanhoTextos;
+    mansao->culpado = construtor.culpado;
+    mansao->procedural = procedural;
+}
+
+void gerarSala(const Mansao* mansao, uint32_t sala, SalaGerada* destino) {
+    const MansaoProcedural* procedural = mansao->procedural;
+    uint32_t sorteio = misturarSemente(procedural->semente, sala);
+
+    destino->sala = sala;
+    if (sala == SALA_HALL) {
+        snprintf(destino->nome, sizeof(destino->nome), "Hall de Entrada");
     } else {
-        printf("\n*** ATENCAO! ***\n");
-        printf("Poucas pistas apontam para %s.\n", suspeito);
-        printf("Voce nao tem provas suficientes para uma acusacao.\n");
-        printf("O verdadeiro culpado pode escapar!\n");
+        snprintf(destino->nome, sizeof(destino->nome), "%s %u", TIPOS_SALA_PROCEDURAL[sorteio % NUM_TIPOS_SALA_PROCEDURAL], sala);
+    }
+
+    // O Hall sempre tem pista; as demais salas, metade delas
+    if (sala == SALA_HALL || ((sorteio >> 8) & 1)) {
+        uint32_t par = (sorteio >> 9) % mansao->numPares;
+        destino->pista = textoDaMansao(mansao, mansao->pares[par].pista);
+        destino->idPista = procedural->idsDosPares[par];
+    } else {
+        destino->pista = "";
+        destino->idPista = SEM_PISTA;
+    }
+
+    // Cada filho existe com chance de 3/4, sorteada pelo numero dele;
+    // o Hall sempre tem os dois, para a partida nao acabar na porta
+    destino->grau = 0;
+    for (uint32_t lado = 0; lado < 2; lado++) {
+        uint64_t filho = 2 * (uint64_t)sala + 1 + lado;
+        if (filho >= mansao->numSalas) {
+            break;
+        }
+        if (sala != SALA_HALL && (misturarSemente(procedural->semente, (uint32_t)filho) >> 30) == 0) {
+            continue;
+        }
+        Saida* saida = &destino->saidas[destino->grau++];
+        saida->destino = (uint32_t)filho;
+        saida->custo = 1;
+        saida->tecla = lado == 0 ? 'e' : 'd';
+        saida->reservado = 0;
     }
 }
 
-void gerarRelatorioFinal(PistaNode* raizPistas) {
-    mostrarDespedida();
-    exibirPistasEmOrdem(raizPistas);
-    printf("\nTotal de pistas coletadas: %d\n", contarTotalPistas(raizPistas));
+CacheSalas* criarCacheSalas(Arena* arena, const Mansao* mansao) {
+    // NULL numa mansao montada: os acessos nem olham o cache
+    if (mansao->procedural == NULL) {
+        return NULL;
+    }
+    size_t numVias = (size_t)mansao->procedural->numConjuntos * VIAS_CACHE_PROCEDURAL;
+    CacheSalas* cache = (CacheSalas*)alocarNaArena(arena, sizeof(CacheSalas));
+    cache->vias = (SalaGerada*)alocarNaArena(arena, numVias * sizeof(SalaGerada));
+    for (size_t i = 0; i < numVias; i++) {
+        cache->vias[i].sala = SEM_SALA;
+        cache->vias[i].ultimoUso = 0;
+    }
+    cache->mascaraConjuntos = mansao->procedural->numConjuntos - 1;
+    cache->relogio = 0;
+    cache->geradas = 0;
+    cache->despejadas = 0;
+    return cache;
 }
 
-int contarTotalPistas(PistaNode* raiz) {
-    if (raiz == NULL) {
+void relatarCacheSalas(FILE* saida, const Mansao* mansao, const CacheSalas* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    fprintf(saida, "salas_possiveis=%u cache=%u salas_geradas=%llu despejadas=%llu\n", mansao->numSalas,
+            (cache->mascaraConjuntos + 1) * VIAS_CACHE_PROCEDURAL, (unsigned long long)cache->geradas,
+            (unsigned long long)cache->despejadas);
+}
+
+const SalaGerada* salaGerada(const Mansao* mansao, CacheSalas* cache, uint32_t sala) {
+    // A via despejada e a usada ha mais tempo do conjunto. Com quatro vias
+    // as duas ultimas salas consultadas nunca saem, e o jogo nao segura
+    // ponteiros de mais de duas salas de uma vez (saidas de uma, nome de outra)
+    uint32_t conjunto = misturarSemente(~mansao->procedural->semente, sala) & cache->mascaraConjuntos;
+    SalaGerada* vias = &cache->vias[(size_t)conjunto * VIAS_CACHE_PROCEDURAL];
+    cache->relogio++;
+
+    SalaGerada* vitima = &vias[0];
+    for (int v = 0; v < VIAS_CACHE_PROCEDURAL; v++) {
+        if (vias[v].sala == sala) {
+            vias[v].ultimoUso = cache->relogio;
+            return &vias[v];
+        }
+        if (vias[v].ultimoUso < vitima->ultimoUso) {
+            vitima = &vias[v];
+        }
+    }
+
+    if (vitima->sala != SEM_SALA) {
+        cache->despejadas++;
+    }
+    gerarSala(mansao, sala, vitima);
+    vitima->ultimoUso = cache->relogio;
+    cache->geradas++;
+    return vitima;
+}
+
+// --- Cenarios (texto e binario compilado)
+
+char* lerArquivoNaArena(Arena* arena, const char* caminho, size_t* tamanho) {
+    FILE* arquivo = fopen(caminho, "rb");
+    if (arquivo == NULL) {
+        printf("Erro: Nao foi possivel abrir o arquivo %s.\n", caminho);
+        return NULL;
+    }
+
+    fseek(arquivo, 0, SEEK_END);
+    long fim = ftell(arquivo);
+    fseek(arquivo, 0, SEEK_SET);
+    if (fim < 0) {
+        printf("Erro: Nao foi possivel ler o arquivo %s.\n", caminho);
+        fclose(arquivo);
+        return NULL;
+    }
+
+    char* conteudo = (char*)alocarNaArena(arena, (size_t)fim + 1);
+    size_t lidos = fread(conteudo, 1, (size_t)fim, arquivo);
+    fclose(arquivo);
+    conteudo[lidos] = '\0';
+    *tamanho = lidos;
+
+    return conteudo;
+}
+
+char* aparaTexto(char* texto) {
+    while (*texto == ' ' || *texto == '\t') {
+        texto++;
+    }
+    char* fim = texto + strlen(texto);
+    while (fim > texto && (fim[-1] == ' ' || fim[-1] == '\t' || fim[-1] == '\r')) {
+        *--fim = '\0';
+    }
+    return texto;
+}
+
+int linhaComecaCom(const char* linha, const char* tipo) {
+    while (*linha == ' ' || *linha == '\t') {
+        linha++;
+    }
+    size_t tamanho = strlen(tipo);
+    if (strncmp(linha, tipo, tamanho) != 0) {
         return 0;
     }
-    return 1 + contarTotalPistas(raiz->esquerda) + contarTotalPistas(raiz->direita);
+    linha += tamanho;
+    while (*linha == ' ' || *linha == '\t') {
+        linha++;
+    }
+    return *linha == '|';
 }
 
-// --- Finalização
+int separarCampos(char* linha, char* campos[], int maximo) {
+    int quantidade = 0;
+    char* inicio = linha;
 
-void liberarArvoreSalas(Sala* raiz) {
-    if (raiz == NULL) {
+    while (quantidade < maximo) {
+        char* separador = strchr(inicio, '|');
+        if (separador != NULL) {
+            *separador = '\0';
+        }
+        campos[quantidade++] = aparaTexto(inicio);
+        if (separador == NULL) {
+            break;
+        }
+        inicio = separador + 1;
+    }
+
+    return quantidade;
+}
+
+int carregarCenarioTexto(Arena* arena, char* conteudo, size_t tamanho, Mansao* mansao) {
+    // Primeira passada: conta salas, ligacoes e pistas para reservar tudo de uma vez
+    uint32_t numSalas = 0;
+    uint32_t numLigacoes = 0;
+    uint32_t numPares = 0;
+    for (char* linha = conteudo; linha != NULL && *linha != '\0'; ) {
+        char* proxima = strchr(linha, '\n');
+        if (linhaComecaCom(linha, "SALA")) {
+            numSalas++;
+        } else if (linhaComecaCom(linha, "LIGACAO")) {
+            numLigacoes++;
+        } else if (linhaComecaCom(linha, "PISTA")) {
+            numPares++;
+        }
+        linha = proxima != NULL ? proxima + 1 : NULL;
+    }
+
+    if (numSalas == 0) {
+        printf("Erro: Cenario sem salas.\n");
+        return 0;
+    }
+
+    // Todo texto do pool vem do arquivo, entao o tamanho dele e um limite seguro
+    ConstrutorMansao construtor;
+    iniciarConstrucaoMansao(&construtor, arena, numSalas, numLigacoes, numPares, tamanho);
+
+    int numeroLinha = 0;
+    char* linha = conteudo;
+    while (linha != NULL && *linha != '\0') {
+        char* proxima = strchr(linha, '\n');
+        if (proxima != NULL) {
+            *proxima++ = '\0';
+        }
+        numeroLinha++;
+
+        char* campos[5];
+        char* texto = aparaTexto(linha);
+        if (*texto == '\0' || *texto == '#') {
+            linha = proxima;
+            continue;
+        }
+
+        int quantidade = separarCampos(texto, campos, 5);
+        if (strcmp(campos[0], "SALA") == 0 && quantidade >= 2) {
+            criarSala(&construtor, campos[1], quantidade >= 3 ? campos[2] : "");
+        } else if (strcmp(campos[0], "LIGACAO") == 0 && (quantidade == 4 || quantidade == 5)) {
+            // Lado '-' e uma passagem sem lado; o custo opcional pesa na volta ao Hall
+            long origem = strtol(campos[1], NULL, 10);
+            long destino = strtol(campos[3], NULL, 10);
+            if (origem < 0 || destino < 0 || (unsigned long)origem >= numSalas || (unsigned long)destino >= numSalas) {
+                printf("Erro: Ligacao com sala inexistente na linha %d.\n", numeroLinha);
+                return 0;
+            }
+            char tecla = minuscula(campos[2][0]);
+            if ((tecla != 'e' && tecla != 'd' && tecla != '-') || campos[2][1] != '\0') {
+                printf("Erro: Lado invalido na linha %d (use e, d ou -).\n", numeroLinha);
+                return 0;
+            }
+            long custo = 1;
+            if (quantidade == 5) {
+                char* fim;
+                custo = strtol(campos[4], &fim, 10);
+                if (fim == campos[4] || *fim != '\0' || custo < 1 || custo > CUSTO_MAXIMO_SAIDA) {
+                    printf("Erro: Custo invalido na linha %d (use um inteiro entre 1 e %d).\n", numeroLinha, CUSTO_MAXIMO_SAIDA);
+                    return 0;
+                }
+            }
+            ligarSalas(&construtor, (uint32_t)origem, tecla == '-' ? 0 : tecla, (uint32_t)destino, (uint32_t)custo);
+        } else if (strcmp(campos[0], "PISTA") == 0 && (quantidade == 3 || quantidade == 4)) {
+            // Peso opcional: a mesma pista pode pesar contra varios suspeitos
+            float peso = 1.0f;
+            if (quantidade == 4) {
+                char* fim;
+                peso = strtof(campos[3], &fim);
+                if (fim == campos[3] || *fim != '\0' || !(peso >= 0.0f && peso <= PESO_MAXIMO)) {
+                    printf("Erro: Peso invalido na linha %d (use um numero entre 0 e %g).\n", numeroLinha, (double)PESO_MAXIMO);
+                    return 0;
+                }
+            }
+            adicionarParPista(&construtor, campos[1], campos[2], peso);
+        } else if (strcmp(campos[0], "CULPADO") == 0 && quantidade == 2) {
+            construtor.culpado = guardarTextoNaMansao(&construtor, campos[1]);
+        } else {
+            printf("Erro: Linha %d invalida no cenario.\n", numeroLinha);
+            return 0;
+        }
+
+        linha = proxima;
+    }
+
+    return concluirMansao(&construtor, mansao);
+}
+
+int secaoNoArquivo(uint64_t deslocamento, uint64_t tamanhoSecao, uint64_t alinhamento, size_t tamanho) {
+    // Subtrai em vez de somar: um deslocamento corrompido nao da a volta
+    return deslocamento % alinhamento == 0 && deslocamento <= tamanho && tamanhoSecao <= tamanho - deslocamento;
+}
+
+int validarCenarioBinario(const unsigned char* dados, size_t tamanho) {
+    if (tamanho < sizeof(CabecalhoCenario)) {
+        return 0;
+    }
+
+    const CabecalhoCenario* cabecalho = (const CabecalhoCenario*)dados;
+    if (memcmp(cabecalho->assinatura, ASSINATURA_CENARIO, 4) != 0 || cabecalho->versao != VERSAO_CENARIO) {
+        return 0;
+    }
+
+    // Primeiro o cabecalho e os limites das secoes; depois uma passada
+    // so de leitura pelos indices guardados, sem hash nem busca
+    uint32_t passo = (cabecalho->numSuspeitos + LARGURA_VETOR_PESOS - 1) / LARGURA_VETOR_PESOS * LARGURA_VETOR_PESOS;
+    uint64_t celulasPesos = (uint64_t)cabecalho->numPistas * cabecalho->passoPesos;
+    if (cabecalho->numSalas == 0 || cabecalho->numSalas >= MAXIMO_SALAS || cabecalho->numSaidas >= MAXIMO_SAIDAS ||
+        cabecalho->arvore > 1 || cabecalho->tamanhoTextos == 0 || cabecalho->numSuspeitos > cabecalho->numPares ||
+        cabecalho->passoPesos != passo || cabecalho->capacidadeHash <= cabecalho->numPistas ||
+        (cabecalho->capacidadeHash & (cabecalho->capacidadeHash - 1)) != 0 || celulasPesos > tamanho / sizeof(float)) {
+        return 0;
+    }
+    if (!secaoNoArquivo(cabecalho->deslocamentoInicioSaidas, ((uint64_t)cabecalho->numSalas + 1) * sizeof(uint32_t), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoSaidas, (uint64_t)cabecalho->numSaidas * sizeof(Saida), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoTextosSala, (uint64_t)cabecalho->numSalas * sizeof(TextoSala), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoPares, (uint64_t)cabecalho->numPares * sizeof(ParPistaSuspeito), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoRumos, (uint64_t)cabecalho->numSalas * sizeof(uint32_t), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoPistasSala, (uint64_t)cabecalho->numSalas * sizeof(uint32_t), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoPistas, (uint64_t)cabecalho->numPistas * sizeof(PistaCenario), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoSuspeitos, (uint64_t)cabecalho->numSuspeitos * sizeof(uint32_t), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoEntradas, (uint64_t)cabecalho->capacidadeHash * sizeof(HashNode), 4, tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoPesos, celulasPesos * sizeof(float), LARGURA_VETOR_PESOS * sizeof(float), tamanho) ||
+        !secaoNoArquivo(cabecalho->deslocamentoTextos, cabecalho->tamanhoTextos, 1, tamanho)) {
+        return 0;
+    }
+
+    const char* textos = (const char*)dados + cabecalho->deslocamentoTextos;
+    return textos[0] == '\0' && textos[cabecalho->tamanhoTextos - 1] == '\0' && validarConteudoCenario(dados);
+}
+
+int validarConteudoCenario(const unsigned char* dados) {
+    // Todo indice do arquivo aponta para dentro da sua secao: o jogo usa
+    // saidas, rumos, ids e deslocamentos sem conferir de novo
+    const CabecalhoCenario* cabecalho = (const CabecalhoCenario*)dados;
+    uint32_t numSalas = cabecalho->numSalas;
+    uint32_t numPistas = cabecalho->numPistas;
+    uint32_t tamanhoTextos = cabecalho->tamanhoTextos;
+    if (!validarSaidas((const uint32_t*)(dados + cabecalho->deslocamentoInicioSaidas),
+                       (const Saida*)(dados + cabecalho->deslocamentoSaidas), numSalas,
+                       cabecalho->numSaidas, (int)cabecalho->arvore) ||
+        cabecalho->culpado >= tamanhoTextos) {
+        return 0;
+    }
+
+    // O Hall e o fim de todo rumo
+    const uint32_t* rumos = (const uint32_t*)(dados + cabecalho->deslocamentoRumos);
+    if (rumos[SALA_HALL] != SEM_SALA) {
+        return 0;
+    }
+    const uint32_t* pistasSala = (const uint32_t*)(dados + cabecalho->deslocamentoPistasSala);
+    const TextoSala* textosSala = (const TextoSala*)(dados + cabecalho->deslocamentoTextosSala);
+    for (uint32_t i = 0; i < numSalas; i++) {
+        if ((rumos[i] >= numSalas && rumos[i] != SEM_SALA) || (pistasSala[i] >= numPistas && pistasSala[i] != SEM_PISTA) ||
+            textosSala[i].nome >= tamanhoTextos || textosSala[i].pista >= tamanhoTextos) {
+            return 0;
+        }
+    }
+
+    const ParPistaSuspeito* pares = (const ParPistaSuspeito*)(dados + cabecalho->deslocamentoPares);
+    for (uint32_t i = 0; i < cabecalho->numPares; i++) {
+        if (pares[i].pista >= tamanhoTextos || pares[i].suspeito >= tamanhoTextos) {
+            return 0;
+        }
+    }
+    const PistaCenario* pistas = (const PistaCenario*)(dados + cabecalho->deslocamentoPistas);
+    for (uint32_t id = 0; id < numPistas; id++) {
+        if (pistas[id].texto >= tamanhoTextos || pistas[id].indiceSuspeito < -1 ||
+            pistas[id].indiceSuspeito >= (int32_t)cabecalho->numSuspeitos) {
+            return 0;
+        }
+    }
+    const uint32_t* suspeitos = (const uint32_t*)(dados + cabecalho->deslocamentoSuspeitos);
+    for (uint32_t i = 0; i < cabecalho->numSuspeitos; i++) {
+        if (suspeitos[i] >= tamanhoTextos) {
+            return 0;
+        }
+    }
+
+    // Com mais entradas ocupadas que pistas a sondagem poderia nao achar vaga
+    const HashNode* entradas = (const HashNode*)(dados + cabecalho->deslocamentoEntradas);
+    uint32_t ocupadas = 0;
+    for (uint32_t i = 0; i < cabecalho->capacidadeHash; i++) {
+        if (entradas[i].hash != 0) {
+            if (entradas[i].idPista >= numPistas) {
+                return 0;
+            }
+            ocupadas++;
+        }
+    }
+    return ocupadas <= numPistas;
+}
+
+void* mapearArquivo(const char* caminho, size_t* tamanho) {
+    void* dados = NULL;
+
+#ifdef _WIN32
+    // Sem mmap: le o arquivo inteiro para um bloco proprio
+    FILE* arquivo = fopen(caminho, "rb");
+    if (arquivo == NULL) {
+        printf("Erro: Nao foi possivel abrir o arquivo %s.\n", caminho);
+        return NULL;
+    }
+    fseek(arquivo, 0, SEEK_END);
+    long fim = ftell(arquivo);
+    fseek(arquivo, 0, SEEK_SET);
+    dados = fim > 0 ? malloc((size_t)fim) : NULL;
+    if (dados == NULL || fread(dados, 1, (size_t)fim, arquivo) != (size_t)fim) {
+        printf("Erro: Nao foi possivel ler o arquivo %s.\n", caminho);
+        free(dados);
+        fclose(arquivo);
+        return NULL;
+    }
+    fclose(arquivo);
+    *tamanho = (size_t)fim;
+#else
+    int descritor = open(caminho, O_RDONLY);
+    if (descritor < 0) {
+        printf("Erro: Nao foi possivel abrir o arquivo %s.\n", caminho);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(descritor, &info) != 0 || info.st_size <= 0) {
+        printf("Erro: Nao foi possivel ler o arquivo %s.\n", caminho);
+        close(descritor);
+        return NULL;
+    }
+    *tamanho = (size_t)info.st_size;
+    dados = mmap(NULL, *tamanho, PROT_READ, MAP_PRIVATE, descritor, 0);
+    close(descritor);
+    if (dados == MAP_FAILED) {
+        printf("Erro: Nao foi possivel mapear o arquivo %s.\n", caminho);
+        return NULL;
+    }
+#endif
+
+    return dados;
+}
+
+void desmapearArquivo(void* dados, size_t tamanho) {
+#ifdef _WIN32
+    (void)tamanho;
+    free(dados);
+#else
+    munmap(dados, tamanho);
+#endif
+}
+
+int mapearCenarioBinario(const char* caminho, Mansao* mansao) {
+    size_t tamanho = 0;
+    void* dados = mapearArquivo(caminho, &tamanho);
+    if (dados == NULL) {
+        return 0;
+    }
+
+    mansao->mapeamento = dados;
+    mansao->tamanhoMapeamento = tamanho;
+    if (!validarCenarioBinario((const unsigned char*)dados, tamanho)) {
+        printf("Erro: Arquivo de cenario compilado invalido: %s.\n", caminho);
+        liberarMansao(mansao);
+        return 0;
+    }
+
+    // Uso direto do arquivo: salas, rumos e ids das pistas nao sao
+    // copiados, convertidos nem calculados
+    const unsigned char* base = (const unsigned char*)dados;
+    const CabecalhoCenario* cabecalho = (const CabecalhoCenario*)base;
+    mansao->inicioSaidas = (const uint32_t*)(base + cabecalho->deslocamentoInicioSaidas);
+    mansao->saidas = (const Saida*)(base + cabecalho->deslocamentoSaidas);
+    mansao->numSaidas = cabecalho->numSaidas;
+    mansao->arvore = (int)cabecalho->arvore;
+    mansao->rumoAoHall = (const uint32_t*)(base + cabecalho->deslocamentoRumos);
+    mansao->textosSala = (const TextoSala*)(base + cabecalho->deslocamentoTextosSala);
+    mansao->numSalas = cabecalho->numSalas;
+    mansao->pares = (const ParPistaSuspeito*)(base + cabecalho->deslocamentoPares);
+    mansao->numPares = cabecalho->numPares;
+    mansao->textos = (const char*)(base + cabecalho->deslocamentoTextos);
+    mansao->tamanhoTextos = cabecalho->tamanhoTextos;
+    mansao->culpado = cabecalho->culpado;
+    mansao->pistasInternadas = (const uint32_t*)(base + cabecalho->deslocamentoPistasSala);
+    mansao->procedural = NULL;
+
+    return 1;
+}
+
+TabelaHash* abrirTabelaDoCenario(Arena* arena, const Mansao* mansao) {
+    // Como na tabela embutida, entradas e matriz sao lidas direto do
+    // arquivo e nenhum caminho de carga escreve nelas. So os ponteiros de
+    // texto das pistas e dos suspeitos sao montados, sem hash nem strcmp
+    const unsigned char* base = (const unsigned char*)mansao->mapeamento;
+    const CabecalhoCenario* cabecalho = (const CabecalhoCenario*)base;
+    TabelaHash* tabela = (TabelaHash*)alocarNaArena(arena, sizeof(TabelaHash));
+    memset(tabela, 0, sizeof(TabelaHash));
+    tabela->arena = arena;
+    tabela->entradas = (HashNode*)(base + cabecalho->deslocamentoEntradas);
+    tabela->capacidade = cabecalho->capacidadeHash;
+    tabela->quantidade = cabecalho->numPistas;
+    tabela->pesos = (float*)(base + cabecalho->deslocamentoPesos);
+    tabela->passoPesos = cabecalho->passoPesos;
+    tabela->indiceCulpado = -1;
+
+    const uint32_t* suspeitos = (const uint32_t*)(base + cabecalho->deslocamentoSuspeitos);
+    tabela->suspeitos = (const char**)alocarNaArena(arena, ((size_t)cabecalho->numSuspeitos + 1) * sizeof(char*));
+    tabela->numSuspeitos = (int)cabecalho->numSuspeitos;
+    tabela->capacidadeSuspeitos = (int)cabecalho->numSuspeitos;
+    inicializarIndiceBusca(&tabela->indiceSuspeitos, arena);
+    for (uint32_t i = 0; i < cabecalho->numSuspeitos; i++) {
+        tabela->suspeitos[i] = textoDaMansao(mansao, suspeitos[i]);
+        indexarTexto(&tabela->indiceSuspeitos, tabela->suspeitos[i], i);
+    }
+
+    const PistaCenario* pistas = (const PistaCenario*)(base + cabecalho->deslocamentoPistas);
+    tabela->pistas = (PistaInternada*)alocarNaArena(arena, ((size_t)cabecalho->numPistas + 1) * sizeof(PistaInternada));
+    tabela->capacidadePistas = cabecalho->numPistas;
+    for (uint32_t id = 0; id < cabecalho->numPistas; id++) {
+        tabela->pistas[id].texto = textoDaMansao(mansao, pistas[id].texto);
+        tabela->pistas[id].hash = pistas[id].hash;
+        tabela->pistas[id].indiceSuspeito = pistas[id].indiceSuspeito;
+    }
+    return tabela;
+}
+
+int carregarCenario(Arena* arena, const char* caminho, Mansao* mansao) {
+    unsigned char assinatura[4] = {0};
+    FILE* arquivo = fopen(caminho, "rb");
+    if (arquivo == NULL) {
+        printf("Erro: Nao foi possivel abrir o arquivo %s.\n", caminho);
+        return 0;
+    }
+    size_t lidos = fread(assinatura, 1, sizeof(assinatura), arquivo);
+    fclose(arquivo);
+
+    if (lidos == sizeof(assinatura) && memcmp(assinatura, ASSINATURA_CENARIO, 4) == 0) {
+        return mapearCenarioBinario(caminho, mansao);
+    }
+
+    size_t tamanho = 0;
+    char* conteudo = lerArquivoNaArena(arena, caminho, &tamanho);
+    if (conteudo == NULL) {
+        return 0;
+    }
+    return carregarCenarioTexto(arena, conteudo, tamanho, mansao);
+}
+
+uint64_t alinharDeslocamento(uint64_t deslocamento, uint64_t alinhamento) {
+    return (deslocamento + alinhamento - 1) / alinhamento * alinhamento;
+}
+
+int gravarSecao(FILE* arquivo, uint64_t* posicao, uint64_t deslocamento, const void* dados, size_t tamanho) {
+    // Completa com zeros ate o deslocamento alinhado da secao
+    static const unsigned char zeros[LARGURA_VETOR_PESOS * sizeof(float)] = {0};
+    while (*posicao < deslocamento) {
+        size_t falta = (size_t)(deslocamento - *posicao) < sizeof(zeros) ? (size_t)(deslocamento - *posicao) : sizeof(zeros);
+        if (fwrite(zeros, 1, falta, arquivo) != falta) {
+            return 0;
+        }
+        *posicao += falta;
+    }
+    if (tamanho > 0 && fwrite(dados, 1, tamanho, arquivo) != tamanho) {
+        return 0;
+    }
+    *posicao += tamanho;
+    return 1;
+}
+
+int compilarCenario(const char* entrada, const char* saida) {
+    Arena arena;
+    inicializarArena(&arena);
+
+    Mansao mansao;
+    if (!carregarCenario(&arena, entrada, &mansao)) {
+        liberarArena(&arena);
+        return 0;
+    }
+
+    // A carga completa roda aqui, uma vez: o jogo so mapeia o resultado
+    TabelaHash* tabela = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+    carregarPistasDaMansao(tabela, &mansao);
+    internarPistasDaMansao(tabela, &mansao);
+
+    // Textos das pistas e nomes dos suspeitos viram deslocamentos do pool
+    uint32_t numPistas = (uint32_t)tabela->quantidade;
+    PistaCenario* pistas = (PistaCenario*)alocarNaArena(&arena, ((size_t)numPistas + 1) * sizeof(PistaCenario));
+    int sucesso = 1;
+    for (uint32_t id = 0; id < numPistas; id++) {
+        const char* texto = tabela->pistas[id].texto;
+        sucesso &= texto >= mansao.textos && texto < mansao.textos + mansao.tamanhoTextos;
+        pistas[id].texto = sucesso ? (uint32_t)(texto - mansao.textos) : 0;
+        pistas[id].hash = tabela->pistas[id].hash;
+        pistas[id].indiceSuspeito = tabela->pistas[id].indiceSuspeito;
+    }
+    uint32_t numSuspeitos = (uint32_t)tabela->numSuspeitos;
+    uint32_t* suspeitos = (uint32_t*)alocarNaArena(&arena, ((size_t)numSuspeitos + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < mansao.numPares; i++) {
+        int indice = buscarIndiceSuspeitoPorNome(tabela, textoDaMansao(&mansao, mansao.pares[i].suspeito));
+        if (indice >= 0) {
+            suspeitos[indice] = mansao.pares[i].suspeito;
+        }
+    }
+    if (!sucesso) {
+        printf("Erro: Pista fora do pool de textos em %s.\n", entrada);
+        liberarMansao(&mansao);
+        liberarArena(&arena);
+        return 0;
+    }
+
+    CabecalhoCenario cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.assinatura, ASSINATURA_CENARIO, 4);
+    cabecalho.versao = VERSAO_CENARIO;
+    cabecalho.numSalas = mansao.numSalas;
+    cabecalho.numPares = mansao.numPares;
+    cabecalho.tamanhoTextos = mansao.tamanhoTextos;
+    cabecalho.culpado = mansao.culpado;
+    cabecalho.numSaidas = mansao.numSaidas;
+    cabecalho.arvore = (uint32_t)mansao.arvore;
+    cabecalho.numPistas = numPistas;
+    cabecalho.numSuspeitos = numSuspeitos;
+    cabecalho.passoPesos = tabela->passoPesos;
+    cabecalho.capacidadeHash = (uint32_t)tabela->capacidade;
+    size_t tamanhoPesos = (size_t)numPistas * tabela->passoPesos * sizeof(float);
+    cabecalho.deslocamentoInicioSaidas = sizeof(CabecalhoCenario);
+    cabecalho.deslocamentoSaidas = cabecalho.deslocamentoInicioSaidas + ((uint64_t)mansao.numSalas + 1) * sizeof(uint32_t);
+    cabecalho.deslocamentoTextosSala = cabecalho.deslocamentoSaidas + (uint64_t)mansao.numSaidas * sizeof(Saida);
+    cabecalho.deslocamentoPares = cabecalho.deslocamentoTextosSala + (uint64_t)mansao.numSalas * sizeof(TextoSala);
+    cabecalho.deslocamentoRumos = cabecalho.deslocamentoPares + (uint64_t)mansao.numPares * sizeof(ParPistaSuspeito);
+    cabecalho.deslocamentoPistasSala = cabecalho.deslocamentoRumos + (uint64_t)mansao.numSalas * sizeof(uint32_t);
+    cabecalho.deslocamentoPistas = cabecalho.deslocamentoPistasSala + (uint64_t)mansao.numSalas * sizeof(uint32_t);
+    cabecalho.deslocamentoSuspeitos = cabecalho.deslocamentoPistas + (uint64_t)numPistas * sizeof(PistaCenario);
+    cabecalho.deslocamentoEntradas = cabecalho.deslocamentoSuspeitos + (uint64_t)numSuspeitos * sizeof(uint32_t);
+    // A matriz e lida com cargas alinhadas, como a da arena
+    cabecalho.deslocamentoPesos = alinharDeslocamento(cabecalho.deslocamentoEntradas + (uint64_t)tabela->capacidade * sizeof(HashNode),
+                                                      LARGURA_VETOR_PESOS * sizeof(float));
+    cabecalho.deslocamentoTextos = cabecalho.deslocamentoPesos + tamanhoPesos;
+
+    FILE* arquivo = fopen(saida, "wb");
+    uint64_t posicao = 0;
+    sucesso = arquivo != NULL &&
+        gravarSecao(arquivo, &posicao, 0, &cabecalho, sizeof(cabecalho)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoInicioSaidas, mansao.inicioSaidas, ((size_t)mansao.numSalas + 1) * sizeof(uint32_t)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoSaidas, mansao.saidas, (size_t)mansao.numSaidas * sizeof(Saida)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoTextosSala, mansao.textosSala, (size_t)mansao.numSalas * sizeof(TextoSala)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoPares, mansao.pares, (size_t)mansao.numPares * sizeof(ParPistaSuspeito)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoRumos, mansao.rumoAoHall, (size_t)mansao.numSalas * sizeof(uint32_t)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoPistasSala, mansao.pistasInternadas, (size_t)mansao.numSalas * sizeof(uint32_t)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoPistas, pistas, (size_t)numPistas * sizeof(PistaCenario)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoSuspeitos, suspeitos, (size_t)numSuspeitos * sizeof(uint32_t)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoEntradas, tabela->entradas, tabela->capacidade * sizeof(HashNode)) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoPesos, tabela->pesos, tamanhoPesos) &&
+        gravarSecao(arquivo, &posicao, cabecalho.deslocamentoTextos, mansao.textos, mansao.tamanhoTextos);
+    if (arquivo != NULL && fclose(arquivo) != 0) {
+        sucesso = 0;
+    }
+
+    if (sucesso) {
+        printf("Cenario compilado: %u salas, %u pistas -> %s\n", mansao.numSalas, mansao.numPares, saida);
+    } else {
+        printf("Erro: Nao foi possivel gravar o arquivo %s.\n", saida);
+    }
+
+    liberarMansao(&mansao);
+    liberarArena(&arena);
+    return sucesso;
+}
+
+void carregarPistasDaMansao(TabelaHash* tabela, const Mansao* mansao) {
+    // Carga em lote: as pistas dos pares e das salas (estas podem nao ter
+    // par) sao internadas de uma vez, ja em ordem alfabetica. Os textos
+    // ja vivem no pool da mansao (arena ou arquivo mapeado). Numa mansao
+    // procedural toda pista de sala sai dos pares: as salas nem existem ainda
+    uint32_t salasComTexto = mansao->procedural != NULL ? 0 : mansao->numSalas;
+    const char** textos = (const char**)alocarNaArena(tabela->arena, ((size_t)mansao->numPares + salasComTexto) * sizeof(char*));
+    uint32_t numTextos = 0;
+    for (uint32_t i = 0; i < mansao->numPares; i++) {
+        textos[numTextos++] = textoDaMansao(mansao, mansao->pares[i].pista);
+    }
+    for (uint32_t i = 0; i < salasComTexto; i++) {
+        if (pistaSala(mansao, NULL, i)[0] != '\0') {
+            textos[numTextos++] = pistaSala(mansao, NULL, i);
+        }
+    }
+    internarPistasEmLote(tabela, textos, numTextos);
+
+    if (tabela->capacidadePesosDeclarados < mansao->numPares) {
+        tabela->pesosDeclarados = (PesoDeclarado*)alocarNaArena(tabela->arena, (size_t)mansao->numPares * sizeof(PesoDeclarado));
+        tabela->capacidadePesosDeclarados = mansao->numPares;
+    }
+    for (uint32_t i = 0; i < mansao->numPares; i++) {
+        // Peso de um arquivo mapeado ainda nao foi conferido: fora da faixa vale 0
+        const char* pista = textoDaMansao(mansao, mansao->pares[i].pista);
+        float peso = mansao->pares[i].peso;
+        uint32_t id = buscarIdPista(tabela, pista);
+        int indiceSuspeito = registrarSuspeito(tabela, textoDaMansao(mansao, mansao->pares[i].suspeito));
+        tabela->pistas[id].indiceSuspeito = indiceSuspeito;
+        declararPeso(tabela, tabela->pistas[id].texto, indiceSuspeito, peso >= 0.0f && peso <= PESO_MAXIMO ? peso : 0.0f);
+    }
+}
+
+void internarPistasDaMansao(TabelaHash* tabela, Mansao* mansao) {
+    // A tabela embutida e a de um cenario compilado ja vem ordenadas e
+    // com a matriz pronta, e as salas ja apontam para os ids; nas demais,
+    // carregarPistasDaMansao ja deu id tambem as pistas de sala sem par
+    if (tabela->pesos != NULL) {
         return;
     }
-    
-    liberarArvoreSalas(raiz->esquerda);
-    liberarArvoreSalas(raiz->direita);
-    free(raiz);
+
+    if (mansao->procedural != NULL) {
+        // Ids por par, nao por sala: gerarSala consulta o par sorteado
+        uint32_t* idsDosPares = (uint32_t*)alocarNaArena(tabela->arena, (size_t)mansao->numPares * sizeof(uint32_t));
+        for (uint32_t i = 0; i < mansao->numPares; i++) {
+            idsDosPares[i] = buscarIdPista(tabela, textoDaMansao(mansao, mansao->pares[i].pista));
+        }
+        mansao->procedural->idsDosPares = idsDosPares;
+        montarMatrizEvidencias(tabela);
+        return;
+    }
+
+    // Resolvido uma vez aqui, fica somente leitura para todas as sessoes
+    uint32_t* ids = (uint32_t*)alocarNaArena(tabela->arena, (size_t)mansao->numSalas * sizeof(uint32_t));
+    for (uint32_t i = 0; i < mansao->numSalas; i++) {
+        ids[i] = pistaSala(mansao, NULL, i)[0] != '\0' ? buscarIdPista(tabela, pistaSala(mansao, NULL, i)) : SEM_PISTA;
+    }
+    mansao->pistasInternadas = ids;
+    montarMatrizEvidencias(tabela);
 }
 
-void finalizarJogo(Sala* hallEntrada, PistaNode* raizPistas, HashNode** tabelaHash, int tamanhoHash) {
-    gerarRelatorioFinal(raizPistas);
-    verificarSuspeitoFinal(raizPistas, tabelaHash, tamanhoHash);
-    
-    // Revelar o culpado real se o jogador nao acertou
-    printf("\nDeseja saber quem era o verdadeiro culpado? (s/n): ");
-    char resposta;
-    scanf(" %c", &resposta);
-    if (resposta == 's' || resposta == 'S') {
-        revelarCulpadoReal();
+void liberarMansao(Mansao* mansao) {
+    if (mansao->mapeamento == NULL) {
+        return; // salas e textos estao na arena
+    }
+    desmapearArquivo(mansao->mapeamento, mansao->tamanhoMapeamento);
+    mansao->mapeamento = NULL;
+    mansao->tamanhoMapeamento = 0;
+}
+
+// --- Pistas (BST balanceada AVL)
+
+PistaNode* criarNoPista(Arena* arena, PistaNode** livres, uint32_t idPista) {
+    // Reaproveita um no devolvido antes de pedir memoria a arena
+    PistaNode* novoNo = *livres;
+    if (novoNo != NULL) {
+        *livres = novoNo->esquerda;
+    } else {
+        novoNo = (PistaNode*)alocarNaArena(arena, sizeof(PistaNode));
     }
     
-    liberarArvoreSalas(hallEntrada);
-    liberarArvorePistas(raizPistas);
-    liberarTabelaHash(tabelaHash, tamanhoHash);
+    novoNo->idPista = idPista;
+    novoNo->esquerda = NULL;
+    novoNo->direita = NULL;
+    novoNo->altura = 1;
+    novoNo->referencias = 1; // a de quem pediu o no
+    
+    return novoNo;
 }
 
-// --- Principal
+PistaNode* reterPista(PistaNode* no) {
+    if (no != NULL) {
+        no->referencias++;
+    }
+    return no;
+}
+
+void soltarPista(PistaNode** livres, PistaNode* no) {
+    // Sem pai nem versao apontando, o no volta para a lista livre e solta
+    // os filhos; um no compartilhado so perde a referencia. A recursao so
+    // desce por nos liberados, entao fica na altura da arvore
+    if (no == NULL || --no->referencias > 0) {
+        return;
+    }
+    PistaNode* esquerda = no->esquerda;
+    PistaNode* direita = no->direita;
+    no->esquerda = *livres;
+    *livres = no;
+    soltarPista(livres, esquerda);
+    soltarPista(livres, direita);
+}
+
+int alturaPista(PistaNode* no) {
+    return no != NULL ? no->altura : 0;
+}
+
+void atualizarAlturaPista(PistaNode* no) {
+    int alturaEsquerda = alturaPista(no->esquerda);
+    int alturaDireita = alturaPista(no->direita);
+    no->altura = 1 + (alturaEsquerda > alturaDireita ? alturaEsquerda : alturaDireita);
+}
 
-int main() {
-    Sala* hallEntrada = montarMapaMansao();
-    PistaNode* raizPistas = NULL;
-    HashNode** tabelaHash = criarTabelaHash(TAMANHO_HASH);
-    inicializarTabelaHash(tabelaHash, TAMANHO_HASH);
+PistaNode* rotacionarDireita(PistaNode* raiz) {
+    PistaNode* novaRaiz = raiz->esquerda;
+    raiz->esquerda = novaRaiz->direita;
+    novaRaiz->direita = raiz;
+    atualizarAlturaPista(raiz);
+    atualizarAlturaPista(novaRaiz);
+    return novaRaiz;
+}
 
-    mostrarBoasVindas();
-    getchar();
+PistaNode* rotacionarEsquerda(PistaNode* raiz) {
+    PistaNode* novaRaiz = raiz->direita;
+    raiz->direita = novaRaiz->esquerda;
+    novaRaiz->esquerda = raiz;
+    atualizarAlturaPista(raiz);
+    atualizarAlturaPista(novaRaiz);
+    return novaRaiz;
+}
 
-    explorarSalasComPistas(hallEntrada, &raizPistas, tabelaHash, TAMANHO_HASH, hallEntrada);
-    finalizarJogo(hallEntrada, raizPistas, tabelaHash, TAMANHO_HASH);
+PistaNode* balancearPista(PistaNode* raiz) {
+    atualizarAlturaPista(raiz);
+    // Desequilibrio so existe com o filho (e o neto) mais alto presente;
+    // os testes explicitos deixam isso visivel tambem para o compilador
+    PistaNode* esquerda = raiz->esquerda;
+    PistaNode* direita = raiz->direita;
+    int fator = alturaPista(esquerda) - alturaPista(direita);
 
-    return 0;
-}
\ No newline at end of file
+    if (fator > 1 && esquerda != NULL) {
+        // Caso esquerda-direita vira esquerda-esquerda
+        PistaNode* neto = esquerda->direita;
+        if (neto != NULL && alturaPista(esquerda->esquerda) < neto->altura) {
+            raiz->esquerda = rotacionarEsquerda(esquerda);
+        }
+        return rotacionarDireita(raiz);
+    }
+    if (fator < -1 && direita != NULL) {
+        // Caso direita-esquerda vira direita-direita
+        PistaNode* neto = direita->esquerda;
+        if (neto != NULL && alturaPista(direita->direita) < neto->altura) {
+            raiz->direita = rotacionarDireita(direita);
+        }
+        return rotacionarEsquerda(raiz);
+    }
+    
+    return raiz;
+}
+
+PistaNode* copiarCaminhoPista(Arena* arena, PistaNode** livres, const PistaNode* raiz, uint32_t idPista) {
+    if (raiz == NULL) {
+        return criarNoPista(arena, livres, idPista);
+    }
+    
+    // A copia divide o filho fora do caminho com a versao anterior. As
+    // rotacoes so mexem em copias: quem muda de pai e sempre uma copia ou
+    // uma subarvore que troca um pai novo por outro, sem mudar a contagem
+    PistaNode* copia = criarNoPista(arena, livres, raiz->idPista);
+    if (idPista < raiz->idPista) {
+        copia->esquerda = copiarCaminhoPista(arena, livres, raiz->esquerda, idPista);
+        copia->direita = reterPista(raiz->direita);
+    } else {
+        copia->esquerda = reterPista(raiz->esquerda);
+        copia->direita = copiarCaminhoPista(arena, livres, raiz->direita, idPista);
+    }
+    
+    // A altura AVL fica abaixo de 1.44*log2(n), entao a recursao e rasa
+    return balancearPista(copia);
+}
+
+PistaNode* inserirPista(Arena* arena, PistaNode** livres, PistaNode* raiz, uint32_t idPista) {
+    // Devolve uma versao nova com referencia propria; a antiga continua
+    // valida ate quem a tem chamar soltarPista. O(log n) nos novos
+    if (buscarPista(raiz, idPista) != NULL) {
+        return reterPista(raiz); // pista repetida nao altera a arvore
+    }
+    return copiarCaminhoPista(arena, livres, raiz, idPista);
+}
+
+PistaNode* buscarPista(PistaNode* raiz, uint32_t idPista) {
+    while (raiz != NULL) {
+        if (idPista == raiz->idPista) {
+            return raiz;
+        }
+        raiz = idPista < raiz->idPista ? raiz->esquerda : raiz->direita;
+    }
+    return NULL;
+}
+
+PistaNode* ligarPistasOrdenadas(PistaNode* nos, const uint32_t* ids, uint32_t inicio, uint32_t fim) {
+    // O meio do intervalo vira a raiz: as metades diferem em no maximo um
+    // no, entao a arvore sai perfeitamente balanceada e ja valida como AVL
+    if (inicio >= fim) {
+        return NULL;
+    }
+    uint32_t meio = inicio + (fim - inicio) / 2;
+    PistaNode* raiz = &nos[meio];
+    raiz->idPista = ids[meio];
+    raiz->referencias = 1;
+    raiz->esquerda = ligarPistasOrdenadas(nos, ids, inicio, meio);
+    raiz->direita = ligarPistasOrdenadas(nos, ids, meio + 1, fim);
+    atualizarAlturaPista(raiz);
+    return raiz;
+}
+
+PistaNode* construirPistasOrdenadas(Arena* arena, const uint32_t* ids, uint32_t quantidade) {
+    // Ids em ordem estritamente crescente: O(n), um bloco para todos os nos
+    // e recursao de profundidade log2(n), sem nenhuma comparacao
+    if (quantidade == 0) {
+        return NULL;
+    }
+    PistaNode* nos = (PistaNode*)alocarNaArena(arena, (size_t)quantidade * sizeof(PistaNode));
+    return ligarPistasOrdenadas(nos, ids, 0, quantidade);
+}
+
+void inicializarCaderno(Caderno* caderno, Arena* arena, const TabelaHash* tabela) {
+    caderno->raiz = NULL;
+    caderno->totalPistas = 0;
+    caderno->salaDaVersao = SEM_SALA;
+    caderno->pistaDaVersao = SEM_PISTA;
+    caderno->numSuspeitos = tabela->numSuspeitos;
+    caderno->pontuacao = criarVetorPontuacao(arena, tabela);
+    caderno->tabela = tabela;
+    inicializarIndiceBusca(&caderno->palavras, arena);
+    caderno->livres = NULL;
+    caderno->historico = (VersaoCaderno*)alocarNaArena(arena, MAXIMO_VERSOES_CADERNO * sizeof(VersaoCaderno));
+    for (int i = 0; i < MAXIMO_VERSOES_CADERNO; i++) {
+        caderno->historico[i].pontuacao = criarVetorPontuacao(arena, tabela);
+    }
+    caderno->inicioHistorico = 0;
+    caderno->numHistorico = 0;
+}
+
+void guardarVersaoNoHistorico(Caderno* caderno) {
+    // A referencia da versao atual passa para o historico. Cheio, o anel
+    // esquece a versao mais antiga e devolve os nos que so ela usava
+    if (caderno->numHistorico == MAXIMO_VERSOES_CADERNO) {
+        soltarPista(&caderno->livres, caderno->historico[caderno->inicioHistorico].raiz);
+        caderno->inicioHistorico = (caderno->inicioHistorico + 1) % MAXIMO_VERSOES_CADERNO;
+        caderno->numHistorico--;
+    }
+    VersaoCaderno* versao = &caderno->historico[(caderno->inicioHistorico + caderno->numHistorico) % MAXIMO_VERSOES_CADERNO];
+    versao->raiz = caderno->raiz;
+    versao->totalPistas = caderno->totalPistas;
+    versao->sala = caderno->salaDaVersao;
+    versao->idPista = caderno->pistaDaVersao;
+    memcpy(versao->pontuacao, caderno->pontuacao, (size_t)caderno->tabela->passoPesos * sizeof(float));
+    caderno->numHistorico++;
+}
+
+void limparHistoricoCaderno(Caderno* caderno) {
+    while (caderno->numHistorico > 0) {
+        soltarPista(&caderno->livres, caderno->historico[caderno->inicioHistorico].raiz);
+        caderno->inicioHistorico = (caderno->inicioHistorico + 1) % MAXIMO_VERSOES_CADERNO;
+        caderno->numHistorico--;
+    }
+}
+
+int registrarPistaNoCaderno(Arena* arena, Caderno* caderno, uint32_t idPista, uint32_t sala) {
+    if (buscarPista(caderno->raiz, idPista) != NULL) {
+        return 0; // ja anotada: a pontuacao nao muda
+    }
+    
+    guardarVersaoNoHistorico(caderno);
+    caderno->raiz = copiarCaminhoPista(arena, &caderno->livres, caderno->raiz, idPista);
+    caderno->totalPistas++;
+    caderno->salaDaVersao = sala;
+    caderno->pistaDaVersao = idPista;
+    indexarTexto(&caderno->palavras, textoPista(caderno->tabela, idPista), idPista);
+    // Placar ao vivo: uma soma vetorial da linha da pista
+    const float* linha = linhaDePesos(caderno->tabela, idPista);
+    if (linha != NULL) {
+        somarLinhaPesos(caderno->pontuacao, linha, caderno->tabela->passoPesos);
+    }
+    return 1;
+}
+
+int desfazerPistaNoCaderno(Caderno* caderno, uint32_t* sala) {
+    // Volta para a versao anterior e devolve a sala da pista desfeita. O
+    // placar volta a copia guardada com a versao (subtrair floats nao
+    // desfaz a soma) e so as palavras da pista desfeita saem do indice
+    if (caderno->numHistorico == 0) {
+        return 0;
+    }
+    *sala = caderno->salaDaVersao;
+    removerTexto(&caderno->palavras, textoPista(caderno->tabela, caderno->pistaDaVersao), caderno->pistaDaVersao);
+    soltarPista(&caderno->livres, caderno->raiz);
+    caderno->numHistorico--;
+    const VersaoCaderno* versao =
+        &caderno->historico[(caderno->inicioHistorico + caderno->numHistorico) % MAXIMO_VERSOES_CADERNO];
+    caderno->raiz = versao->raiz;
+    caderno->totalPistas = versao->totalPistas;
+    caderno->salaDaVersao = versao->sala;
+    caderno->pistaDaVersao = versao->idPista;
+    memcpy(caderno->pontuacao, versao->pontuacao, (size_t)caderno->tabela->passoPesos * sizeof(float));
+    return 1;
+}
+
+int carregarPistasNoCaderno(Arena* arena, Caderno* caderno, const uint32_t* ids, uint32_t quantidade) {
+    // Carga de um caderno vazio, como ao retomar um salvamento. Ids fora
+    // de ordem, repetidos ou desconhecidos recusam a carga inteira
+    if (caderno->raiz != NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < quantidade; i++) {
+        if (ids[i] >= caderno->tabela->quantidade || (i > 0 && ids[i] <= ids[i - 1])) {
+            return 0;
+        }
+    }
+
+    caderno->raiz = construirPistasOrdenadas(arena, ids, quantidade);
+    caderno->totalPistas = (int)quantidade;
+    for (uint32_t i = 0; i < quantidade; i++) {
+        indexarTexto(&caderno->palavras, textoPista(caderno->tabela, ids[i]), ids[i]);
+        const float* linha = linhaDePesos(caderno->tabela, ids[i]);
+        if (linha != NULL) {
+            somarLinhaPesos(caderno->pontuacao, linha, caderno->tabela->passoPesos);
+        }
+    }
+    return 1;
+}
+
+void descerPelaEsquerda(IteradorPistas* iterador, const PistaNode* no) {
+    while (no != NULL) {
+        iterador->pilha[iterador->topo++] = no;
+        no = no->esquerda;
+    }
+}
+
+void iniciarIteradorPistas(IteradorPistas* iterador, const PistaNode* raiz) {
+    iterador->topo = 0;
+    descerPelaEsquerda(iterador, raiz);
+}
+
+const PistaNode* proximaPista(IteradorPistas* iterador) {
+    // Para sair antes do fim basta parar de chamar: nada a liberar
+    if (iterador->topo == 0) {
+        return NULL;
+    }
+    const PistaNode* no = iterador->pilha[--iterador->topo];
+    descerPelaEsquerda(iterador, no->direita);
+    return no;
+}
+
+void exibirPistasEmOrdem(Terminal* terminal, const TabelaHash* tabela, PistaNode* raiz) {
+    IteradorPistas iterador;
+    iniciarIteradorPistas(&iterador, raiz);
+    for (const PistaNode* no = proximaPista(&iterador); no != NULL; no = proximaPista(&iterador)) {
+        exibir(terminal, "- %s\n", textoPista(tabela, no->idPista));
+    }
+}
+
+// --- Busca (arvore radix de palavras)
+//
+// Cada palavra de um texto indexado vira uma chave, sem diferenca de
+// maiusculas. Um termo da consulta casa com toda palavra que comeca por
+// ele; com varios termos o texto precisa casar com todos. A consulta
+// percorre so a subarvore do termo mais raro e confere os demais no
+// proprio texto, entao para assim que junta os resultados pedidos.
+
+int caractereDePalavra(unsigned char c) {
+    // Bytes acima de 127 sao partes de letras acentuadas em UTF-8
+    return c >= 0x80 || isalnum(c);
+}
+
+char minuscula(char c) {
+    // Sem tolower: nao depende da localidade e nao mexe em bytes UTF-8
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+void inicializarIndiceBusca(IndiceBusca* indice, Arena* arena) {
+    memset(&indice->raiz, 0, sizeof(NoBusca));
+    indice->raiz.rotulo = "";
+    indice->arena = arena;
+    indice->livres = NULL;
+}
+
+NoBusca* criarNoBusca(IndiceBusca* indice, const char* rotulo, uint32_t tamanho) {
+    NoBusca* no = (NoBusca*)alocarNaArena(indice->arena, sizeof(NoBusca));
+    memset(no, 0, sizeof(NoBusca));
+    no->rotulo = rotulo;
+    no->tamanhoRotulo = tamanho;
+    return no;
+}
+
+void indexarPalavra(IndiceBusca* indice, const char* palavra, uint32_t tamanho, const char* texto, uint32_t id, uint32_t posicao) {
+    NoBusca* no = &indice->raiz;
+    uint32_t usado = 0;
+    no->total++;
+
+    while (usado < tamanho) {
+        char letra = minuscula(palavra[usado]);
+        NoBusca** elo = &no->filho;
+        while (*elo != NULL && (unsigned char)minuscula((*elo)->rotulo[0]) < (unsigned char)letra) {
+            elo = &(*elo)->irmao;
+        }
+
+        NoBusca* filho = *elo;
+        if (filho == NULL || minuscula(filho->rotulo[0]) != letra) {
+            // Nenhum filho com esta letra: o resto da palavra vira um no so
+            NoBusca* novo = criarNoBusca(indice, palavra + usado, tamanho - usado);
+            novo->irmao = filho;
+            *elo = novo;
+            no = novo;
+            no->total++;
+            break;
+        }
+
+        uint32_t comum = 1;
+        while (comum < filho->tamanhoRotulo && usado + comum < tamanho &&
+               minuscula(filho->rotulo[comum]) == minuscula(palavra[usado + comum])) {
+            comum++;
+        }
+        if (comum < filho->tamanhoRotulo) {
+            // Divide a aresta: o trecho comum sobe para um no intermediario
+            NoBusca* meio = criarNoBusca(indice, filho->rotulo, comum);
+            meio->irmao = filho->irmao;
+            meio->filho = filho;
+            meio->total = filho->total;
+            filho->irmao = NULL;
+            filho->rotulo += comum;
+            filho->tamanhoRotulo -= comum;
+            *elo = meio;
+            filho = meio;
+        }
+
+        no = filho;
+        no->total++;
+        usado += comum;
+    }
+
+    OcorrenciaBusca* ocorrencia = indice->livres;
+    if (ocorrencia != NULL) {
+        indice->livres = ocorrencia->proxima;
+    } else {
+        ocorrencia = (OcorrenciaBusca*)alocarNaArena(indice->arena, sizeof(OcorrenciaBusca));
+    }
+    ocorrencia->texto = texto;
+    ocorrencia->id = id;
+    ocorrencia->posicao = posicao;
+    ocorrencia->proxima = NULL;
+    ocorrencia->anterior = no->ultima;
+    if (no->ultima != NULL) {
+        no->ultima->proxima = ocorrencia;
+    } else {
+        no->ocorrencias = ocorrencia;
+    }
+    no->ultima = ocorrencia;
+    no->quantidade++;
+}
+
+void indexarTexto(IndiceBusca* indice, const char* texto, uint32_t id) {
+    uint32_t posicao = 0;
+    const char* c = texto;
+    while (*c != '\0') {
+        if (!caractereDePalavra((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+        const char* inicio = c;
+        while (caractereDePalavra((unsigned char)*c)) {
+            c++;
+        }
+        uint32_t tamanho = (uint32_t)(c - inicio);
+        indexarPalavra(indice, inicio, tamanho < TAMANHO_MAXIMO_PALAVRA ? tamanho : TAMANHO_MAXIMO_PALAVRA,
+                       texto, id, posicao++);
+    }
+}
+
+int removerPalavra(IndiceBusca* indice, const char* palavra, uint32_t tamanho, uint32_t id, uint32_t posicao) {
+    // Desce pela palavra inteira guardando o caminho; os nos ficam mesmo
+    // vazios e voltam a servir se a palavra for indexada de novo
+    NoBusca* caminho[TAMANHO_MAXIMO_PALAVRA + 1];
+    int profundidade = 0;
+    NoBusca* no = &indice->raiz;
+    uint32_t usado = 0;
+    caminho[profundidade++] = no;
+    while (usado < tamanho) {
+        char letra = minuscula(palavra[usado]);
+        NoBusca* filho = no->filho;
+        while (filho != NULL && minuscula(filho->rotulo[0]) != letra) {
+            filho = filho->irmao;
+        }
+        if (filho == NULL || usado + filho->tamanhoRotulo > tamanho) {
+            return 0;
+        }
+        for (uint32_t k = 1; k < filho->tamanhoRotulo; k++) {
+            if (minuscula(filho->rotulo[k]) != minuscula(palavra[usado + k])) {
+                return 0;
+            }
+        }
+        usado += filho->tamanhoRotulo;
+        no = filho;
+        caminho[profundidade++] = no;
+    }
+
+    // A ocorrencia desfeita costuma ser a ultima da lista
+    OcorrenciaBusca* ocorrencia = no->ultima;
+    while (ocorrencia != NULL && (ocorrencia->id != id || ocorrencia->posicao != posicao)) {
+        ocorrencia = ocorrencia->anterior;
+    }
+    if (ocorrencia == NULL) {
+        return 0;
+    }
+    if (ocorrencia->anterior != NULL) {
+        ocorrencia->anterior->proxima = ocorrencia->proxima;
+    } else {
+        no->ocorrencias = ocorrencia->proxima;
+    }
+    if (ocorrencia->proxima != NULL) {
+        ocorrencia->proxima->anterior = ocorrencia->anterior;
+    } else {
+        no->ultima = ocorrencia->anterior;
+    }
+    ocorrencia->proxima = indice->livres;
+    indice->livres = ocorrencia;
+    no->quantidade--;
+    for (int i = 0; i < profundidade; i++) {
+        caminho[i]->total--;
+    }
+    return 1;
+}
+
+void removerTexto(IndiceBusca* indice, const char* texto, uint32_t id) {
+    // Mesma separacao de palavras de indexarTexto
+    uint32_t posicao = 0;
+    const char* c = texto;
+    while (*c != '\0') {
+        if (!caractereDePalavra((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+        const char* inicio = c;
+        while (caractereDePalavra((unsigned char)*c)) {
+            c++;
+        }
+        uint32_t tamanho = (uint32_t)(c - inicio);
+        removerPalavra(indice, inicio, tamanho < TAMANHO_MAXIMO_PALAVRA ? tamanho : TAMANHO_MAXIMO_PALAVRA, id, posicao++);
+    }
+}
+
+uint32_t iniciarCursorBusca(CursorBusca* cursor, const IndiceBusca* indice, const char* prefixo, uint32_t tamanho) {
+    // Desce ate o no cuja subarvore guarda todas as palavras com o prefixo;
+    // devolve quantas ocorrencias ha nela (0 se nenhuma)
+    const NoBusca* no = &indice->raiz;
+    uint32_t usado = 0;
+    cursor->topo = 0;
+    cursor->palavra[0] = '\0';
+    if (tamanho > TAMANHO_MAXIMO_PALAVRA) {
+        tamanho = TAMANHO_MAXIMO_PALAVRA;
+    }
+
+    while (usado < tamanho) {
+        const NoBusca* filho = no->filho;
+        char letra = minuscula(prefixo[usado]);
+        while (filho != NULL && minuscula(filho->rotulo[0]) != letra) {
+            filho = filho->irmao;
+        }
+        if (filho == NULL) {
+            return 0;
+        }
+        uint32_t comum = 1;
+        while (comum < filho->tamanhoRotulo && usado + comum < tamanho &&
+               minuscula(filho->rotulo[comum]) == minuscula(prefixo[usado + comum])) {
+            comum++;
+        }
+        if (usado + comum < tamanho && comum < filho->tamanhoRotulo) {
+            return 0; // divergiu no meio do rotulo
+        }
+        if (usado + comum == tamanho) {
+            no = filho; // o prefixo termina dentro deste rotulo
+            break;
+        }
+        memcpy(cursor->palavra + usado, filho->rotulo, comum);
+        usado += comum;
+        no = filho;
+    }
+
+    // Ao sair do laco, usado e o tamanho da palavra ate o pai do no inicial
+    cursor->inicio = no;
+    cursor->pilha[0] = no;
+    cursor->base[0] = usado;
+    cursor->topo = 1;
+    return no->total;
+}
+
+const NoBusca* proximoNoBusca(CursorBusca* cursor) {
+    // Pre-ordem: o no, depois seus filhos, depois o proximo irmao. Cada
+    // nivel deixa no maximo um irmao pendente na pilha
+    if (cursor->topo == 0) {
+        return NULL;
+    }
+    cursor->topo--;
+    const NoBusca* no = cursor->pilha[cursor->topo];
+    uint32_t base = cursor->base[cursor->topo];
+    memcpy(cursor->palavra + base, no->rotulo, no->tamanhoRotulo);
+    cursor->palavra[base + no->tamanhoRotulo] = '\0';
+
+    if (no != cursor->inicio && no->irmao != NULL) {
+        cursor->pilha[cursor->topo] = no->irmao;
+        cursor->base[cursor->topo++] = base;
+    }
+    if (no->filho != NULL) {
+        cursor->pilha[cursor->topo] = no->filho;
+        cursor->base[cursor->topo++] = base + no->tamanhoRotulo;
+    }
+    return no;
+}
+
+int primeiraPalavraComPrefixo(const char* texto, const char* prefixo, uint32_t tamanho) {
+    // Mesma separacao de palavras de indexarTexto; -1 se nenhuma casa
+    int posicao = 0;
+    const char* c = texto;
+    while (*c != '\0') {
+        if (!caractereDePalavra((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+        uint32_t i = 0;
+        while (i < tamanho && caractereDePalavra((unsigned char)c[i]) && minuscula(c[i]) == minuscula(prefixo[i])) {
+            i++;
+        }
+        if (i == tamanho) {
+            return posicao;
+        }
+        while (caractereDePalavra((unsigned char)*c)) {
+            c++;
+        }
+        posicao++;
+    }
+    return -1;
+}
+
+int separarTermos(const char* consulta, const char* termos[], uint32_t tamanhos[], int maximo) {
+    // Termos alem do maximo sao ignorados
+    int numTermos = 0;
+    const char* c = consulta;
+    while (*c != '\0' && numTermos < maximo) {
+        if (!caractereDePalavra((unsigned char)*c)) {
+            c++;
+            continue;
+        }
+        termos[numTermos] = c;
+        while (caractereDePalavra((unsigned char)*c)) {
+            c++;
+        }
+        uint32_t tamanho = (uint32_t)(c - termos[numTermos]);
+        tamanhos[numTermos++] = tamanho < TAMANHO_MAXIMO_PALAVRA ? tamanho : TAMANHO_MAXIMO_PALAVRA;
+    }
+    return numTermos;
+}
+
+int consultarIndiceBusca(const IndiceBusca* indice, const char* consulta, uint32_t* ids, int maximo) {
+    const char* termos[MAX_TERMOS_BUSCA];
+    uint32_t tamanhos[MAX_TERMOS_BUSCA];
+    int numTermos = separarTermos(consulta, termos, tamanhos, MAX_TERMOS_BUSCA);
+    if (numTermos == 0 || maximo <= 0) {
+        return 0;
+    }
+
+    // O termo com menos ocorrencias define os candidatos
+    CursorBusca cursor;
+    int maisRaro = 0;
+    uint32_t menorTotal = UINT32_MAX;
+    for (int t = 0; t < numTermos; t++) {
+        uint32_t total = iniciarCursorBusca(&cursor, indice, termos[t], tamanhos[t]);
+        if (total == 0) {
+            return 0;
+        }
+        if (total < menorTotal) {
+            menorTotal = total;
+            maisRaro = t;
+        }
+    }
+
+    int encontrados = 0;
+    iniciarCursorBusca(&cursor, indice, termos[maisRaro], tamanhos[maisRaro]);
+    for (const NoBusca* no = proximoNoBusca(&cursor); no != NULL; no = proximoNoBusca(&cursor)) {
+        for (const OcorrenciaBusca* ocorrencia = no->ocorrencias; ocorrencia != NULL; ocorrencia = ocorrencia->proxima) {
+            // Um texto com duas palavras no prefixo so conta pela primeira
+            if (primeiraPalavraComPrefixo(ocorrencia->texto, termos[maisRaro], tamanhos[maisRaro]) != (int)ocorrencia->posicao) {
+                continue;
+            }
+            int casaTodos = 1;
+            for (int t = 0; t < numTermos && casaTodos; t++) {
+                casaTodos = t == maisRaro || primeiraPalavraComPrefixo(ocorrencia->texto, termos[t], tamanhos[t]) >= 0;
+            }
+            if (!casaTodos) {
+                continue;
+            }
+            ids[encontrados++] = ocorrencia->id;
+            if (encontrados == maximo) {
+                return encontrados;
+            }
+        }
+    }
+    return encontrados;
+}
+
+int completarPalavra(const IndiceBusca* indice, const char* prefixo, uint32_t tamanho, SugestaoBusca* sugestoes, int maximo) {
+    // Palavras indexadas que comecam pelo prefixo, em ordem alfabetica
+    CursorBusca cursor;
+    if (maximo <= 0 || iniciarCursorBusca(&cursor, indice, prefixo, tamanho) == 0) {
+        return 0;
+    }
+    int quantidade = 0;
+    for (const NoBusca* no = proximoNoBusca(&cursor); no != NULL; no = proximoNoBusca(&cursor)) {
+        if (no->quantidade == 0) {
+            continue;
+        }
+        SugestaoBusca* sugestao = &sugestoes[quantidade++];
+        size_t i = 0;
+        for (; cursor.palavra[i] != '\0'; i++) {
+            sugestao->palavra[i] = minuscula(cursor.palavra[i]);
+        }
+        sugestao->palavra[i] = '\0';
+        sugestao->ocorrencias = no->quantidade;
+        if (quantidade == maximo) {
+            break;
+        }
+    }
+    return quantidade;
+}
+
+// --- Hash
+
+char* copiarTextoNaArena(Arena* arena, const char* texto) {
+    size_t tamanho = strlen(texto) + 1;
+    char* copia = (char*)alocarNaArena(arena, tamanho);
+    memcpy(copia, texto, tamanho);
+    return copia;
+}
+
+TabelaHash* criarTabelaHash(Arena* arena, size_t capacidadeInicial) {
+    TabelaHash* tabela = (TabelaHash*)alocarNaArena(arena, sizeof(TabelaHash));
+    
+    size_t capacidade = CAPACIDADE_INICIAL_HASH;
+    while (capacidade < capacidadeInicial) {
+        capacidade *= 2;
+    }
+    
+    tabela->arena = arena;
+    tabela->capacidade = capacidade;
+    tabela->quantidade = 0;
+    tabela->entradas = (HashNode*)alocarNaArena(arena, capacidade * sizeof(HashNode));
+    memset(tabela->entradas, 0, capacidade * sizeof(HashNode));
+    tabela->pistas = NULL;
+    tabela->capacidadePistas = 0;
+    tabela->suspeitos = NULL;
+    tabela->numSuspeitos = 0;
+    tabela->capacidadeSuspeitos = 0;
+    inicializarIndiceBusca(&tabela->indiceSuspeitos, arena);
+    tabela->pesosDeclarados = NULL;
+    tabela->numPesosDeclarados = 0;
+    tabela->capacidadePesosDeclarados = 0;
+    tabela->pesos = NULL;
+    tabela->passoPesos = 0;
+    tabela->sementePerfeita = 0;
+    tabela->deslocamentoPerfeito = 0;
+    tabela->indiceCulpado = -1;
+    tabela->estatisticas = NULL;
+    
+    return tabela;
+}
+
+int buscarIndiceSuspeitoPorNome(const TabelaHash* tabela, const char* suspeito) {
+    // Poucos suspeitos por caso: a varredura linear basta
+    for (int i = 0; i < tabela->numSuspeitos; i++) {
+        if (strcmp(tabela->suspeitos[i], suspeito) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int registrarSuspeito(TabelaHash* tabela, const char* suspeito) {
+    int indice = buscarIndiceSuspeitoPorNome(tabela, suspeito);
+    if (indice >= 0) {
+        return indice;
+    }
+    
+    if (tabela->numSuspeitos == tabela->capacidadeSuspeitos) {
+        int novaCapacidade = tabela->capacidadeSuspeitos > 0 ? tabela->capacidadeSuspeitos * 2 : 8;
+        const char** novos = (const char**)alocarNaArena(tabela->arena, (size_t)novaCapacidade * sizeof(char*));
+        if (tabela->numSuspeitos > 0) {
+            memcpy(novos, tabela->suspeitos, (size_t)tabela->numSuspeitos * sizeof(char*));
+        }
+        tabela->suspeitos = novos;
+        tabela->capacidadeSuspeitos = novaCapacidade;
+    }
+    
+    tabela->suspeitos[tabela->numSuspeitos] = copiarTextoNaArena(tabela->arena, suspeito);
+    indexarTexto(&tabela->indiceSuspeitos, tabela->suspeitos[tabela->numSuspeitos], (uint32_t)tabela->numSuspeitos);
+    return tabela->numSuspeitos++;
+}
+
+uint32_t calcularHash(const char* pista) {
+    // FNV-1a seguido do finalizador do MurmurHash3 para espalhar os bits baixos
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)pista; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    
+    return hash != 0 ? hash : 1; // 0 fica reservado para posicao vazia
+}
+
+void redimensionarTabelaHash(TabelaHash* tabela, size_t novaCapacidade) {
+    size_t mascara = novaCapacidade - 1;
+    
+    // O vetor antigo continua na arena ate o fim da sessao; como a
+    // capacidade dobra, o desperdicio total fica abaixo do tamanho final.
+    // As entradas sao refeitas a partir das pistas internadas
+    tabela->entradas = (HashNode*)alocarNaArena(tabela->arena, novaCapacidade * sizeof(HashNode));
+    memset(tabela->entradas, 0, novaCapacidade * sizeof(HashNode));
+    tabela->capacidade = novaCapacidade;
+    
+    for (uint32_t id = 0; id < (uint32_t)tabela->quantidade; id++) {
+        size_t indice = tabela->pistas[id].hash & mascara;
+        while (tabela->entradas[indice].hash != 0) {
+            indice = (indice + 1) & mascara;
+        }
+        tabela->entradas[indice].hash = tabela->pistas[id].hash;
+        tabela->entradas[indice].idPista = id;
+    }
+}
+
+void reservarTabelaHash(TabelaHash* tabela, size_t quantidade) {
+    // Dimensiona entradas e pistas de uma vez para o total previsto: as
+    // proximas insercoes ate esse total nao redimensionam nem copiam nada
+    size_t capacidade = tabela->capacidade;
+    while (quantidade * CARGA_MAXIMA_HASH_DEN > capacidade * CARGA_MAXIMA_HASH_NUM) {
+        capacidade *= 2;
+    }
+    if (capacidade != tabela->capacidade) {
+        redimensionarTabelaHash(tabela, capacidade);
+    }
+    if (quantidade > tabela->capacidadePistas) {
+        PistaInternada* novas = (PistaInternada*)alocarNaArena(tabela->arena, quantidade * sizeof(PistaInternada));
+        if (tabela->quantidade > 0) {
+            memcpy(novas, tabela->pistas, tabela->quantidade * sizeof(PistaInternada));
+        }
+        tabela->pistas = novas;
+        tabela->capacidadePistas = (uint32_t)quantidade;
+    }
+}
+
+uint32_t internarPista(TabelaHash* tabela, const char* pista) {
+    // A pista nao e copiada: deve viver tanto quanto a tabela
+    uint32_t hash = calcularHash(pista);
+    size_t mascara = tabela->capacidade - 1;
+    size_t indice = hash & mascara;
+    
+    while (tabela->entradas[indice].hash != 0) {
+        const HashNode* entrada = &tabela->entradas[indice];
+        if (entrada->hash == hash && strcmp(tabela->pistas[entrada->idPista].texto, pista) == 0) {
+            return entrada->idPista;
+        }
+        indice = (indice + 1) & mascara;
+    }
+    
+    if (tabela->quantidade == tabela->capacidadePistas) {
+        uint32_t novaCapacidade = tabela->capacidadePistas > 0 ? tabela->capacidadePistas * 2 : CAPACIDADE_INICIAL_HASH;
+        PistaInternada* novas = (PistaInternada*)alocarNaArena(tabela->arena, (size_t)novaCapacidade * sizeof(PistaInternada));
+        if (tabela->quantidade > 0) {
+            memcpy(novas, tabela->pistas, tabela->quantidade * sizeof(PistaInternada));
+        }
+        tabela->pistas = novas;
+        tabela->capacidadePistas = novaCapacidade;
+    }
+    
+    uint32_t id = (uint32_t)tabela->quantidade++;
+    tabela->pistas[id].texto = pista;
+    tabela->pistas[id].hash = hash;
+    tabela->pistas[id].indiceSuspeito = -1;
+    tabela->entradas[indice].hash = hash;
+    tabela->entradas[indice].idPista = id;
+    
+    if (tabela->quantidade * CARGA_MAXIMA_HASH_DEN > tabela->capacidade * CARGA_MAXIMA_HASH_NUM) {
+        redimensionarTabelaHash(tabela, tabela->capacidade * 2);
+    }
+    return id;
+}
+
+int compararPistasInternadas(const void* a, const void* b) {
+    return strcmp(((const PistaInternada*)a)->texto, ((const PistaInternada*)b)->texto);
+}
+
+void ordenarPistasInternadas(TabelaHash* tabela) {
+    // Renumera os ids na ordem alfabetica: assim a arvore do caderno
+    // compara inteiros e o percurso em ordem continua alfabetico
+    qsort(tabela->pistas, tabela->quantidade, sizeof(PistaInternada), compararPistasInternadas);
+    redimensionarTabelaHash(tabela, tabela->capacidade);
+}
+
+int compararTextos(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+uint32_t internarPistasEmLote(TabelaHash* tabela, const char** textos, uint32_t quantidade) {
+    // Ordena os textos (o vetor do chamador) e descarta os repetidos, que
+    // ficam vizinhos; a tabela e reservada uma vez para as distintas. Numa
+    // tabela vazia os ids ja saem em ordem alfabetica e cada texto vai
+    // direto para a primeira posicao livre, sem comparar strings.
+    qsort(textos, quantidade, sizeof(const char*), compararTextos);
+    uint32_t distintas = 0;
+    for (uint32_t i = 0; i < quantidade; i++) {
+        if (distintas == 0 || strcmp(textos[i], textos[distintas - 1]) != 0) {
+            textos[distintas++] = textos[i];
+        }
+    }
+    reservarTabelaHash(tabela, tabela->quantidade + distintas);
+
+    if (tabela->quantidade > 0) {
+        // Tabela ja em uso: insercao comum, depois a renumeracao alfabetica
+        for (uint32_t i = 0; i < distintas; i++) {
+            internarPista(tabela, textos[i]);
+        }
+        ordenarPistasInternadas(tabela);
+        return distintas;
+    }
+
+    size_t mascara = tabela->capacidade - 1;
+    for (uint32_t id = 0; id < distintas; id++) {
+        uint32_t hash = calcularHash(textos[id]);
+        size_t indice = hash & mascara;
+        while (tabela->entradas[indice].hash != 0) {
+            indice = (indice + 1) & mascara;
+        }
+        tabela->pistas[id].texto = textos[id];
+        tabela->pistas[id].hash = hash;
+        tabela->pistas[id].indiceSuspeito = -1;
+        tabela->entradas[indice].hash = hash;
+        tabela->entradas[indice].idPista = id;
+    }
+    tabela->quantidade = distintas;
+    return distintas;
+}
+
+void inserirNaHash(TabelaHash* tabela, const char* pista, const char* suspeito) {
+    // A tabela guarda a propria copia da pista, so se ela for nova
+    uint32_t id = buscarIdPista(tabela, pista);
+    if (id == SEM_PISTA) {
+        id = internarPista(tabela, copiarTextoNaArena(tabela->arena, pista));
+    }
+    // Ate montar a matriz, o suspeito mais recente prevalece
+    int indiceSuspeito = registrarSuspeito(tabela, suspeito);
+    tabela->pistas[id].indiceSuspeito = indiceSuspeito;
+    declararPeso(tabela, tabela->pistas[id].texto, indiceSuspeito, 1.0f);
+}
+
+void inserirNaHashReferencia(TabelaHash* tabela, const char* pista, const char* suspeito, float peso) {
+    uint32_t id = internarPista(tabela, pista);
+    int indiceSuspeito = registrarSuspeito(tabela, suspeito);
+    tabela->pistas[id].indiceSuspeito = indiceSuspeito;
+    declararPeso(tabela, pista, indiceSuspeito, peso);
+}
+
+void declararPeso(TabelaHash* tabela, const char* pista, int suspeito, float peso) {
+    // Guarda o texto e nao o id: ordenarPistasInternadas ainda vai renumerar
+    if (tabela->numPesosDeclarados == tabela->capacidadePesosDeclarados) {
+        uint32_t novaCapacidade = tabela->capacidadePesosDeclarados > 0 ? tabela->capacidadePesosDeclarados * 2 : CAPACIDADE_INICIAL_HASH;
+        PesoDeclarado* novos = (PesoDeclarado*)alocarNaArena(tabela->arena, (size_t)novaCapacidade * sizeof(PesoDeclarado));
+        if (tabela->numPesosDeclarados > 0) {
+            memcpy(novos, tabela->pesosDeclarados, (size_t)tabela->numPesosDeclarados * sizeof(PesoDeclarado));
+        }
+        tabela->pesosDeclarados = novos;
+        tabela->capacidadePesosDeclarados = novaCapacidade;
+    }
+    PesoDeclarado* declarado = &tabela->pesosDeclarados[tabela->numPesosDeclarados++];
+    declarado->pista = pista;
+    declarado->suspeito = suspeito;
+    declarado->peso = peso;
+}
+
+size_t posicaoInicialHash(const TabelaHash* tabela, uint32_t hash) {
+    if (tabela->sementePerfeita != 0) {
+        return (uint32_t)(hash * tabela->sementePerfeita) >> tabela->deslocamentoPerfeito;
+    }
+    return hash & (tabela->capacidade - 1);
+}
+
+uint32_t buscarIdPista(const TabelaHash* tabela, const char* pista) {
+    uint32_t hash = calcularHash(pista);
+    size_t mascara = tabela->capacidade - 1;
+    size_t indice = posicaoInicialHash(tabela, hash);
+    
+    // Compara o hash cacheado antes de tocar na string
+    uint32_t id = SEM_PISTA;
+    uint64_t sondagens = 1;
+    if (tabela->sementePerfeita != 0) {
+        // Sem colisoes: uma posicao e uma comparacao, presente ou nao
+        const HashNode* entrada = &tabela->entradas[indice];
+        if (entrada->hash == hash && strcmp(tabela->pistas[entrada->idPista].texto, pista) == 0) {
+            id = entrada->idPista;
+        }
+    } else {
+        while (tabela->entradas[indice].hash != 0) {
+            const HashNode* entrada = &tabela->entradas[indice];
+            if (entrada->hash == hash && strcmp(tabela->pistas[entrada->idPista].texto, pista) == 0) {
+                id = entrada->idPista;
+                break;
+            }
+            indice = (indice + 1) & mascara;
+            sondagens++;
+        }
+    }
+    
+    if (tabela->estatisticas != NULL) {
+        registrarSondagens(tabela->estatisticas, sondagens);
+    }
+    return id;
+}
+
+const char* textoPista(const TabelaHash* tabela, uint32_t idPista) {
+    return tabela->pistas[idPista].texto;
+}
+
+int indiceSuspeitoDaPista(const TabelaHash* tabela, uint32_t idPista) {
+    return idPista != SEM_PISTA ? tabela->pistas[idPista].indiceSuspeito : -1;
+}
+
+const char* encontrarSuspeito(const TabelaHash* tabela, const char* pista) {
+    int indice = indiceSuspeitoDaPista(tabela, buscarIdPista(tabela, pista));
+    return indice >= 0 ? tabela->suspeitos[indice] : "Desconhecido";
+}
+
+void revelarCulpadoReal(Terminal* terminal, const Mansao* mansao, const TabelaHash* tabela) {
+    // O culpado vem do arquivo do cenario ou da definicao do caso embutido
+    const char* culpado = NULL;
+    if (mansao->culpado != 0) {
+        culpado = textoDaMansao(mansao, mansao->culpado);
+    } else if (tabela->indiceCulpado >= 0) {
+        culpado = tabela->suspeitos[tabela->indiceCulpado];
+    }
+    if (culpado == NULL) {
+        exibir(terminal, "\nEste caso nao informa quem era o verdadeiro culpado.\n");
+        return;
+    }
+
+    char nome[64];
+    size_t i = 0;
+    for (; culpado[i] != '\0' && i < sizeof(nome) - 1; i++) {
+        nome[i] = (char)toupper((unsigned char)culpado[i]);
+    }
+    nome[i] = '\0';
+    exibir(terminal, "\n*** O VERDADEIRO CULPADO ERA: %s ***\n", nome);
+
+    if (mansao->culpado != 0) {
+        uint32_t total = 0;
+        for (uint32_t p = 0; p < mansao->numPares; p++) {
+            total += mansao->pares[p].peso > 0.0f && strcmp(textoDaMansao(mansao, mansao->pares[p].suspeito), culpado) == 0;
+        }
+        exibir(terminal, "Ele tinha %u pistas incriminadoras:\n", total);
+        for (uint32_t p = 0; p < mansao->numPares; p++) {
+            float peso = mansao->pares[p].peso;
+            if (peso > 0.0f && strcmp(textoDaMansao(mansao, mansao->pares[p].suspeito), culpado) == 0) {
+                exibir(terminal, "- %s", textoDaMansao(mansao, mansao->pares[p].pista));
+                exibir(terminal, peso != 1.0f ? " (peso %g)\n" : "\n", (double)peso);
+            }
+        }
+        return;
+    }
+
+    // Caso embutido: as pistas saem da matriz, em ordem alfabetica
+    uint32_t total = 0;
+    for (uint32_t id = 0; id < (uint32_t)tabela->quantidade; id++) {
+        total += linhaDePesos(tabela, id)[tabela->indiceCulpado] > 0.0f;
+    }
+    exibir(terminal, "Ele tinha %u pistas incriminadoras:\n", total);
+    for (uint32_t id = 0; id < (uint32_t)tabela->quantidade; id++) {
+        float peso = linhaDePesos(tabela, id)[tabela->indiceCulpado];
+        if (peso > 0.0f) {
+            exibir(terminal, "- %s", textoPista(tabela, id));
+            exibir(terminal, peso != 1.0f ? " (peso %g)\n" : "\n", (double)peso);
+        }
+    }
+}
+
+// --- Caso embutido (tabelas geradas)
+//
+// O caso padrao nao muda entre execucoes: em vez de inserir as pistas a
+// cada partida, --gerar-caso-embutido le a definicao em gerarCasoEmbutido
+// e escreve as tabelas estaticas do trecho abaixo, ja com ids em ordem
+// alfabetica, matriz de pesos, um hash perfeito multiplicativo e o id da
+// pista de cada sala. Depois de mudar a definicao, rode o gerador e troque
+// o trecho inteiro.
+
+// >>> TRECHO GERADO
+
+#define NUM_PISTAS_EMBUTIDAS 22
+#define NUM_SUSPEITOS_EMBUTIDOS 5
+#define PASSO_PESOS_EMBUTIDOS 8
+#define CAPACIDADE_HASH_EMBUTIDO 32
+#define SEMENTE_HASH_EMBUTIDO 0xbc5276c1u
+#define DESLOCAMENTO_HASH_EMBUTIDO 27
+#define CULPADO_EMBUTIDO 0
+#define NUM_SALAS_EMBUTIDAS 12
+
+static const char* const suspeitosEmbutidos[NUM_SUSPEITOS_EMBUTIDOS] = {"Joao", "Maria", "Carlos", "Ana", "Pedro"};
+
+static const PistaInternada pistasEmbutidas[NUM_PISTAS_EMBUTIDAS] = {
+    {"Cadeira desencaixada da mesa", 0xb0e6ac53u, 1},
+    {"Cartao de acesso roubado", 0x6d5060cfu, 0},
+    {"Celular com ligacoes suspeitas", 0x0c3c9649u, 1},
+    {"Chave mestra duplicada", 0x84e0b45eu, 3},
+    {"Cinzas de cigarro raro", 0xc8166d0du, 4},
+    {"Cofre aberto e vazio", 0x5a3c9dbdu, 2},
+    {"Computador com emails suspeitos", 0x486316d9u, 2},
+    {"Copo de vinho pela metade", 0xbadecbe0u, 1},
+    {"Dinheiro em especie escondido", 0xfd633a94u, 0},
+    {"Documentos falsificados", 0x061a87e8u, 2},
+    {"Faca desaparecida do bloco", 0x43d63a3au, 2},
+    {"Fotos comprometedoras", 0x361cc28bu, 3},
+    {"Gravacao de seguranca apagada", 0x0a85ce8fu, 4},
+    {"Horario alterado no sistema", 0xd091ce91u, 4},
+    {"Livro sobre venenos aberto", 0x3990be15u, 3},
+    {"Luvas de latex encontradas", 0x755a224au, 1},
+    {"Mala com documentos secretos", 0x853d60ceu, 4},
+    {"Manchas escuras no chao", 0x2f1b2466u, 3},
+    {"Pegadas de barro frescas", 0xb681d5f6u, 0},
+    {"Porta principal arrombada", 0x7e03cf13u, 0},
+    {"Relogio parado as 23:45", 0x35dfa2fdu, 0},
+    {"Toalha com manchas vermelhas", 0xe95e9300u, 1},
+};
+
+static const HashNode entradasEmbutidas[CAPACIDADE_HASH_EMBUTIDO] = {
+    [0] = {0x853d60ceu, 16},
+    [1] = {0x7e03cf13u, 19},
+    [3] = {0xd091ce91u, 13},
+    [4] = {0x43d63a3au, 10},
+    [7] = {0xfd633a94u, 8},
+    [9] = {0x5a3c9dbdu, 5},
+    [11] = {0x755a224au, 15},
+    [12] = {0xbadecbe0u, 7},
+    [13] = {0x3990be15u, 14},
+    [14] = {0x361cc28bu, 11},
+    [15] = {0x6d5060cfu, 1},
+    [17] = {0x84e0b45eu, 3},
+    [18] = {0x2f1b2466u, 17},
+    [19] = {0xe95e9300u, 21},
+    [20] = {0xb681d5f6u, 18},
+    [21] = {0xc8166d0du, 4},
+    [22] = {0x35dfa2fdu, 20},
+    [23] = {0x061a87e8u, 9},
+    [25] = {0x0a85ce8fu, 12},
+    [26] = {0xb0e6ac53u, 0},
+    [28] = {0x0c3c9649u, 2},
+    [29] = {0x486316d9u, 6},
+};
+
+static _Alignas(LARGURA_VETOR_PESOS * sizeof(float)) const float
+    pesosEmbutidos[NUM_PISTAS_EMBUTIDAS * PASSO_PESOS_EMBUTIDOS] = {
+    0, 1, 0, 0, 0, 0, 0, 0, // Cadeira desencaixada da mesa
+    1, 0, 0, 0, 0, 0, 0, 0, // Cartao de acesso roubado
+    0, 1, 0, 0, 0, 0, 0, 0, // Celular com ligacoes suspeitas
+    0, 0, 0, 1, 0, 0, 0, 0, // Chave mestra duplicada
+    0, 0, 0, 0, 1, 0, 0, 0, // Cinzas de cigarro raro
+    0, 0, 1, 0, 0, 0, 0, 0, // Cofre aberto e vazio
+    0, 0, 1, 0, 0, 0, 0, 0, // Computador com emails suspeitos
+    0, 1, 0, 0, 0, 0, 0, 0, // Copo de vinho pela metade
+    1, 0, 0, 0, 0, 0, 0, 0, // Dinheiro em especie escondido
+    0, 0, 1, 0, 0, 0, 0, 0, // Documentos falsificados
+    0, 0, 1, 0, 0, 0, 0, 0, // Faca desaparecida do bloco
+    0, 0, 0, 1, 0, 0, 0, 0, // Fotos comprometedoras
+    0, 0, 0, 0, 1, 0, 0, 0, // Gravacao de seguranca apagada
+    0, 0, 0, 0, 1, 0, 0, 0, // Horario alterado no sistema
+    0, 0, 0, 1, 0, 0, 0, 0, // Livro sobre venenos aberto
+    0, 1, 0, 0, 0, 0, 0, 0, // Luvas de latex encontradas
+    0, 0, 0, 0, 1, 0, 0, 0, // Mala com documentos secretos
+    0, 0, 0, 1, 0, 0, 0, 0, // Manchas escuras no chao
+    1, 0, 0, 0, 0, 0, 0, 0, // Pegadas de barro frescas
+    1, 0, 0, 0, 0, 0, 0, 0, // Porta principal arrombada
+    1, 0, 0, 0, 0, 0, 0, 0, // Relogio parado as 23:45
+    0, 1, 0, 0, 0, 0, 0, 0, // Toalha com manchas vermelhas
+};
+
+static const char* const salasEmbutidas[NUM_SALAS_EMBUTIDAS] = {
+    "Hall de Entrada",
+    "Sala de Estar",
+    "Cozinha",
+    "Biblioteca",
+    "Quarto de Hospedes",
+    "Jardim",
+    "Sala de Jantar",
+    "Escritorio Secreto",
+    "Porao",
+    "Terraco",
+    "Quarto Principal",
+    "Banheiro",
+};
+
+static const uint32_t pistasDasSalasEmbutidas[NUM_SALAS_EMBUTIDAS] = {
+    19, // Porta principal arrombada
+    7, // Copo de vinho pela metade
+    10, // Faca desaparecida do bloco
+    14, // Livro sobre venenos aberto
+    16, // Mala com documentos secretos
+    18, // Pegadas de barro frescas
+    0, // Cadeira desencaixada da mesa
+    5, // Cofre aberto e vazio
+    17, // Manchas escuras no chao
+    4, // Cinzas de cigarro raro
+    20, // Relogio parado as 23:45
+    21, // Toalha com manchas vermelhas
+};
+
+// <<< TRECHO GERADO
+
+TabelaHash* abrirTabelaEmbutida(Arena* arena) {
+    // Nada e inserido nem copiado: os campos apontam para as tabelas
+    // estaticas. Os casts so tiram o const do tipo; com sementePerfeita
+    // definida, nenhum caminho de carga escreve na tabela
+    TabelaHash* tabela = (TabelaHash*)alocarNaArena(arena, sizeof(TabelaHash));
+    memset(tabela, 0, sizeof(TabelaHash));
+    tabela->arena = arena;
+    tabela->entradas = (HashNode*)entradasEmbutidas;
+    tabela->capacidade = CAPACIDADE_HASH_EMBUTIDO;
+    tabela->quantidade = NUM_PISTAS_EMBUTIDAS;
+    tabela->pistas = (PistaInternada*)pistasEmbutidas;
+    tabela->capacidadePistas = NUM_PISTAS_EMBUTIDAS;
+    tabela->suspeitos = (const char**)suspeitosEmbutidos;
+    tabela->numSuspeitos = NUM_SUSPEITOS_EMBUTIDOS;
+    tabela->capacidadeSuspeitos = NUM_SUSPEITOS_EMBUTIDOS;
+    tabela->pesos = (float*)pesosEmbutidos;
+    tabela->passoPesos = PASSO_PESOS_EMBUTIDOS;
+    tabela->sementePerfeita = SEMENTE_HASH_EMBUTIDO;
+    tabela->deslocamentoPerfeito = DESLOCAMENTO_HASH_EMBUTIDO;
+    tabela->indiceCulpado = CULPADO_EMBUTIDO;
+
+    // O indice de nomes para completar a acusacao e o unico trabalho de carga
+    inicializarIndiceBusca(&tabela->indiceSuspeitos, arena);
+    for (int i = 0; i < NUM_SUSPEITOS_EMBUTIDOS; i++) {
+        indexarTexto(&tabela->indiceSuspeitos, suspeitosEmbutidos[i], (uint32_t)i);
+    }
+    return tabela;
+}
+
+void montarMapaMansao(Arena* arena, Mansao* mansao) {
+    // Salas e pistas vem do trecho gerado; aqui so os caminhos entre elas
+    struct {
+        int origem;
+        char tecla;
+        int destino;
+    } ligacoes_dados[] = {
+        {0, 'e', 1}, {0, 'd', 2},
+        {1, 'e', 3}, {1, 'd', 4},
+        {2, 'e', 5}, {2, 'd', 6},
+        {3, 'e', 7}, {3, 'd', 8},
+        {4, 'e', 9}, {4, 'd', 10},
+        {5, 'd', 11}
+    };
+
+    const int NUM_LIGACOES = sizeof(ligacoes_dados) / sizeof(ligacoes_dados[0]);
+    size_t capacidadeTextos = 0;
+    for (int i = 0; i < NUM_SALAS_EMBUTIDAS; i++) {
+        uint32_t id = pistasDasSalasEmbutidas[i];
+        capacidadeTextos += strlen(salasEmbutidas[i]) + (id != SEM_PISTA ? strlen(pistasEmbutidas[id].texto) : 0) + 2;
+    }
+
+    ConstrutorMansao construtor;
+    iniciarConstrucaoMansao(&construtor, arena, NUM_SALAS_EMBUTIDAS, (uint32_t)NUM_LIGACOES, 0, capacidadeTextos);
+    for (int i = 0; i < NUM_SALAS_EMBUTIDAS; i++) {
+        uint32_t id = pistasDasSalasEmbutidas[i];
+        criarSala(&construtor, salasEmbutidas[i], id != SEM_PISTA ? pistasEmbutidas[id].texto : "");
+    }
+    for (int i = 0; i < NUM_LIGACOES; i++) {
+        ligarSalas(&construtor, (uint32_t)ligacoes_dados[i].origem, ligacoes_dados[i].tecla, (uint32_t)ligacoes_dados[i].destino, 1);
+    }
+
+    if (!concluirMansao(&construtor, mansao)) {
+        exit(1);
+    }
+    // Ids resolvidos pelo gerador: a carga nao consulta o hash
+    mansao->pistasInternadas = pistasDasSalasEmbutidas;
+}
+
+void escreverLiteralC(FILE* saida, const char* texto) {
+    fputc('"', saida);
+    for (const char* c = texto; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', saida);
+        }
+        fputc(*c, saida);
+    }
+    fputc('"', saida);
+}
+
+int gerarCasoEmbutido(FILE* saida) {
+    // Definicao do caso: suspeitos na ordem em que aparecem, cada pista
+    // com peso 1 para o seu suspeito
+    static const struct {
+        const char* pista;
+        const char* suspeito;
+    } definicao[] = {
+        // Joao
+        {"Porta principal arrombada", "Joao"},
+        {"Pegadas de barro frescas", "Joao"},
+        {"Relogio parado as 23:45", "Joao"},
+        {"Cartao de acesso roubado", "Joao"},
+        {"Dinheiro em especie escondido", "Joao"},
+
+        // Maria
+        {"Copo de vinho pela metade", "Maria"},
+        {"Cadeira desencaixada da mesa", "Maria"},
+        {"Toalha com manchas vermelhas", "Maria"},
+        {"Luvas de latex encontradas", "Maria"},
+        {"Celular com ligacoes suspeitas", "Maria"},
+
+        // Carlos
+        {"Faca desaparecida do bloco", "Carlos"},
+        {"Cofre aberto e vazio", "Carlos"},
+        {"Computador com emails suspeitos", "Carlos"},
+        {"Documentos falsificados", "Carlos"},
+
+        // Ana
+        {"Livro sobre venenos aberto", "Ana"},
+        {"Manchas escuras no chao", "Ana"},
+        {"Fotos comprometedoras", "Ana"},
+        {"Chave mestra duplicada", "Ana"},
+
+        // Pedro
+        {"Mala com documentos secretos", "Pedro"},
+        {"Cinzas de cigarro raro", "Pedro"},
+        {"Gravacao de seguranca apagada", "Pedro"},
+        {"Horario alterado no sistema", "Pedro"}
+    };
+    // Salas do mapa, na ordem dos indices de montarMapaMansao; "" e sala sem pista
+    static const struct {
+        const char* nome;
+        const char* pista;
+    } salas[] = {
+        {"Hall de Entrada", "Porta principal arrombada"},
+        {"Sala de Estar", "Copo de vinho pela metade"},
+        {"Cozinha", "Faca desaparecida do bloco"},
+        {"Biblioteca", "Livro sobre venenos aberto"},
+        {"Quarto de Hospedes", "Mala com documentos secretos"},
+        {"Jardim", "Pegadas de barro frescas"},
+        {"Sala de Jantar", "Cadeira desencaixada da mesa"},
+        {"Escritorio Secreto", "Cofre aberto e vazio"},
+        {"Porao", "Manchas escuras no chao"},
+        {"Terraco", "Cinzas de cigarro raro"},
+        {"Quarto Principal", "Relogio parado as 23:45"},
+        {"Banheiro", "Toalha com manchas vermelhas"}
+    };
+    const char* const CULPADO = "Joao";
+    enum { NUM_PISTAS = sizeof(definicao) / sizeof(definicao[0]) };
+    enum { NUM_SALAS = sizeof(salas) / sizeof(salas[0]) };
+
+    PistaInternada pistas[NUM_PISTAS];
+    const char* suspeitos[NUM_PISTAS];
+    int numSuspeitos = 0;
+    for (int i = 0; i < NUM_PISTAS; i++) {
+        int suspeito = 0;
+        while (suspeito < numSuspeitos && strcmp(suspeitos[suspeito], definicao[i].suspeito) != 0) {
+            suspeito++;
+        }
+        if (suspeito == numSuspeitos) {
+            suspeitos[numSuspeitos++] = definicao[i].suspeito;
+        }
+        pistas[i].texto = definicao[i].pista;
+        pistas[i].hash = calcularHash(definicao[i].pista);
+        pistas[i].indiceSuspeito = suspeito;
+    }
+
+    // Mesma renumeracao de ordenarPistasInternadas
+    qsort(pistas, NUM_PISTAS, sizeof(PistaInternada), compararPistasInternadas);
+    for (int i = 1; i < NUM_PISTAS; i++) {
+        if (strcmp(pistas[i - 1].texto, pistas[i].texto) == 0) {
+            printf("Erro: Pista repetida no caso embutido: %s\n", pistas[i].texto);
+            return 0;
+        }
+    }
+    int culpado = 0;
+    while (culpado < numSuspeitos && strcmp(suspeitos[culpado], CULPADO) != 0) {
+        culpado++;
+    }
+    if (culpado == numSuspeitos) {
+        printf("Erro: O culpado %s nao tem pistas no caso embutido.\n", CULPADO);
+        return 0;
+    }
+
+    // Pista de cada sala resolvida aqui: uma sala com texto fora da
+    // definicao para o gerador, nao a partida
+    uint32_t pistasDasSalas[NUM_SALAS];
+    for (int i = 0; i < NUM_SALAS; i++) {
+        pistasDasSalas[i] = SEM_PISTA;
+        for (int k = 0; k < NUM_PISTAS && salas[i].pista[0] != '\0'; k++) {
+            if (strcmp(pistas[k].texto, salas[i].pista) == 0) {
+                pistasDasSalas[i] = (uint32_t)k;
+            }
+        }
+        if (salas[i].pista[0] != '\0' && pistasDasSalas[i] == SEM_PISTA) {
+            printf("Erro: Pista da sala %s fora do caso embutido: %s\n", salas[i].nome, salas[i].pista);
+            return 0;
+        }
+    }
+
+    // Menor tabela potencia de dois para a qual alguma semente impar
+    // espalha todas as pistas sem colisao; marcas[p] == tentativa indica
+    // posicao ja ocupada nesta tentativa
+    static uint32_t marcas[1u << BITS_MAXIMOS_HASH_EMBUTIDO];
+    uint32_t semente = 0;
+    uint32_t bits = 0;
+    // Ao menos uma posicao fica vazia: medirAglomeradosHash parte dela
+    while ((1u << bits) <= (uint32_t)NUM_PISTAS) {
+        bits++;
+    }
+    for (; bits <= BITS_MAXIMOS_HASH_EMBUTIDO && semente == 0; bits++) {
+        memset(marcas, 0, sizeof(marcas));
+        uint32_t estado = 2463534242u;
+        for (uint32_t tentativa = 1; tentativa <= TENTATIVAS_HASH_EMBUTIDO && semente == 0; tentativa++) {
+            uint32_t candidata = proximoAleatorio(&estado) | 1u;
+            int colidiu = 0;
+            for (int i = 0; i < NUM_PISTAS && !colidiu; i++) {
+                uint32_t posicao = (uint32_t)(pistas[i].hash * candidata) >> (32 - bits);
+                colidiu = marcas[posicao] == tentativa;
+                marcas[posicao] = tentativa;
+            }
+            if (!colidiu) {
+                semente = candidata;
+            }
+        }
+    }
+    if (semente == 0) {
+        printf("Erro: Nenhum hash perfeito encontrado para o caso embutido.\n");
+        return 0;
+    }
+    bits--; // o laco avancou depois de achar a semente
+
+    uint32_t passo = ((uint32_t)numSuspeitos + LARGURA_VETOR_PESOS - 1) / LARGURA_VETOR_PESOS * LARGURA_VETOR_PESOS;
+    fprintf(saida, "// >>> TRECHO GERADO\n\n");
+    fprintf(saida, "#define NUM_PISTAS_EMBUTIDAS %d\n", NUM_PISTAS);
+    fprintf(saida, "#define NUM_SUSPEITOS_EMBUTIDOS %d\n", numSuspeitos);
+    fprintf(saida, "#define PASSO_PESOS_EMBUTIDOS %u\n", passo);
+    fprintf(saida, "#define CAPACIDADE_HASH_EMBUTIDO %u\n", 1u << bits);
+    fprintf(saida, "#define SEMENTE_HASH_EMBUTIDO 0x%08xu\n", semente);
+    fprintf(saida, "#define DESLOCAMENTO_HASH_EMBUTIDO %u\n", 32 - bits);
+    fprintf(saida, "#define CULPADO_EMBUTIDO %d\n", culpado);
+    fprintf(saida, "#define NUM_SALAS_EMBUTIDAS %d\n\n", NUM_SALAS);
+
+    fprintf(saida, "static const char* const suspeitosEmbutidos[NUM_SUSPEITOS_EMBUTIDOS] = {");
+    for (int i = 0; i < numSuspeitos; i++) {
+        fputs(i > 0 ? ", " : "", saida);
+        escreverLiteralC(saida, suspeitos[i]);
+    }
+    fprintf(saida, "};\n\n");
+
+    fprintf(saida, "static const PistaInternada pistasEmbutidas[NUM_PISTAS_EMBUTIDAS] = {\n");
+    for (int i = 0; i < NUM_PISTAS; i++) {
+        fprintf(saida, "    {");
+        escreverLiteralC(saida, pistas[i].texto);
+        fprintf(saida, ", 0x%08xu, %d},\n", pistas[i].hash, pistas[i].indiceSuspeito);
+    }
+    fprintf(saida, "};\n\n");
+
+    fprintf(saida, "static const HashNode entradasEmbutidas[CAPACIDADE_HASH_EMBUTIDO] = {\n");
+    for (uint32_t posicao = 0; posicao < (1u << bits); posicao++) {
+        for (int i = 0; i < NUM_PISTAS; i++) {
+            if ((uint32_t)(pistas[i].hash * semente) >> (32 - bits) == posicao) {
+                fprintf(saida, "    [%u] = {0x%08xu, %d},\n", posicao, pistas[i].hash, i);
+            }
+        }
+    }
+    fprintf(saida, "};\n\n");
+
+    fprintf(saida, "static _Alignas(LARGURA_VETOR_PESOS * sizeof(float)) const float\n");
+    fprintf(saida, "    pesosEmbutidos[NUM_PISTAS_EMBUTIDAS * PASSO_PESOS_EMBUTIDOS] = {\n");
+    for (int i = 0; i < NUM_PISTAS; i++) {
+        fprintf(saida, "   ");
+        for (uint32_t s = 0; s < passo; s++) {
+            fprintf(saida, " %d,", (int)s == pistas[i].indiceSuspeito);
+        }
+        fprintf(saida, " // %s\n", pistas[i].texto);
+    }
+    fprintf(saida, "};\n\n");
+
+    fprintf(saida, "static const char* const salasEmbutidas[NUM_SALAS_EMBUTIDAS] = {\n");
+    for (int i = 0; i < NUM_SALAS; i++) {
+        fprintf(saida, "    ");
+        escreverLiteralC(saida, salas[i].nome);
+        fprintf(saida, ",\n");
+    }
+    fprintf(saida, "};\n\n");
+
+    fprintf(saida, "static const uint32_t pistasDasSalasEmbutidas[NUM_SALAS_EMBUTIDAS] = {\n");
+    for (int i = 0; i < NUM_SALAS; i++) {
+        if (pistasDasSalas[i] == SEM_PISTA) {
+            fprintf(saida, "    SEM_PISTA,\n");
+        } else {
+            fprintf(saida, "    %u, // %s\n", pistasDasSalas[i], pistas[pistasDasSalas[i]].texto);
+        }
+    }
+    fprintf(saida, "};\n\n");
+    fprintf(saida, "// <<< TRECHO GERADO\n");
+    return !ferror(saida);
+}
+
+// --- Evidencias (matriz pista x suspeito)
+//
+// Cada pista tem uma linha de pesos, um por suspeito, em blocos de
+// LARGURA_VETOR_PESOS floats alinhados. Pontuar o caderno e somar as
+// linhas das pistas coletadas: cada soma cobre todos os suspeitos de
+// uma vez, e o compilador vetoriza o laco de largura fixa.
+
+void montarMatrizEvidencias(TabelaHash* tabela) {
+    uint32_t passo = ((uint32_t)tabela->numSuspeitos + LARGURA_VETOR_PESOS - 1) / LARGURA_VETOR_PESOS * LARGURA_VETOR_PESOS;
+    size_t tamanho = tabela->quantidade * passo * sizeof(float);
+    tabela->pesos = (float*)alocarAlinhadoNaArena(tabela->arena, tamanho, LARGURA_VETOR_PESOS * sizeof(float));
+    tabela->passoPesos = passo;
+    memset(tabela->pesos, 0, tamanho);
+
+    // Pista repetida para o mesmo suspeito: o peso mais recente prevalece
+    for (uint32_t i = 0; i < tabela->numPesosDeclarados; i++) {
+        const PesoDeclarado* declarado = &tabela->pesosDeclarados[i];
+        uint32_t id = buscarIdPista(tabela, declarado->pista);
+        tabela->pesos[(size_t)id * passo + (size_t)declarado->suspeito] = declarado->peso;
+    }
+
+    // Suspeito principal, mostrado na coleta e usado pelo planejador de
+    // rotas: o de maior peso, com empate resolvido pelo mais recente
+    for (size_t id = 0; id < tabela->quantidade; id++) {
+        tabela->pistas[id].indiceSuspeito = -1;
+    }
+    for (uint32_t i = 0; i < tabela->numPesosDeclarados; i++) {
+        const PesoDeclarado* declarado = &tabela->pesosDeclarados[i];
+        uint32_t id = buscarIdPista(tabela, declarado->pista);
+        const float* linha = &tabela->pesos[(size_t)id * passo];
+        int atual = tabela->pistas[id].indiceSuspeito;
+        if (linha[declarado->suspeito] > 0.0f && (atual < 0 || linha[declarado->suspeito] >= linha[atual])) {
+            tabela->pistas[id].indiceSuspeito = declarado->suspeito;
+        }
+    }
+}
+
+const float* linhaDePesos(const TabelaHash* tabela, uint32_t idPista) {
+    if (tabela->pesos == NULL || idPista == SEM_PISTA) {
+        return NULL;
+    }
+    return &tabela->pesos[(size_t)idPista * tabela->passoPesos];
+}
+
+float* criarVetorPontuacao(Arena* arena, const TabelaHash* tabela) {
+    size_t tamanho = (size_t)tabela->passoPesos * sizeof(float);
+    float* pontuacao = (float*)alocarAlinhadoNaArena(arena, tamanho, LARGURA_VETOR_PESOS * sizeof(float));
+    memset(pontuacao, 0, tamanho);
+    return pontuacao;
+}
+
+void somarLinhaPesos(float* restrict destino, const float* restrict linha, uint32_t passo) {
+    // Blocos de largura fixa em memoria alinhada: o laco interno vira uma
+    // soma vetorial sem intrinsics especificos de plataforma
+    for (size_t bloco = 0; bloco < passo; bloco += LARGURA_VETOR_PESOS) {
+        float* restrict d = destino + bloco;
+        const float* restrict l = linha + bloco;
+        for (int k = 0; k < LARGURA_VETOR_PESOS; k++) {
+            d[k] += l[k];
+        }
+    }
+}
+
+void pontuarCaderno(const Caderno* caderno, float* pontuacao) {
+    // Uma passada sobre o caderno, em ordem de id: a soma nao depende da
+    // ordem de coleta, entao uma sessao retomada chega ao mesmo veredito
+    uint32_t passo = caderno->tabela->passoPesos;
+    memset(pontuacao, 0, (size_t)passo * sizeof(float));
+    IteradorPistas iterador;
+    iniciarIteradorPistas(&iterador, caderno->raiz);
+    for (const PistaNode* no = proximaPista(&iterador); no != NULL; no = proximaPista(&iterador)) {
+        const float* linha = linhaDePesos(caderno->tabela, no->idPista);
+        if (linha != NULL) {
+            somarLinhaPesos(pontuacao, linha, passo);
+        }
+    }
+}
+
+int compararPosicaoSuspeito(const void* a, const void* b) {
+    // Maior pontuacao primeiro; empate fica na ordem de cadastro
+    const PosicaoSuspeito* x = (const PosicaoSuspeito*)a;
+    const PosicaoSuspeito* y = (const PosicaoSuspeito*)b;
+    if (x->pontuacao != y->pontuacao) {
+        return x->pontuacao > y->pontuacao ? -1 : 1;
+    }
+    return (x->indice > y->indice) - (x->indice < y->indice);
+}
+
+void classificarSuspeitos(const float* pontuacao, int numSuspeitos, PosicaoSuspeito* classificacao) {
+    for (int i = 0; i < numSuspeitos; i++) {
+        classificacao[i].pontuacao = pontuacao[i];
+        classificacao[i].indice = i;
+    }
+    qsort(classificacao, (size_t)numSuspeitos, sizeof(PosicaoSuspeito), compararPosicaoSuspeito);
+}
+
+// --- Interface
+
+void iniciarTerminal(Terminal* terminal, const char* roteiro, size_t tamanhoRoteiro, int interativo, FILE* saida, FILE* transcricao) {
+    memset(terminal, 0, sizeof(Terminal));
+    terminal->roteiro = roteiro;
+    terminal->tamanhoRoteiro = tamanhoRoteiro;
+    terminal->interativo = interativo;
+    terminal->saida = saida;
+    terminal->transcricao = transcricao;
+
+#ifdef _WIN32
+    // Consoles do Windows so interpretam ANSI com o modo VT ligado
+    if (interativo) {
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD modo;
+        if (GetConsoleMode(console, &modo)) {
+            SetConsoleMode(console, modo | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        }
+    }
+#endif
+}
+
+void liberarTerminal(Terminal* terminal) {
+    free(terminal->quadro.dados);
+    free(terminal->tela.dados);
+    free(terminal->envio.dados);
+    terminal->quadro.dados = terminal->tela.dados = terminal->envio.dados = NULL;
+}
+
+void reservarBuffer(BufferTexto* buffer, size_t adicional) {
+    if (buffer->tamanho + adicional + 1 <= buffer->capacidade) {
+        return;
+    }
+    size_t capacidade = buffer->capacidade > 0 ? buffer->capacidade : 1024;
+    while (capacidade < buffer->tamanho + adicional + 1) {
+        capacidade *= 2;
+    }
+    char* dados = (char*)realloc(buffer->dados, capacidade);
+    if (dados == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para o terminal.\n");
+        exit(1);
+    }
+    buffer->dados = dados;
+    buffer->capacidade = capacidade;
+}
+
+void anexarTexto(BufferTexto* buffer, const char* texto, size_t tamanho) {
+    reservarBuffer(buffer, tamanho);
+    memcpy(buffer->dados + buffer->tamanho, texto, tamanho);
+    buffer->tamanho += tamanho;
+    buffer->dados[buffer->tamanho] = '\0';
+}
+
+int linhasDoTerminal() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        return info.srWindow.Bottom - info.srWindow.Top + 1;
+    }
+#else
+    struct winsize janela;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &janela) == 0 && janela.ws_row > 0) {
+        return janela.ws_row;
+    }
+#endif
+    return 24;
+}
+
+void escreverNoTerminal(Terminal* terminal, const char* dados, size_t tamanho) {
+    fflush(terminal->saida); // nada do stdio pode ficar para tras do quadro
+#ifdef _WIN32
+    fwrite(dados, 1, tamanho, terminal->saida);
+    fflush(terminal->saida);
+#else
+    int descritor = fileno(terminal->saida);
+    while (tamanho > 0) {
+        ssize_t escritos = write(descritor, dados, tamanho);
+        if (escritos < 0 && errno == EINTR) {
+            continue;
+        }
+        if (escritos <= 0) {
+            return;
+        }
+        dados += escritos;
+        tamanho -= (size_t)escritos;
+    }
+#endif
+}
+
+void apresentarQuadro(Terminal* terminal) {
+    if (!terminal->interativo || terminal->saida == NULL) {
+        return;
+    }
+    BufferTexto* quadro = &terminal->quadro;
+    BufferTexto* tela = &terminal->tela;
+    BufferTexto* envio = &terminal->envio;
+    envio->tamanho = 0;
+
+    if (!terminal->quadroNovo) {
+        // Continuacao do quadro na tela: o texto so e acrescentado
+        if (quadro->tamanho > 0) {
+            anexarTexto(envio, quadro->dados, quadro->tamanho);
+        }
+    } else {
+        size_t linhasNaTela = 1;
+        for (size_t i = 0; i < tela->tamanho; i++) {
+            linhasNaTela += tela->dados[i] == '\n';
+        }
+
+        anexarTexto(envio, ANSI_CURSOR_INICIO, strlen(ANSI_CURSOR_INICIO));
+        if (linhasNaTela >= (size_t)linhasDoTerminal()) {
+            // A tela rolou: as linhas antigas nao estao mais onde estavam
+            anexarTexto(envio, ANSI_LIMPAR_TELA, strlen(ANSI_LIMPAR_TELA));
+            if (quadro->tamanho > 0) {
+                anexarTexto(envio, quadro->dados, quadro->tamanho);
+            }
+        } else {
+            // Linha a linha contra a tela anterior: as iguais so avancam o cursor.
+            // A ultima linha sem quebra (um prompt) e sempre escrita, para o
+            // cursor terminar depois dela
+            const char* novo = quadro->dados;
+            const char* fimNovo = novo + quadro->tamanho;
+            const char* antigo = tela->dados;
+            const char* fimAntigo = antigo + tela->tamanho;
+            while (novo < fimNovo) {
+                const char* quebra = memchr(novo, '\n', (size_t)(fimNovo - novo));
+                size_t comprimento = quebra != NULL ? (size_t)(quebra - novo) : (size_t)(fimNovo - novo);
+                const char* quebraAntiga = antigo < fimAntigo ? memchr(antigo, '\n', (size_t)(fimAntigo - antigo)) : NULL;
+                size_t comprimentoAntigo = quebraAntiga != NULL ? (size_t)(quebraAntiga - antigo) : (size_t)(fimAntigo - antigo);
+
+                int igual = quebra != NULL && quebraAntiga != NULL && comprimento == comprimentoAntigo &&
+                            memcmp(novo, antigo, comprimento) == 0;
+                if (!igual) {
+                    anexarTexto(envio, ANSI_LIMPAR_LINHA, strlen(ANSI_LIMPAR_LINHA));
+                    anexarTexto(envio, novo, comprimento);
+                }
+                if (quebra != NULL) {
+                    anexarTexto(envio, "\n", 1);
+                }
+
+                novo += comprimento + (quebra != NULL);
+                antigo += comprimentoAntigo + (quebraAntiga != NULL);
+            }
+        }
+        anexarTexto(envio, ANSI_LIMPAR_ABAIXO, strlen(ANSI_LIMPAR_ABAIXO));
+        tela->tamanho = 0;
+        terminal->quadroNovo = 0;
+    }
+
+    if (quadro->tamanho > 0) {
+        anexarTexto(tela, quadro->dados, quadro->tamanho);
+    }
+    quadro->tamanho = 0;
+    if (envio->tamanho > 0) {
+        escreverNoTerminal(terminal, envio->dados, envio->tamanho);
+    }
+}
+
+void exibir(Terminal* terminal, const char* formato, ...) {
+    if (terminal->saida == NULL) {
+        return; // modo headless sem texto: nada e formatado
+    }
+    va_list argumentos;
+    va_start(argumentos, formato);
+    if (terminal->interativo) {
+        // Vai para o quadro; o envio acontece antes da proxima leitura
+        va_list copia;
+        va_copy(copia, argumentos);
+        int tamanho = vsnprintf(NULL, 0, formato, copia);
+        va_end(copia);
+        if (tamanho > 0) {
+            reservarBuffer(&terminal->quadro, (size_t)tamanho);
+            vsnprintf(terminal->quadro.dados + terminal->quadro.tamanho, (size_t)tamanho + 1, formato, argumentos);
+            terminal->quadro.tamanho += (size_t)tamanho;
+        }
+    } else {
+        vfprintf(terminal->saida, formato, argumentos);
+    }
+    va_end(argumentos);
+}
+
+int lerLinha(Terminal* terminal, char* destino, size_t tamanho) {
+    char linha[256];
+
+    for (;;) {
+        if (terminal->roteiro != NULL) {
+            if (terminal->posicao >= terminal->tamanhoRoteiro) {
+                return 0;
+            }
+            const char* inicio = terminal->roteiro + terminal->posicao;
+            const char* fim = memchr(inicio, '\n', terminal->tamanhoRoteiro - terminal->posicao);
+            size_t comprimento = fim != NULL ? (size_t)(fim - inicio) : terminal->tamanhoRoteiro - terminal->posicao;
+            terminal->posicao += comprimento + (fim != NULL ? 1 : 0);
+            if (comprimento >= sizeof(linha)) {
+                comprimento = sizeof(linha) - 1;
+            }
+            memcpy(linha, inicio, comprimento);
+            linha[comprimento] = '\0';
+        } else {
+            apresentarQuadro(terminal);
+            // A espera pelo jogador fica fora da latencia das acoes
+            uint64_t inicioEspera = agoraNanos();
+            char* lida = fgets(linha, sizeof(linha), stdin);
+            terminal->nanosEmEspera += agoraNanos() - inicioEspera;
+            if (lida == NULL) {
+                return 0;
+            }
+            // O eco da digitacao tambem ocupa a tela
+            if (terminal->interativo) {
+                anexarTexto(&terminal->tela, linha, strlen(linha));
+            }
+        }
+
+        // Tudo depois de um TAB e anotacao da transcricao, nao comando
+        linha[strcspn(linha, "\t\r\n")] = '\0';
+        char* texto = aparaTexto(linha);
+        if (texto[0] == '#') {
+            continue;
+        }
+
+        snprintf(destino, tamanho, "%s", texto);
+        return 1;
+    }
+}
+
+void transcrever(Sessao* sessao, const char* entrada) {
+    if (sessao->terminal->transcricao != NULL) {
+        fprintf(sessao->terminal->transcricao, "%s\t%u\t%d\n", entrada,
+                sessao->salaAtual == SEM_SALA ? 0u : sessao->salaAtual, sessao->caderno.totalPistas);
+    }
+}
+
+char lerOpcao(Sessao* sessao) {
+    char linha[64];
+
+    // Linhas vazias sao ignoradas como no scanf(" %c"); fim da entrada encerra
+    do {
+        if (!lerLinha(sessao->terminal, linha, sizeof(linha))) {
+            transcrever(sessao, "s");
+            return 's';
+        }
+    } while (linha[0] == '\0');
+
+    linha[1] = '\0';
+    transcrever(sessao, linha);
+    return linha[0];
+}
+
+void lerComando(Sessao* sessao, char* destino, size_t tamanho) {
+    // Como lerOpcao, mas o numero de uma saida vale inteiro ("12")
+    do {
+        if (!lerLinha(sessao->terminal, destino, tamanho)) {
+            snprintf(destino, tamanho, "s");
+            break;
+        }
+    } while (destino[0] == '\0');
+
+    if (!isdigit((unsigned char)destino[0])) {
+        destino[1] = '\0';
+    }
+    transcrever(sessao, destino);
+}
+
+void lerNome(Sessao* sessao, char* destino, size_t tamanho) {
+    do {
+        if (!lerLinha(sessao->terminal, destino, tamanho)) {
+            destino[0] = '\0';
+            break;
+        }
+    } while (destino[0] == '\0');
+    transcrever(sessao, destino);
+}
+
+void limparTela(Terminal* terminal) {
+    if (terminal->interativo) {
+        // Texto pendente seria apagado antes de ser lido: descarta
+        terminal->quadro.tamanho = 0;
+        terminal->quadroNovo = 1;
+    }
+}
+
+void pausarExecucao(Terminal* terminal) {
+    if (!terminal->interativo) {
+        return;
+    }
+    char descarte[64];
+    exibir(terminal, "\nPressione Enter para continuar...");
+    lerLinha(terminal, descarte, sizeof(descarte));
+}
+
+void mostrarTitulo(Terminal* terminal) {
+    exibir(terminal, "=== DETECTIVE QUEST - SISTEMA DE PISTAS ===\n\n");
+}
+
+void mostrarBoasVindas(Terminal* terminal) {
+    exibir(terminal, "Bem-vindo ao Detective Quest - Sistema de Pistas!\n");
+    exibir(terminal, "Explore a mansao, colete pistas e resolva o misterio.\n");
+    exibir(terminal, "\n");
+    exibir(terminal, "Pressione Enter para comecar a investigacao...");
+}
+
+void mostrarDespedida(Terminal* terminal) {
+    limparTela(terminal);
+    exibir(terminal, "=== INVESTIGACAO CONCLUIDA ===\n\n");
+    exibir(terminal, "Obrigado por jogar Detective Quest!\n");
+    exibir(terminal, "Aqui estao todas as pistas coletadas:\n\n");
+}
+
+void mostrarStatusInvestigacao(Sessao* sessao) {
+    Terminal* terminal = sessao->terminal;
+    exibir(terminal, "\nStatus da Investigacao:\n");
+    exibir(terminal, "Pistas coletadas: %d\n", sessao->caderno.totalPistas);
+
+    // Placar ao vivo: leitura direta da pontuacao do caderno
+    exibir(terminal, "Evidencias:");
+    for (int i = 0; i < sessao->caderno.numSuspeitos; i++) {
+        exibir(terminal, " %s=%g", sessao->tabelaHash->suspeitos[i], (double)sessao->caderno.pontuacao[i]);
+    }
+    exibir(terminal, "\n");
+}
+
+// --- Navegação
+
+void inicializarRegistroVisitas(RegistroVisitas* visitas, Arena* arena, uint32_t numSalas) {
+    size_t palavras = ((size_t)numSalas + 63) / 64;
+    visitas->bits = (uint64_t*)alocarNaArena(arena, palavras * sizeof(uint64_t));
+    visitas->pistasColetadas = (uint64_t*)alocarNaArena(arena, palavras * sizeof(uint64_t));
+    visitas->numSalas = numSalas;
+    visitas->arena = NULL;
+    visitas->salasEsparsas = NULL;
+    visitas->pistasEsparsas = NULL;
+    visitas->capacidadeEsparsa = 0;
+    resetarVisitas(visitas);
+    memset(visitas->pistasColetadas, 0, palavras * sizeof(uint64_t));
+}
+
+void inicializarVisitasEsparsas(RegistroVisitas* visitas, Arena* arena, uint32_t numSalas) {
+    visitas->bits = NULL;
+    visitas->pistasColetadas = NULL;
+    visitas->numSalas = numSalas;
+    visitas->arena = arena;
+    visitas->capacidadeEsparsa = CAPACIDADE_INICIAL_VISITAS;
+    visitas->salasEsparsas = (uint32_t*)alocarNaArena(arena, visitas->capacidadeEsparsa * sizeof(uint32_t));
+    visitas->pistasEsparsas = (unsigned char*)alocarNaArena(arena, visitas->capacidadeEsparsa);
+    resetarVisitas(visitas);
+}
+
+size_t posicaoVisitaEsparsa(const RegistroVisitas* visitas, uint32_t sala) {
+    // Sondagem linear; devolve a posicao da sala ou a livre onde ela entraria
+    size_t mascara = visitas->capacidadeEsparsa - 1;
+    size_t posicao = (size_t)(((uint64_t)sala * 0x9E3779B97F4A7C15ull) >> 32) & mascara;
+    while (visitas->salasEsparsas[posicao] != SEM_SALA && visitas->salasEsparsas[posicao] != sala) {
+        posicao = (posicao + 1) & mascara;
+    }
+    return posicao;
+}
+
+void crescerVisitasEsparsas(RegistroVisitas* visitas) {
+    // Os vetores antigos ficam na arena da sessao: somados, menos que os novos
+    uint32_t* salasAntigas = visitas->salasEsparsas;
+    unsigned char* pistasAntigas = visitas->pistasEsparsas;
+    size_t capacidadeAntiga = visitas->capacidadeEsparsa;
+
+    visitas->capacidadeEsparsa = capacidadeAntiga * 2;
+    visitas->salasEsparsas = (uint32_t*)alocarNaArena(visitas->arena, visitas->capacidadeEsparsa * sizeof(uint32_t));
+    visitas->pistasEsparsas = (unsigned char*)alocarNaArena(visitas->arena, visitas->capacidadeEsparsa);
+    memset(visitas->salasEsparsas, 0xFF, visitas->capacidadeEsparsa * sizeof(uint32_t));
+    for (size_t i = 0; i < capacidadeAntiga; i++) {
+        if (salasAntigas[i] != SEM_SALA) {
+            size_t posicao = posicaoVisitaEsparsa(visitas, salasAntigas[i]);
+            visitas->salasEsparsas[posicao] = salasAntigas[i];
+            visitas->pistasEsparsas[posicao] = pistasAntigas[i];
+        }
+    }
+}
+
+void marcarSalaComoVisitada(RegistroVisitas* visitas, uint32_t sala) {
+    if (sala == SEM_SALA) {
+        return;
+    }
+    if (visitas->bits == NULL) {
+        if ((size_t)visitas->salasVisitadas + 1 > visitas->capacidadeEsparsa * CARGA_MAXIMA_HASH_NUM / CARGA_MAXIMA_HASH_DEN) {
+            crescerVisitasEsparsas(visitas);
+        }
+        size_t posicao = posicaoVisitaEsparsa(visitas, sala);
+        if (visitas->salasEsparsas[posicao] == SEM_SALA) {
+            visitas->salasEsparsas[posicao] = sala;
+            visitas->pistasEsparsas[posicao] = 0;
+            visitas->salasVisitadas++;
+        }
+        return;
+    }
+    uint64_t mascara = (uint64_t)1 << (sala & 63);
+    uint64_t* palavra = &visitas->bits[sala >> 6];
+    if ((*palavra & mascara) == 0) {
+        *palavra |= mascara;
+        visitas->salasVisitadas++;
+    }
+}
+
+int salaFoiVisitada(const RegistroVisitas* visitas, uint32_t sala) {
+    if (visitas->bits == NULL) {
+        return visitas->salasEsparsas[posicaoVisitaEsparsa(visitas, sala)] == sala;
+    }
+    return (int)((visitas->bits[sala >> 6] >> (sala & 63)) & 1);
+}
+
+int pistaFoiColetada(const RegistroVisitas* visitas, uint32_t sala) {
+    if (visitas->bits == NULL) {
+        size_t posicao = posicaoVisitaEsparsa(visitas, sala);
+        return visitas->salasEsparsas[posicao] == sala && visitas->pistasEsparsas[posicao];
+    }
+    return (int)((visitas->pistasColetadas[sala >> 6] >> (sala & 63)) & 1);
+}
+
+void marcarPistaColetada(RegistroVisitas* visitas, uint32_t sala) {
+    if (visitas->bits == NULL) {
+        // A pista e recolhida dentro da sala: ela ja esta no conjunto
+        marcarSalaComoVisitada(visitas, sala);
+        visitas->pistasEsparsas[posicaoVisitaEsparsa(visitas, sala)] = 1;
+        return;
+    }
+    visitas->pistasColetadas[sala >> 6] |= (uint64_t)1 << (sala & 63);
+}
+
+void desmarcarPistaColetada(RegistroVisitas* visitas, uint32_t sala) {
+    // A sala continua visitada: so a pista volta a ficar pendente
+    if (visitas->bits == NULL) {
+        size_t posicao = posicaoVisitaEsparsa(visitas, sala);
+        if (visitas->salasEsparsas[posicao] == sala) {
+            visitas->pistasEsparsas[posicao] = 0;
+        }
+        return;
+    }
+    visitas->pistasColetadas[sala >> 6] &= ~((uint64_t)1 << (sala & 63));
+}
+
+void resetarVisitas(RegistroVisitas* visitas) {
+    // No modo esparso as pistas recolhidas saem junto com as salas
+    if (visitas->bits == NULL) {
+        memset(visitas->salasEsparsas, 0xFF, visitas->capacidadeEsparsa * sizeof(uint32_t));
+        visitas->salasVisitadas = 0;
+        return;
+    }
+    size_t palavras = ((size_t)visitas->numSalas + 63) / 64;
+    memset(visitas->bits, 0, palavras * sizeof(uint64_t));
+    visitas->salasVisitadas = 0;
+}
+
+int todasSalasVisitadas(const RegistroVisitas* visitas) {
+    return visitas->salasVisitadas == visitas->numSalas;
+}
+
+int salaTemPistaPendente(const Mansao* mansao, CacheSalas* cache, const RegistroVisitas* visitas, uint32_t sala) {
+    // A mansao e somente leitura: a pista recolhida fica marcada no registro
+    if (pistaSala(mansao, cache, sala)[0] == '\0') {
+        return 0;
+    }
+    return !pistaFoiColetada(visitas, sala);
+}
+
+int verificarFimDoCaminho(const Mansao* mansao, CacheSalas* cache, uint32_t salaAtual) {
+    return grauDaSala(mansao, cache, salaAtual) == 0;
+}
+
+void iniciarSessao(Sessao* sessao, Arena* arena, const Mansao* mansao, CacheSalas* cache, const TabelaHash* tabelaHash, Terminal* terminal) {
+    sessao->arena = arena;
+    sessao->mansao = mansao;
+    sessao->cache = cache;
+    sessao->tabelaHash = tabelaHash;
+    sessao->terminal = terminal;
+    sessao->salvamento = NULL;
+    sessao->estatisticas = NULL;
+    sessao->eventos = NULL;
+    sessao->numero = 0;
+    sessao->salaAtual = SALA_HALL;
+    inicializarCaderno(&sessao->caderno, arena, tabelaHash);
+    if (mansao->procedural != NULL) {
+        inicializarVisitasEsparsas(&sessao->visitas, arena, mansao->numSalas);
+    } else {
+        inicializarRegistroVisitas(&sessao->visitas, arena, mansao->numSalas);
+    }
+}
+
+void anotarPistaDaSala(Sessao* sessao, uint32_t sala) {
+    // Parte silenciosa da coleta, usada tambem ao reler o diario
+    uint32_t idPista = idPistaDaSala(sessao->mansao, sessao->cache, sala);
+    registrarPistaNoCaderno(sessao->arena, &sessao->caderno, idPista, sala);
+    marcarPistaColetada(&sessao->visitas, sala);
+}
+
+int desfazerPistaDaSessao(Sessao* sessao, uint32_t* sala) {
+    // Parte silenciosa de desfazer: a pista volta a esperar na sala
+    if (!desfazerPistaNoCaderno(&sessao->caderno, sala)) {
+        return 0;
+    }
+    if (*sala != SEM_SALA) {
+        desmarcarPistaColetada(&sessao->visitas, *sala);
+    }
+    return 1;
+}
+
+void coletarPista(Sessao* sessao) {
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+    uint32_t salaAtual = sessao->salaAtual;
+
+    if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, salaAtual)) {
+        const char* pista = pistaSala(mansao, sessao->cache, salaAtual);
+        exibir(terminal, "\n========================================\n");
+        exibir(terminal, "PISTA ENCONTRADA NA SALA: %s\n", nomeSala(mansao, sessao->cache, salaAtual));
+        exibir(terminal, "Pista: %s\n", pista);
+
+        // O id foi resolvido na carga: nenhuma busca por texto durante o jogo
+        uint32_t idPista = idPistaDaSala(mansao, sessao->cache, salaAtual);
+        int indiceSuspeito = indiceSuspeitoDaPista(sessao->tabelaHash, idPista);
+        const float* linha = linhaDePesos(sessao->tabelaHash, idPista);
+        exibir(terminal, "Suspeito associado: %s", indiceSuspeito >= 0 ? sessao->tabelaHash->suspeitos[indiceSuspeito] : "Desconhecido");
+        if (indiceSuspeito >= 0 && linha[indiceSuspeito] != 1.0f) {
+            exibir(terminal, " (peso %g)", (double)linha[indiceSuspeito]);
+        }
+        exibir(terminal, "\n");
+        for (int s = 0; linha != NULL && s < sessao->tabelaHash->numSuspeitos; s++) {
+            if (s != indiceSuspeito && linha[s] > 0.0f) {
+                exibir(terminal, "Tambem aponta para: %s (peso %g)\n", sessao->tabelaHash->suspeitos[s], (double)linha[s]);
+            }
+        }
+        exibir(terminal, "========================================\n");
+
+        anotarPistaDaSala(sessao, salaAtual);
+        registrarEvento(sessao, EVENTO_PISTA, salaAtual, idPista, indiceSuspeito, 0);
+        exibir(terminal, ">>> Pista registrada no caderno de investigacao!\n");
+    } else {
+        exibir(terminal, "Nenhuma pista nova encontrada aqui.\n");
+    }
+}
+
+void verificarPistaColetada(Sessao* sessao) {
+    if (!salaTemPistaPendente(sessao->mansao, sessao->cache, &sessao->visitas, sessao->salaAtual)) {
+        exibir(sessao->terminal, "Esta sala ja foi investigada.\n");
+    }
+}
+
+void mostrarCaminhosDisponiveis(Sessao* sessao) {
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+    uint32_t grau = grauDaSala(mansao, sessao->cache, sessao->salaAtual);
+
+    exibir(terminal, "\nCaminhos disponiveis:\n");
+    for (uint32_t k = 0; k < grau; k++) {
+        // Copia da saida antes de pedir o nome: numa mansao procedural a
+        // consulta ao destino pode reaproveitar a via da sala atual
+        Saida saida = saidasDaSala(mansao, sessao->cache, sessao->salaAtual)[k];
+        const char* nome = nomeSala(mansao, sessao->cache, saida.destino);
+        const char* estado = salaFoiVisitada(&sessao->visitas, saida.destino) ? "VISITADO" : "NOVO";
+        if (saida.tecla == 'e') {
+            exibir(terminal, "[e] Esquerda -> %s (%s)\n", nome, estado);
+        } else if (saida.tecla == 'd') {
+            exibir(terminal, "[d] Direita  -> %s (%s)\n", nome, estado);
+        } else {
+            exibir(terminal, "[%u] Passagem -> %s (%s)\n", k + 1, nome, estado);
+        }
+    }
+    exibir(terminal, "[b] Buscar no caderno\n");
+    exibir(terminal, "[u] Desfazer a ultima pista\n");
+    exibir(terminal, "[s] Sair da investigacao\n");
+}
+
+void buscarNoCaderno(Sessao* sessao) {
+    Terminal* terminal = sessao->terminal;
+    Caderno* caderno = &sessao->caderno;
+    char consulta[128];
+
+    exibir(terminal, "\nBuscar no caderno (palavras ou inicio de palavras): ");
+    lerNome(sessao, consulta, sizeof(consulta));
+
+    uint32_t ids[MAX_RESULTADOS_BUSCA];
+    int encontrados = consultarIndiceBusca(&caderno->palavras, consulta, ids, MAX_RESULTADOS_BUSCA);
+    if (encontrados == 0) {
+        exibir(terminal, "Nenhuma pista do caderno corresponde a busca.\n");
+    } else {
+        exibir(terminal, "Pistas encontradas%s:\n", encontrados == MAX_RESULTADOS_BUSCA ? " (primeiras)" : "");
+        for (int i = 0; i < encontrados; i++) {
+            int indiceSuspeito = indiceSuspeitoDaPista(sessao->tabelaHash, ids[i]);
+            exibir(terminal, "- %s -> %s\n", textoPista(sessao->tabelaHash, ids[i]),
+                   indiceSuspeito >= 0 ? sessao->tabelaHash->suspeitos[indiceSuspeito] : "Desconhecido");
+        }
+    }
+
+    // Autocompletar o ultimo termo digitado
+    const char* termos[MAX_TERMOS_BUSCA];
+    uint32_t tamanhos[MAX_TERMOS_BUSCA];
+    int numTermos = separarTermos(consulta, termos, tamanhos, MAX_TERMOS_BUSCA);
+    SugestaoBusca sugestoes[MAX_SUGESTOES_BUSCA];
+    int numSugestoes = numTermos > 0 ? completarPalavra(&caderno->palavras, termos[numTermos - 1], tamanhos[numTermos - 1],
+                                                        sugestoes, MAX_SUGESTOES_BUSCA) : 0;
+    if (numSugestoes > 0) {
+        exibir(terminal, "Palavras no caderno:");
+        for (int i = 0; i < numSugestoes; i++) {
+            exibir(terminal, " %s(%u)", sugestoes[i].palavra, sugestoes[i].ocorrencias);
+        }
+        exibir(terminal, "\n");
+    }
+}
+
+void desfazerUltimaPista(Sessao* sessao) {
+    Terminal* terminal = sessao->terminal;
+    uint32_t sala;
+
+    if (!desfazerPistaDaSessao(sessao, &sala)) {
+        exibir(terminal, "\nNao ha pista para desfazer no caderno.\n");
+        return;
+    }
+    if (sala != SEM_SALA) {
+        exibir(terminal, "\n>>> Pista desfeita: %s\n", pistaSala(sessao->mansao, sessao->cache, sala));
+        exibir(terminal, "Ela continua em %s, esperando para ser recolhida de novo.\n", nomeSala(sessao->mansao, sessao->cache, sala));
+    } else {
+        exibir(terminal, "\n>>> O caderno voltou para a versao anterior.\n");
+    }
+    exibir(terminal, "Pistas no caderno: %d\n", sessao->caderno.totalPistas);
+    registrarAcao(sessao, SEM_SALA); // no diario, SEM_SALA e desfazer
+}
+
+void voltarAoHall(Sessao* sessao, int exibirCaminho) {
+    // Segue o rumo calculado na carga: o caminho mais curto ate o Hall,
+    // andando pelos corredores em qualquer sentido. As salas do caminho
+    // contam como visitadas e as pistas que ainda estiverem nelas sao
+    // recolhidas; numa arvore o caminho so refaz salas ja vistas.
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+    uint32_t sala = sessao->salaAtual;
+    uint32_t passos = 0;
+
+    if (exibirCaminho) {
+        exibir(terminal, "Voltando ao Hall de Entrada pelo caminho mais curto:\n");
+    }
+    while (sala != SALA_HALL && rumoDaSala(mansao, sala) != SEM_SALA) {
+        registrarEvento(sessao, EVENTO_SALA, rumoDaSala(mansao, sala), sala, -1, 0);
+        sala = rumoDaSala(mansao, sala);
+        passos++;
+        marcarSalaComoVisitada(&sessao->visitas, sala);
+        if (exibirCaminho) {
+            exibir(terminal, "  -> %s\n", nomeSala(mansao, sessao->cache, sala));
+        }
+        if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, sala)) {
+            if (exibirCaminho) {
+                sessao->salaAtual = sala;
+                coletarPista(sessao);
+            } else {
+                anotarPistaDaSala(sessao, sala);
+            }
+        }
+    }
+    // Sala sem ligacao com o Hall (so num cenario desconexo): volta direto
+    sessao->salaAtual = SALA_HALL;
+    if (exibirCaminho) {
+        exibir(terminal, "Voce voltou ao Hall de Entrada (%u %s).\n", passos, passos == 1 ? "sala" : "salas");
+    }
+}
+
+void entrarPelaSaida(Sessao* sessao, uint32_t destino) {
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+
+    // Verificar se a sala já foi visitada
+    if (salaFoiVisitada(&sessao->visitas, destino)) {
+        exibir(terminal, "\nVoce ja visitou esta sala anteriormente!\n");
+        exibir(terminal, "Deseja visitar novamente? (s/n): ");
+        char resposta = lerOpcao(sessao);
+        int aceita = resposta == 's' || resposta == 'S';
+        registrarEvento(sessao, EVENTO_REVISITA, destino, sessao->salaAtual, -1, aceita);
+        if (!aceita) {
+            exibir(terminal, "Escolha outro caminho.\n");
+            pausarExecucao(terminal);
+            return;
+        }
+    }
+
+    registrarEvento(sessao, EVENTO_SALA, destino, sessao->salaAtual, -1, 0);
+    sessao->salaAtual = destino;
+    marcarSalaComoVisitada(&sessao->visitas, destino); // Marcar como visitada
+    exibir(terminal, "\n>>> Voce entrou em: %s\n", nomeSala(mansao, sessao->cache, destino));
+    if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, destino)) {
+        exibir(terminal, ">>> Procurando por pistas...\n");
+    }
+    coletarPista(sessao);
+
+    // Sala sem saida: volta ao Hall a pe, pelo caminho mais curto
+    if (verificarFimDoCaminho(mansao, sessao->cache, destino)) {
+        exibir(terminal, "\n>>> Voce chegou ao fim deste caminho!\n");
+        voltarAoHall(sessao, 1);
+    }
+    // Vai para o diario antes da pausa: a jogada ja esta completa
+    registrarAcao(sessao, destino);
+    pausarExecucao(terminal);
+}
+
+void processarNavegacaoComPistas(Sessao* sessao, const char* comando) {
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+    uint32_t* salaAtual = &sessao->salaAtual;
+    char opcao = comando[0];
+
+    uint64_t inicio = 0;
+    uint64_t esperaAntes = terminal->nanosEmEspera;
+    if (sessao->estatisticas != NULL) {
+        inicio = agoraNanos();
+    }
+
+    switch (opcao) {
+        case 'e':
+        case 'E':
+        case 'd':
+        case 'D': {
+            uint32_t destino = salaPelaTecla(mansao, sessao->cache, *salaAtual, minuscula(opcao));
+            if (destino != SEM_SALA) {
+                entrarPelaSaida(sessao, destino);
+            } else {
+                exibir(terminal, "\nNao ha caminho a %s!\n", minuscula(opcao) == 'e' ? "esquerda" : "direita");
+                pausarExecucao(terminal);
+            }
+            break;
+        }
+
+        // Qualquer saida vale pelo numero na lista; 'e' e 'd' tambem pela tecla
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9': {
+            char* fim;
+            unsigned long numero = strtoul(comando, &fim, 10);
+            if (*fim == '\0' && numero >= 1 && numero <= grauDaSala(mansao, sessao->cache, *salaAtual)) {
+                entrarPelaSaida(sessao, saidasDaSala(mansao, sessao->cache, *salaAtual)[numero - 1].destino);
+            } else {
+                exibir(terminal, "\nNao ha saida numero %s nesta sala!\n", comando);
+                pausarExecucao(terminal);
+            }
+            break;
+        }
+
+        case 's':
+        case 'S': {
+            exibir(terminal, "\nDeseja realmente sair da investigacao? (s/n): ");
+            char confirmacao = lerOpcao(sessao);
+            if (confirmacao == 's' || confirmacao == 'S') {
+                exibir(terminal, "Saindo do Detective Quest...\n");
+                if (sessao->salvamento != NULL) {
+                    gravarInstantaneo(sessao); // o diario recomeca vazio
+                }
+                *salaAtual = SEM_SALA;
+            }
+            break;
+        }
+
+        case 'b':
+        case 'B':
+            buscarNoCaderno(sessao);
+            pausarExecucao(terminal);
+            break;
+
+        case 'u':
+        case 'U':
+            desfazerUltimaPista(sessao);
+            pausarExecucao(terminal);
+            break;
+
+        default:
+            exibir(terminal, "\nOpcao invalida! Use 'e', 'd', o numero de uma saida, 'b', 'u' ou 's'.\n");
+            pausarExecucao(terminal);
+            break;
+    }
+
+    if (sessao->estatisticas != NULL) {
+        uint64_t nanos = agoraNanos() - inicio - (terminal->nanosEmEspera - esperaAntes);
+        registrarLatenciaAcao(sessao->estatisticas, tipoDaAcao(comando), nanos);
+    }
+}
+
+void explorarSalasComPistas(Sessao* sessao) {
+    const Mansao* mansao = sessao->mansao;
+    Terminal* terminal = sessao->terminal;
+    char comando[16];
+
+    if (sessao->visitas.salasVisitadas > 0) {
+        // Sessao retomada de um salvamento: o Hall ja foi investigado
+        exibir(terminal, "\n>>> Investigacao retomada na: %s\n", nomeSala(mansao, sessao->cache, sessao->salaAtual));
+        exibir(terminal, "Salas visitadas: %u | Pistas no caderno: %d\n",
+               sessao->visitas.salasVisitadas, sessao->caderno.totalPistas);
+    } else {
+        // Marcar Hall de Entrada como visitada no início
+        registrarEvento(sessao, EVENTO_SALA, sessao->salaAtual, SEM_SALA, -1, 0);
+        marcarSalaComoVisitada(&sessao->visitas, sessao->salaAtual);
+
+        // Coletar pista apenas do Hall de Entrada no inicio
+        exibir(terminal, "\n>>> Voce comecou no: %s\n", nomeSala(mansao, sessao->cache, sessao->salaAtual));
+        if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, sessao->salaAtual)) {
+            exibir(terminal, ">>> Procurando por pistas...\n");
+        }
+        coletarPista(sessao);
+    }
+    pausarExecucao(terminal);
+
+    while (sessao->salaAtual != SEM_SALA) {
+        limparTela(terminal);
+        mostrarTitulo(terminal);
+
+        exibir(terminal, "Voce esta na: %s\n", nomeSala(mansao, sessao->cache, sessao->salaAtual));
+        verificarPistaColetada(sessao);
+        mostrarStatusInvestigacao(sessao);
+
+        // Verificar se todas as salas foram visitadas
+        if (todasSalasVisitadas(&sessao->visitas)) {
+            exibir(terminal, "\n>>> PARABENS! Voce explorou todas as salas da mansao!\n");
+            exibir(terminal, "Voce pode continuar explorando ou sair para o julgamento final.\n");
+        }
+
+        mostrarCaminhosDisponiveis(sessao);
+
+        exibir(terminal, "\nPara onde deseja ir? ");
+        lerComando(sessao, comando, sizeof(comando));
+
+        processarNavegacaoComPistas(sessao, comando);
+    }
+}
+
+// --- Suspeitos
+
+void listarSuspeitos(Terminal* terminal, const TabelaHash* tabelaHash, const PosicaoSuspeito* classificacao) {
+    exibir(terminal, "\n=== SUSPEITOS ===\n");
+    for (int i = 0; i < tabelaHash->numSuspeitos; i++) {
+        exibir(terminal, "%d. %s (%g pontos)\n", i + 1, tabelaHash->suspeitos[classificacao[i].indice],
+               (double)classificacao[i].pontuacao);
+    }
+    exibir(terminal, "=================\n");
+}
+
+float pontuacaoDoSuspeito(const Caderno* caderno, const TabelaHash* tabelaHash, const char* suspeito) {
+    // A pontuacao e mantida por registrarPistaNoCaderno; aqui e so uma leitura
+    int indice = buscarIndiceSuspeitoPorNome(tabelaHash, suspeito);
+    if (indice < 0 || indice >= caderno->numSuspeitos) {
+        return 0.0f;
+    }
+    return caderno->pontuacao[indice];
+}
+
+int resolverSuspeito(const TabelaHash* tabela, const char* digitado, int* candidatos, int maximo) {
+    // Nome exato primeiro; senao, suspeitos com palavras que comecam
+    // pelos termos digitados ("ma" -> Maria, "sus 3" -> Suspeito 3)
+    int indice = buscarIndiceSuspeitoPorNome(tabela, digitado);
+    if (indice >= 0) {
+        candidatos[0] = indice;
+        return 1;
+    }
+    uint32_t ids[MAX_SUGESTOES_BUSCA];
+    int encontrados = consultarIndiceBusca(&tabela->indiceSuspeitos, digitado, ids,
+                                           maximo < MAX_SUGESTOES_BUSCA ? maximo : MAX_SUGESTOES_BUSCA);
+    for (int i = 0; i < encontrados; i++) {
+        candidatos[i] = (int)ids[i];
+    }
+    return encontrados;
+}
+
+int verificarSuspeitoFinal(Sessao* sessao) {
+    Terminal* terminal = sessao->terminal;
+    char digitado[50];
+
+    exibir(terminal, "\n=== FASE DE JULGAMENTO ===\n");
+    exibir(terminal, "Com base nas pistas coletadas, quem e o culpado?\n");
+
+    // O veredito recalcula a pontuacao numa passada so, em ordem de id,
+    // para nao depender da ordem em que as pistas foram somadas ao vivo
+    const TabelaHash* tabela = sessao->tabelaHash;
+    float* pontuacao = criarVetorPontuacao(sessao->arena, tabela);
+    pontuarCaderno(&sessao->caderno, pontuacao);
+    PosicaoSuspeito* classificacao =
+        (PosicaoSuspeito*)alocarNaArena(sessao->arena, ((size_t)tabela->numSuspeitos + 1) * sizeof(PosicaoSuspeito));
+    classificarSuspeitos(pontuacao, tabela->numSuspeitos, classificacao);
+
+    listarSuspeitos(terminal, tabela, classificacao);
+
+    exibir(terminal, "\nDigite o nome do suspeito: ");
+    lerNome(sessao, digitado, sizeof(digitado));
+
+    // Nome incompleto: com um so candidato ele e completado; com varios,
+    // os candidatos sao mostrados e o nome e pedido de novo
+    const char* suspeito = digitado;
+    int indiceAcusado = -1;
+    for (;;) {
+        int candidatos[MAX_SUGESTOES_BUSCA];
+        int numCandidatos = resolverSuspeito(sessao->tabelaHash, digitado, candidatos, MAX_SUGESTOES_BUSCA);
+        if (numCandidatos == 1) {
+            indiceAcusado = candidatos[0];
+            suspeito = sessao->tabelaHash->suspeitos[candidatos[0]];
+            if (strcmp(suspeito, digitado) != 0) {
+                exibir(terminal, "Nome completado: %s\n", suspeito);
+            }
+        }
+        if (numCandidatos <= 1) {
+            break;
+        }
+        exibir(terminal, "Mais de um suspeito corresponde a \"%s\":", digitado);
+        for (int i = 0; i < numCandidatos; i++) {
+            exibir(terminal, "%s %s", i > 0 ? "," : "", sessao->tabelaHash->suspeitos[candidatos[i]]);
+        }
+        exibir(terminal, "%s\n", numCandidatos == MAX_SUGESTOES_BUSCA ? ", ..." : "");
+        exibir(terminal, "\nDigite o nome do suspeito: ");
+        lerNome(sessao, digitado, sizeof(digitado));
+    }
+
+    float pontos = 0.0f;
+    int posicao = 0;
+    for (int i = 0; indiceAcusado >= 0 && i < tabela->numSuspeitos; i++) {
+        if (classificacao[i].indice == indiceAcusado) {
+            pontos = classificacao[i].pontuacao;
+            posicao = i + 1;
+        }
+    }
+
+    exibir(terminal, "\n=== RESULTADO DO JULGAMENTO ===\n");
+    exibir(terminal, "Suspeito acusado: %s\n", suspeito);
+    if (posicao > 0) {
+        exibir(terminal, "Pontuacao de %s: %g (%do de %d)\n", suspeito, (double)pontos, posicao, tabela->numSuspeitos);
+    } else {
+        exibir(terminal, "Pontuacao de %s: 0\n", suspeito);
+    }
+
+    // Tolerancia absorve o arredondamento de pesos como 0.1 somados varias vezes
+    int condenado = pontos >= (float)LIMIAR_CONDENACAO - TOLERANCIA_PESO;
+    registrarEvento(sessao, EVENTO_ACUSACAO, SEM_SALA, (uint32_t)posicao, indiceAcusado, condenado);
+    if (condenado) {
+        exibir(terminal, "\n*** PARABENS! ***\n");
+        exibir(terminal, "Voce reuniu provas suficientes para incriminar %s!\n", suspeito);
+        exibir(terminal, "O caso esta resolvido!\n");
+        return 1;
+    }
+
+    exibir(terminal, "\n*** ATENCAO! ***\n");
+    exibir(terminal, "Poucas pistas apontam para %s.\n", suspeito);
+    exibir(terminal, "Voce nao tem provas suficientes para uma acusacao.\n");
+    exibir(terminal, "O verdadeiro culpado pode escapar!\n");
+    return 0;
+}
+
+void gerarRelatorioFinal(Sessao* sessao) {
+    mostrarDespedida(sessao->terminal);
+    exibirPistasEmOrdem(sessao->terminal, sessao->tabelaHash, sessao->caderno.raiz);
+    exibir(sessao->terminal, "\nTotal de pistas coletadas: %d\n", sessao->caderno.totalPistas);
+}
+
+// --- Finalização
+
+int finalizarJogo(Sessao* sessao) {
+    Terminal* terminal = sessao->terminal;
+    gerarRelatorioFinal(sessao);
+    int condenado = verificarSuspeitoFinal(sessao);
+    registrarEvento(sessao, EVENTO_FIM_SESSAO, SEM_SALA, (uint32_t)sessao->caderno.totalPistas, -1, condenado);
+
+    // Revelar o culpado real se o jogador nao acertou
+    exibir(terminal, "\nDeseja saber quem era o verdadeiro culpado? (s/n): ");
+    char resposta = lerOpcao(sessao);
+    if (resposta == 's' || resposta == 'S') {
+        revelarCulpadoReal(terminal, sessao->mansao, sessao->tabelaHash);
+    }
+
+    if (terminal->transcricao != NULL) {
+        fprintf(terminal->transcricao, "#fim\t%u\t%d\t%d\n", sessao->visitas.salasVisitadas,
+                sessao->caderno.totalPistas, condenado);
+    }
+
+    apresentarQuadro(terminal);
+
+    if (sessao->estatisticas != NULL) {
+        encerrarInstrumentacao(sessao);
+    }
+
+    // Caderno e registro de visitas vivem na arena da sessao
+    liberarArena(sessao->arena);
+    return condenado;
+}
+
+int jogarSessao(Sessao* sessao) {
+    mostrarBoasVindas(sessao->terminal);
+    if (sessao->terminal->interativo) {
+        char descarte[64];
+        lerLinha(sessao->terminal, descarte, sizeof(descarte));
+    }
+
+    explorarSalasComPistas(sessao);
+    return finalizarJogo(sessao);
+}
+
+// --- Salvamento
+//
+// O instantaneo guarda o estado inteiro da sessao em forma compacta; o
+// diario so recebe as salas em que o jogador entrou desde entao. Para
+// retomar, o instantaneo e mapeado e copiado, e so a cauda do diario e
+// reaplicada. A cada INTERVALO_INSTANTANEO acoes um novo instantaneo
+// substitui o anterior e o diario recomeca vazio.
+
+uint64_t impressaoDigitalMansao(const Mansao* mansao) {
+    // FNV-1a por palavra sobre o grafo: barato mesmo com milhoes de saidas
+    uint64_t hash = 14695981039346656037ull;
+    hash = (hash ^ mansao->numSalas) * 1099511628211ull;
+    hash = (hash ^ mansao->numPares) * 1099511628211ull;
+    hash = (hash ^ mansao->tamanhoTextos) * 1099511628211ull;
+    hash = (hash ^ mansao->numSaidas) * 1099511628211ull;
+    for (uint32_t i = 0; i < mansao->numSalas; i++) {
+        hash = (hash ^ mansao->inicioSaidas[i + 1]) * 1099511628211ull;
+    }
+    for (uint32_t k = 0; k < mansao->numSaidas; k++) {
+        const Saida* saida = &mansao->saidas[k];
+        hash = (hash ^ saida->destino) * 1099511628211ull;
+        hash = (hash ^ ((uint32_t)saida->custo << 8 | (unsigned char)saida->tecla)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+char* caminhoComExtensao(Arena* arena, const char* base, const char* extensao) {
+    size_t tamanho = strlen(base) + strlen(extensao) + 1;
+    char* caminho = (char*)alocarNaArena(arena, tamanho);
+    snprintf(caminho, tamanho, "%s%s", base, extensao);
+    return caminho;
+}
+
+char* diretorioDoCaminho(Arena* arena, const char* caminho) {
+    const char* barra = strrchr(caminho, '/');
+    if (barra == NULL) {
+        return copiarTextoNaArena(arena, ".");
+    }
+    size_t tamanho = barra == caminho ? 1 : (size_t)(barra - caminho);
+    char* diretorio = (char*)alocarNaArena(arena, tamanho + 1);
+    memcpy(diretorio, caminho, tamanho);
+    diretorio[tamanho] = '\0';
+    return diretorio;
+}
+
+// fflush so entrega os dados ao sistema; fsync (ou fdatasync, que pula
+// metadados como o horario) so retorna quando estao no disco
+int sincronizarArquivo(FILE* arquivo, int soDados) {
+    if (fflush(arquivo) != 0) {
+        return 0;
+    }
+#ifdef _WIN32
+    (void)soDados;
+    return _commit(_fileno(arquivo)) == 0;
+#else
+    int descritor = fileno(arquivo);
+    return (soDados ? fdatasync(descritor) : fsync(descritor)) == 0;
+#endif
+}
+
+// Um rename so sobrevive a queda de energia depois que o diretorio que o
+// contem e sincronizado
+int sincronizarDiretorio(const char* caminho) {
+#ifdef _WIN32
+    (void)caminho; // sem equivalente: o NTFS registra o rename no proprio diario
+    return 1;
+#else
+    int descritor = open(caminho, O_RDONLY | O_DIRECTORY);
+    if (descritor < 0) {
+        return 0;
+    }
+    int sucesso = fsync(descritor) == 0;
+    close(descritor);
+    return sucesso;
+#endif
+}
+
+void abrirSalvamento(Salvamento* salvamento, Arena* arena, const char* base, const Mansao* mansao) {
+    salvamento->caminhoInstantaneo = caminhoComExtensao(arena, base, ".dqs");
+    salvamento->caminhoTemporario = caminhoComExtensao(arena, base, ".dqs.tmp");
+    salvamento->caminhoDiario = caminhoComExtensao(arena, base, ".dqj");
+    salvamento->caminhoDiretorio = diretorioDoCaminho(arena, base);
+    salvamento->diario = NULL;
+    salvamento->impressaoMansao = impressaoDigitalMansao(mansao);
+    salvamento->acoes = 0;
+    salvamento->acoesNoInstantaneo = 0;
+}
+
+void fecharSalvamento(Salvamento* salvamento) {
+    if (salvamento->diario != NULL) {
+        fclose(salvamento->diario);
+        salvamento->diario = NULL;
+    }
+}
+
+void escreverIdsEmOrdem(FILE* arquivo, const PistaNode* raiz) {
+    IteradorPistas iterador;
+    iniciarIteradorPistas(&iterador, raiz);
+    for (const PistaNode* no = proximaPista(&iterador); no != NULL; no = proximaPista(&iterador)) {
+        fwrite(&no->idPista, sizeof(uint32_t), 1, arquivo);
+    }
+}
+
+int gravarInstantaneo(Sessao* sessao) {
+    Salvamento* salvamento = sessao->salvamento;
+    size_t palavras = ((size_t)sessao->visitas.numSalas + 63) / 64;
+
+    // Escrito ao lado, levado ao disco e so entao renomeado: nem um
+    // instantaneo pela metade nem um ainda no cache substitui o anterior
+    FILE* arquivo = fopen(salvamento->caminhoTemporario, "wb");
+    if (arquivo == NULL) {
+        printf("Erro: Nao foi possivel criar o arquivo %s.\n", salvamento->caminhoTemporario);
+        return 0;
+    }
+
+    CabecalhoInstantaneo cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.assinatura, ASSINATURA_INSTANTANEO, 4);
+    cabecalho.versao = VERSAO_SALVAMENTO;
+    cabecalho.impressaoMansao = salvamento->impressaoMansao;
+    cabecalho.acoes = salvamento->acoes;
+    cabecalho.numSalas = sessao->visitas.numSalas;
+    cabecalho.salaAtual = sessao->salaAtual;
+    cabecalho.salasVisitadas = sessao->visitas.salasVisitadas;
+    cabecalho.numPistas = (uint32_t)sessao->caderno.totalPistas;
+
+    fwrite(&cabecalho, sizeof(cabecalho), 1, arquivo);
+    fwrite(sessao->visitas.bits, sizeof(uint64_t), palavras, arquivo);
+    fwrite(sessao->visitas.pistasColetadas, sizeof(uint64_t), palavras, arquivo);
+    escreverIdsEmOrdem(arquivo, sessao->caderno.raiz);
+
+    int sucesso = !ferror(arquivo) && sincronizarArquivo(arquivo, 0);
+    if (fclose(arquivo) != 0 || !sucesso) {
+        printf("Erro: Falha ao escrever o arquivo %s.\n", salvamento->caminhoTemporario);
+        return 0;
+    }
+#ifdef _WIN32
+    remove(salvamento->caminhoInstantaneo); // rename nao substitui no Windows
+#endif
+    if (rename(salvamento->caminhoTemporario, salvamento->caminhoInstantaneo) != 0) {
+        printf("Erro: Nao foi possivel substituir o arquivo %s.\n", salvamento->caminhoInstantaneo);
+        return 0;
+    }
+    // O diario so pode ser truncado com o rename ja no disco
+    if (!sincronizarDiretorio(salvamento->caminhoDiretorio)) {
+        printf("Erro: Nao foi possivel sincronizar o diretorio %s.\n", salvamento->caminhoDiretorio);
+        return 0;
+    }
+
+    // Diario novo: tudo ate aqui ja esta no instantaneo. Se o processo cair
+    // antes disso, os registros antigos sao pulados pela sequencia
+    fecharSalvamento(salvamento);
+    salvamento->diario = fopen(salvamento->caminhoDiario, "wb");
+    if (salvamento->diario == NULL) {
+        printf("Erro: Nao foi possivel criar o arquivo %s.\n", salvamento->caminhoDiario);
+        return 0;
+    }
+    CabecalhoDiario cabecalhoDiario;
+    memset(&cabecalhoDiario, 0, sizeof(cabecalhoDiario));
+    memcpy(cabecalhoDiario.assinatura, ASSINATURA_DIARIO, 4);
+    cabecalhoDiario.versao = VERSAO_SALVAMENTO;
+    cabecalhoDiario.impressaoMansao = salvamento->impressaoMansao;
+    fwrite(&cabecalhoDiario, sizeof(cabecalhoDiario), 1, salvamento->diario);
+    if (!sincronizarArquivo(salvamento->diario, 1)) {
+        printf("Erro: Falha ao escrever o arquivo %s.\n", salvamento->caminhoDiario);
+        return 0;
+    }
+
+    salvamento->acoesNoInstantaneo = salvamento->acoes;
+    // O instantaneo guarda so a versao atual do caderno: desfazer nao
+    // atravessa um salvamento, ao vivo ou ao reler o diario
+    limparHistoricoCaderno(&sessao->caderno);
+    return 1;
+}
+
+void registrarAcao(Sessao* sessao, uint32_t sala) {
+    Salvamento* salvamento = sessao->salvamento;
+    if (salvamento == NULL) {
+        return;
+    }
+
+    // fflush por acao: o registro sobrevive a queda do processo. Sincronizar
+    // cada tecla com o disco custaria milissegundos; isso fica para o
+    // instantaneo, a cada INTERVALO_INSTANTANEO acoes
+    RegistroDiario registro = {(uint32_t)salvamento->acoes, sala};
+    salvamento->acoes++;
+    if (salvamento->diario != NULL) {
+        fwrite(&registro, sizeof(registro), 1, salvamento->diario);
+        fflush(salvamento->diario);
+    }
+    if (salvamento->acoes - salvamento->acoesNoInstantaneo >= INTERVALO_INSTANTANEO) {
+        gravarInstantaneo(sessao);
+    }
+}
+
+int restaurarInstantaneo(Sessao* sessao, const unsigned char* dados, size_t tamanho) {
+    const CabecalhoInstantaneo* cabecalho = (const CabecalhoInstantaneo*)dados;
+    size_t palavras = ((size_t)sessao->visitas.numSalas + 63) / 64;
+    if (tamanho < sizeof(CabecalhoInstantaneo) ||
+        memcmp(cabecalho->assinatura, ASSINATURA_INSTANTANEO, 4) != 0 || cabecalho->versao != VERSAO_SALVAMENTO ||
+        cabecalho->impressaoMansao != sessao->salvamento->impressaoMansao ||
+        cabecalho->numSalas != sessao->visitas.numSalas || cabecalho->salaAtual >= cabecalho->numSalas ||
+        cabecalho->salasVisitadas > cabecalho->numSalas ||
+        tamanho != sizeof(CabecalhoInstantaneo) + palavras * 2 * sizeof(uint64_t) + (size_t)cabecalho->numPistas * sizeof(uint32_t)) {
+        return 0;
+    }
+
+    const unsigned char* secao = dados + sizeof(CabecalhoInstantaneo);
+    memcpy(sessao->visitas.bits, secao, palavras * sizeof(uint64_t));
+    memcpy(sessao->visitas.pistasColetadas, secao + palavras * sizeof(uint64_t), palavras * sizeof(uint64_t));
+    sessao->visitas.salasVisitadas = cabecalho->salasVisitadas;
+    sessao->salaAtual = cabecalho->salaAtual;
+
+    // Ids em ordem crescente, como saem do caderno: a arvore e montada
+    // inteira de uma vez. A copia garante o alinhamento dos ids.
+    uint32_t* ids = (uint32_t*)alocarNaArena(sessao->arena, (size_t)cabecalho->numPistas * sizeof(uint32_t));
+    memcpy(ids, secao + palavras * 2 * sizeof(uint64_t), (size_t)cabecalho->numPistas * sizeof(uint32_t));
+    if (!carregarPistasNoCaderno(sessao->arena, &sessao->caderno, ids, cabecalho->numPistas)) {
+        return 0;
+    }
+
+    sessao->salvamento->acoes = cabecalho->acoes;
+    sessao->salvamento->acoesNoInstantaneo = cabecalho->acoes;
+    return 1;
+}
+
+int aplicarMovimento(Sessao* sessao, uint32_t sala) {
+    const Mansao* mansao = sessao->mansao;
+    if (sessao->visitas.salasVisitadas == 0) {
+        // Diario sem instantaneo: primeiro o inicio no Hall
+        marcarSalaComoVisitada(&sessao->visitas, SALA_HALL);
+        if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, SALA_HALL)) {
+            anotarPistaDaSala(sessao, SALA_HALL);
+        }
+    }
+
+    if (sala == SEM_SALA) {
+        uint32_t salaDesfeita;
+        return desfazerPistaDaSessao(sessao, &salaDesfeita);
+    }
+
+    // Mesmas regras de processarNavegacaoComPistas, sem texto
+    const Saida* saidas = saidasDaSala(mansao, sessao->cache, sessao->salaAtual);
+    uint32_t grau = grauDaSala(mansao, sessao->cache, sessao->salaAtual);
+    uint32_t k = 0;
+    while (k < grau && saidas[k].destino != sala) {
+        k++;
+    }
+    if (k == grau) {
+        return 0;
+    }
+    marcarSalaComoVisitada(&sessao->visitas, sala);
+    if (salaTemPistaPendente(mansao, sessao->cache, &sessao->visitas, sala)) {
+        anotarPistaDaSala(sessao, sala);
+    }
+    sessao->salaAtual = sala;
+    if (verificarFimDoCaminho(mansao, sessao->cache, sala)) {
+        voltarAoHall(sessao, 0);
+    }
+    return 1;
+}
+
+int retomarSessao(Sessao* sessao, FILE* relatorio) {
+    Salvamento* salvamento = sessao->salvamento;
+    uint64_t inicio = agoraNanos();
+
+    FILE* existe = fopen(salvamento->caminhoInstantaneo, "rb");
+    if (existe != NULL) {
+        fclose(existe);
+        size_t tamanho = 0;
+        void* dados = mapearArquivo(salvamento->caminhoInstantaneo, &tamanho);
+        if (dados == NULL) {
+            return 0;
+        }
+        int valido = restaurarInstantaneo(sessao, (const unsigned char*)dados, tamanho);
+        desmapearArquivo(dados, tamanho);
+        if (!valido) {
+            printf("Erro: Salvamento invalido ou de outra mansao: %s.\n", salvamento->caminhoInstantaneo);
+            return 0;
+        }
+    }
+    uint64_t acoesNoInstantaneo = salvamento->acoes;
+
+    // Cauda do diario: para no primeiro registro cortado, fora de
+    // sequencia ou que nao seja um caminho a partir da sala atual
+    long relidas = 0;
+    FILE* diario = fopen(salvamento->caminhoDiario, "rb");
+    if (diario != NULL) {
+        CabecalhoDiario cabecalho;
+        if (fread(&cabecalho, sizeof(cabecalho), 1, diario) == 1 &&
+            memcmp(cabecalho.assinatura, ASSINATURA_DIARIO, 4) == 0 && cabecalho.versao == VERSAO_SALVAMENTO) {
+            if (cabecalho.impressaoMansao != salvamento->impressaoMansao) {
+                printf("Erro: Salvamento invalido ou de outra mansao: %s.\n", salvamento->caminhoDiario);
+                fclose(diario);
+                return 0;
+            }
+            RegistroDiario registro;
+            while (fread(&registro, sizeof(registro), 1, diario) == 1) {
+                if (registro.sequencia < (uint32_t)acoesNoInstantaneo) {
+                    continue; // ja incluido no instantaneo
+                }
+                if (registro.sequencia != (uint32_t)salvamento->acoes || !aplicarMovimento(sessao, registro.sala)) {
+                    break;
+                }
+                salvamento->acoes++;
+                relidas++;
+            }
+        }
+        fclose(diario);
+    }
+
+    // Novo instantaneo: compacta o que foi relido e abre o diario limpo
+    if (!gravarInstantaneo(sessao)) {
+        return 0;
+    }
+    if (relatorio != NULL) {
+        fprintf(relatorio, "retomada: acoes_instantaneo=%llu acoes_diario=%ld ms=%.3f\n",
+                (unsigned long long)acoesNoInstantaneo, relidas, (double)(agoraNanos() - inicio) / 1e6);
+    }
+    return 1;
+}
+
+// --- Instrumentacao
+//
+// Desligada, cada ponto medido custa um teste de ponteiro NULL. Ligada,
+// o JSON e montado num buffer fixo so com chamadas seguras dentro de um
+// tratador de sinal, entao o mesmo codigo atende finalizarJogo e SIGUSR1.
+
+// Unico estado global: o tratador de sinal nao recebe parametros
+static _Atomic(const Sessao*) sessaoInstrumentada = NULL;
+
+void iniciarEstatisticas(Estatisticas* estatisticas, const char* destino, const Arena* arenaPrincipal) {
+    memset(estatisticas, 0, sizeof(Estatisticas));
+    estatisticas->destino = destino;
+    estatisticas->arenaPrincipal = arenaPrincipal;
+}
+
+void registrarSondagens(Estatisticas* estatisticas, uint64_t sondagens) {
+    estatisticas->consultasHash++;
+    estatisticas->sondagensHash += sondagens;
+    if (sondagens > estatisticas->maiorSondagem) {
+        estatisticas->maiorSondagem = sondagens;
+    }
+    estatisticas->faixasSondagem[sondagens < NUM_FAIXAS_SONDAGEM ? sondagens - 1 : NUM_FAIXAS_SONDAGEM - 1]++;
+}
+
+TipoAcao tipoDaAcao(const char* comando) {
+    if (isdigit((unsigned char)comando[0])) {
+        return ACAO_PASSAGEM;
+    }
+    switch (comando[0]) {
+        case 'e':
+        case 'E':
+            return ACAO_ESQUERDA;
+        case 'd':
+        case 'D':
+            return ACAO_DIREITA;
+        case 's':
+        case 'S':
+            return ACAO_SAIR;
+        case 'b':
+        case 'B':
+            return ACAO_BUSCA;
+        case 'u':
+        case 'U':
+            return ACAO_DESFAZER;
+        default:
+            return ACAO_INVALIDA;
+    }
+}
+
+void registrarLatenciaAcao(Estatisticas* estatisticas, TipoAcao tipo, uint64_t nanos) {
+    HistogramaLatencia* histograma = &estatisticas->acoes[tipo];
+    int faixa = 0;
+    while (faixa < NUM_FAIXAS_LATENCIA - 1 && (nanos >> (faixa + 1)) != 0) {
+        faixa++;
+    }
+    histograma->contagem++;
+    histograma->totalNanos += nanos;
+    if (nanos > histograma->maximoNanos) {
+        histograma->maximoNanos = nanos;
+    }
+    histograma->faixas[faixa]++;
+}
+
+void medirAglomeradosHash(const TabelaHash* tabela, uint64_t* maiorAglomerado, uint64_t* sondagensChaves) {
+    // A carga fica abaixo de 70%: comecando numa posicao vazia, nenhum
+    // aglomerado da volta no fim do vetor sem ser contado
+    size_t mascara = tabela->capacidade - 1;
+    size_t inicio = 0;
+    while (tabela->entradas[inicio].hash != 0) {
+        inicio++;
+    }
+
+    uint64_t aglomerado = 0;
+    *maiorAglomerado = 0;
+    *sondagensChaves = 0;
+    for (size_t passo = 1; passo <= tabela->capacidade; passo++) {
+        size_t indice = (inicio + passo) & mascara;
+        const HashNode* entrada = &tabela->entradas[indice];
+        if (entrada->hash == 0) {
+            aglomerado = 0;
+            continue;
+        }
+        aglomerado++;
+        if (aglomerado > *maiorAglomerado) {
+            *maiorAglomerado = aglomerado;
+        }
+        *sondagensChaves += ((indice - posicaoInicialHash(tabela, entrada->hash)) & mascara) + 1;
+    }
+}
+
+void anexarJson(SaidaJson* saida, const char* texto) {
+    while (*texto != '\0' && saida->tamanho < sizeof(saida->dados)) {
+        saida->dados[saida->tamanho++] = *texto++;
+    }
+}
+
+void anexarNumeroJson(SaidaJson* saida, uint64_t numero) {
+    // Sem snprintf: precisa rodar dentro do tratador de sinal
+    char digitos[24];
+    int quantidade = 0;
+    do {
+        digitos[quantidade++] = (char)('0' + numero % 10);
+        numero /= 10;
+    } while (numero != 0);
+    while (quantidade > 0 && saida->tamanho < sizeof(saida->dados)) {
+        saida->dados[saida->tamanho++] = digitos[--quantidade];
+    }
+}
+
+void anexarCampoJson(SaidaJson* saida, const char* nome, uint64_t valor, int ultimo) {
+    anexarJson(saida, "\"");
+    anexarJson(saida, nome);
+    anexarJson(saida, "\": ");
+    anexarNumeroJson(saida, valor);
+    anexarJson(saida, ultimo ? "" : ", ");
+}
+
+void montarEstatisticasJson(const Sessao* sessao, SaidaJson* saida) {
+    static const char* const nomesAcoes[NUM_TIPOS_ACAO] = {"esquerda", "direita", "passagem", "sair", "busca", "desfazer", "invalida"};
+    const Estatisticas* estatisticas = sessao->estatisticas;
+    const TabelaHash* tabela = sessao->tabelaHash;
+
+    uint64_t maiorAglomerado;
+    uint64_t sondagensChaves;
+    medirAglomeradosHash(tabela, &maiorAglomerado, &sondagensChaves);
+
+    anexarJson(saida, "{\n  \"hash\": {");
+    anexarCampoJson(saida, "capacidade", tabela->capacidade, 0);
+    anexarCampoJson(saida, "entradas", tabela->quantidade, 0);
+    anexarCampoJson(saida, "maior_aglomerado", maiorAglomerado, 0);
+    anexarCampoJson(saida, "sondagens_todas_chaves", sondagensChaves, 0);
+    anexarCampoJson(saida, "consultas", estatisticas->consultasHash, 0);
+    anexarCampoJson(saida, "sondagens", estatisticas->sondagensHash, 0);
+    anexarCampoJson(saida, "maior_sondagem", estatisticas->maiorSondagem, 0);
+    anexarJson(saida, "\"histograma_sondagens\": [");
+    for (int i = 0; i < NUM_FAIXAS_SONDAGEM; i++) {
+        anexarNumeroJson(saida, estatisticas->faixasSondagem[i]);
+        anexarJson(saida, i + 1 < NUM_FAIXAS_SONDAGEM ? ", " : "]},\n");
+    }
+
+    anexarJson(saida, "  \"caderno\": {");
+    anexarCampoJson(saida, "nos", (uint64_t)sessao->caderno.totalPistas, 0);
+    anexarCampoJson(saida, "altura", (uint64_t)alturaPista(sessao->caderno.raiz), 1);
+    anexarJson(saida, "},\n");
+
+    // As funcoes criar* alocam nas arenas: os mallocs reais sao os blocos
+    anexarJson(saida, "  \"alocacoes\": {\"arena_principal\": {");
+    anexarCampoJson(saida, "pedidos", estatisticas->arenaPrincipal->alocacoes, 0);
+    anexarCampoJson(saida, "mallocs", estatisticas->arenaPrincipal->blocosAlocados, 1);
+    anexarJson(saida, "}, \"arena_sessao\": {");
+    anexarCampoJson(saida, "pedidos", sessao->arena->alocacoes, 0);
+    anexarCampoJson(saida, "mallocs", sessao->arena->blocosAlocados, 1);
+    anexarJson(saida, "}},\n");
+
+    anexarJson(saida, "  \"acoes\": {");
+    for (int tipo = 0; tipo < NUM_TIPOS_ACAO; tipo++) {
+        const HistogramaLatencia* histograma = &estatisticas->acoes[tipo];
+        anexarJson(saida, "\n    \"");
+        anexarJson(saida, nomesAcoes[tipo]);
+        anexarJson(saida, "\": {");
+        anexarCampoJson(saida, "contagem", histograma->contagem, 0);
+        anexarCampoJson(saida, "total_ns", histograma->totalNanos, 0);
+        anexarCampoJson(saida, "maximo_ns", histograma->maximoNanos, 0);
+        // So as faixas ocupadas; "ate_ns" e o limite superior da faixa
+        anexarJson(saida, "\"histograma\": [");
+        int primeira = 1;
+        for (int faixa = 0; faixa < NUM_FAIXAS_LATENCIA; faixa++) {
+            if (histograma->faixas[faixa] == 0) {
+                continue;
+            }
+            anexarJson(saida, primeira ? "{" : ", {");
+            anexarCampoJson(saida, "ate_ns", ((uint64_t)2 << faixa) - 1, 0);
+            anexarCampoJson(saida, "contagem", histograma->faixas[faixa], 1);
+            anexarJson(saida, "}");
+            primeira = 0;
+        }
+        anexarJson(saida, tipo + 1 < NUM_TIPOS_ACAO ? "]}," : "]}");
+    }
+    anexarJson(saida, "\n  }\n}\n");
+}
+
+void despejarEstatisticas(const Sessao* sessao) {
+    SaidaJson saida;
+    saida.tamanho = 0;
+    montarEstatisticasJson(sessao, &saida);
+    const char* destino = sessao->estatisticas->destino;
+
+#ifdef _WIN32
+    FILE* arquivo = strcmp(destino, "-") == 0 ? stderr : fopen(destino, "wb");
+    if (arquivo != NULL) {
+        fwrite(saida.dados, 1, saida.tamanho, arquivo);
+        if (arquivo != stderr) {
+            fclose(arquivo);
+        }
+    }
+#else
+    // open/write/close sao seguras dentro de um tratador de sinal
+    int descritor = strcmp(destino, "-") == 0 ? STDERR_FILENO : open(destino, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descritor < 0) {
+        return;
+    }
+    size_t escrito = 0;
+    while (escrito < saida.tamanho) {
+        ssize_t parte = write(descritor, saida.dados + escrito, saida.tamanho - escrito);
+        if (parte < 0 && errno == EINTR) {
+            continue;
+        }
+        if (parte <= 0) {
+            break;
+        }
+        escrito += (size_t)parte;
+    }
+    if (descritor != STDERR_FILENO) {
+        close(descritor);
+    }
+#endif
+}
+
+#ifndef _WIN32
+void tratarSinalEstatisticas(int sinal) {
+    (void)sinal;
+    int errnoSalvo = errno;
+    const Sessao* sessao = atomic_load(&sessaoInstrumentada);
+    if (sessao != NULL) {
+        despejarEstatisticas(sessao);
+    }
+    errno = errnoSalvo;
+}
+#endif
+
+void instrumentarSessao(Sessao* sessao, Estatisticas* estatisticas) {
+    sessao->estatisticas = estatisticas;
+    atomic_store(&sessaoInstrumentada, sessao);
+
+#ifndef _WIN32
+    // SA_RESTART: a leitura da entrada continua depois do despejo
+    struct sigaction acao;
+    memset(&acao, 0, sizeof(acao));
+    acao.sa_handler = tratarSinalEstatisticas;
+    sigemptyset(&acao.sa_mask);
+    acao.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &acao, NULL);
+#endif
+}
+
+void encerrarInstrumentacao(Sessao* sessao) {
+    // Antes de liberar a arena da sessao: o sinal nao pode ler o caderno depois
+    atomic_store(&sessaoInstrumentada, NULL);
+    despejarEstatisticas(sessao);
+}
+
+// --- Eventos
+//
+// Cada thread de jogo publica no proprio anel e segue em frente; uma
+// thread gravadora esvazia os aneis em lotes e so ela toca no arquivo.
+// Com o anel cheio o evento e descartado e contado: o jogo nunca espera.
+
+const char* nomeTipoEvento(TipoEvento tipo) {
+    static const char* const nomes[NUM_TIPOS_EVENTO] = {"sala", "pista", "revisita", "acusacao", "fim"};
+    return tipo < NUM_TIPOS_EVENTO ? nomes[tipo] : "?";
+}
+
+int abrirFluxoEventos(FluxoEventos* fluxo, Arena* arena, const char* caminho, int numAneis) {
+    fluxo->arquivo = fopen(caminho, "wb");
+    if (fluxo->arquivo == NULL) {
+        printf("Erro: Nao foi possivel criar o arquivo %s.\n", caminho);
+        return 0;
+    }
+    fluxo->caminho = caminho;
+    fluxo->buffer = (char*)alocarNaArena(arena, TAMANHO_BUFFER_EVENTOS);
+    setvbuf(fluxo->arquivo, fluxo->buffer, _IOFBF, TAMANHO_BUFFER_EVENTOS);
+    fluxo->gravados = 0;
+    fluxo->falhou = 0;
+    atomic_init(&fluxo->encerrar, 0);
+
+    CabecalhoEventos cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.assinatura, ASSINATURA_EVENTOS, 4);
+    cabecalho.versao = VERSAO_EVENTOS;
+    cabecalho.tamanhoEvento = sizeof(Evento);
+    cabecalho.numAneis = (uint32_t)numAneis;
+    fwrite(&cabecalho, sizeof(cabecalho), 1, fluxo->arquivo);
+
+    fluxo->numAneis = numAneis;
+    fluxo->aneis = (AnelEventos*)alocarAlinhadoNaArena(arena, (size_t)numAneis * sizeof(AnelEventos), LINHA_DE_CACHE);
+    for (int i = 0; i < numAneis; i++) {
+        AnelEventos* anel = &fluxo->aneis[i];
+        anel->eventos = (Evento*)alocarAlinhadoNaArena(arena, CAPACIDADE_ANEL_EVENTOS * sizeof(Evento), LINHA_DE_CACHE);
+        anel->mascara = CAPACIDADE_ANEL_EVENTOS - 1;
+        atomic_init(&anel->cabeca, 0);
+        anel->caudaVista = 0;
+        atomic_init(&anel->perdidos, 0);
+        atomic_init(&anel->cauda, 0);
+    }
+
+#ifndef _WIN32
+    // Sem a thread os eventos esperam no anel ate o fechamento
+    fluxo->gravadorAtivo = pthread_create(&fluxo->gravador, NULL, gravadorEventos, fluxo) == 0;
+#endif
+    return 1;
+}
+
+void publicarEvento(AnelEventos* anel, const Evento* evento) {
+    // A cauda do gravador so e relida quando a copia local diz que o anel
+    // encheu: no caso comum a publicacao nao toca na linha do consumidor
+    size_t cabeca = atomic_load_explicit(&anel->cabeca, memory_order_relaxed);
+    if (cabeca - anel->caudaVista > anel->mascara) {
+        anel->caudaVista = atomic_load_explicit(&anel->cauda, memory_order_acquire);
+        if (cabeca - anel->caudaVista > anel->mascara) {
+            atomic_store_explicit(&anel->perdidos, atomic_load_explicit(&anel->perdidos, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return;
+        }
+    }
+    anel->eventos[cabeca & anel->mascara] = *evento;
+    atomic_store_explicit(&anel->cabeca, cabeca + 1, memory_order_release);
+}
+
+void registrarEvento(Sessao* sessao, TipoEvento tipo, uint32_t sala, uint32_t valor, int suspeito, int detalhe) {
+    if (sessao->eventos == NULL) {
+        return;
+    }
+    Evento evento;
+    evento.tipo = (uint8_t)tipo;
+    evento.detalhe = (uint8_t)detalhe;
+    evento.suspeito = suspeito >= 0 && suspeito < SEM_SUSPEITO_EVENTO ? (uint16_t)suspeito : SEM_SUSPEITO_EVENTO;
+    evento.sessao = sessao->numero;
+    evento.sala = sala;
+    evento.valor = valor;
+    publicarEvento(sessao->eventos, &evento);
+}
+
+size_t drenarAnelEventos(FluxoEventos* fluxo, AnelEventos* anel) {
+    // Tudo o que foi publicado ate aqui, em no maximo duas fatias
+    // contiguas: do ponto atual ao fim do vetor e o que deu a volta
+    size_t cauda = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+    size_t cabeca = atomic_load_explicit(&anel->cabeca, memory_order_acquire);
+    size_t total = cabeca - cauda;
+    while (cauda != cabeca) {
+        size_t inicio = cauda & anel->mascara;
+        size_t fatia = anel->mascara + 1 - inicio;
+        if (fatia > cabeca - cauda) {
+            fatia = cabeca - cauda;
+        }
+        if (!fluxo->falhou && fwrite(&anel->eventos[inicio], sizeof(Evento), fatia, fluxo->arquivo) != fatia) {
+            fluxo->falhou = 1; // o anel continua sendo esvaziado
+        }
+        cauda += fatia;
+    }
+    atomic_store_explicit(&anel->cauda, cauda, memory_order_release);
+    fluxo->gravados += total;
+    return total;
+}
+
+size_t drenarFluxoEventos(FluxoEventos* fluxo) {
+    size_t total = 0;
+    for (int i = 0; i < fluxo->numAneis; i++) {
+        total += drenarAnelEventos(fluxo, &fluxo->aneis[i]);
+    }
+    return total;
+}
+
+void* gravadorEventos(void* argumento) {
+    FluxoEventos* fluxo = (FluxoEventos*)argumento;
+    for (;;) {
+        // Lido antes de esvaziar: depois do aviso nenhum produtor publica,
+        // entao uma volta vazia com o aviso dado encerra o gravador
+        int encerrando = atomic_load_explicit(&fluxo->encerrar, memory_order_acquire);
+        if (drenarFluxoEventos(fluxo) > 0) {
+            continue;
+        }
+        if (encerrando) {
+            break;
+        }
+        fflush(fluxo->arquivo); // ocioso: o lote parcial vai para o disco
+#ifndef _WIN32
+        struct timespec pausa = {0, PAUSA_GRAVADOR_EVENTOS};
+        nanosleep(&pausa, NULL);
+#endif
+    }
+    return NULL;
+}
+
+int fecharFluxoEventos(FluxoEventos* fluxo, FILE* relatorio) {
+    // Chamado depois que todas as threads de jogo terminaram
+    atomic_store_explicit(&fluxo->encerrar, 1, memory_order_release);
+#ifndef _WIN32
+    if (fluxo->gravadorAtivo) {
+        pthread_join(fluxo->gravador, NULL);
+    }
+#endif
+    drenarFluxoEventos(fluxo);
+
+    uint64_t perdidos = 0;
+    for (int i = 0; i < fluxo->numAneis; i++) {
+        perdidos += atomic_load_explicit(&fluxo->aneis[i].perdidos, memory_order_relaxed);
+    }
+    int sucesso = !fluxo->falhou && !ferror(fluxo->arquivo);
+    if (fclose(fluxo->arquivo) != 0 || !sucesso) {
+        printf("Erro: Falha ao escrever o arquivo %s.\n", fluxo->caminho);
+        sucesso = 0;
+    }
+    if (relatorio != NULL) {
+        fprintf(relatorio, "eventos=%llu perdidos=%llu aneis=%d\n", (unsigned long long)fluxo->gravados,
+                (unsigned long long)perdidos, fluxo->numAneis);
+    }
+    return sucesso;
+}
+
+int exibirLogEventos(const char* caminho) {
+    // Um evento por linha, separado por tabulacoes como a transcricao
+    size_t tamanho = 0;
+    void* dados = mapearArquivo(caminho, &tamanho);
+    if (dados == NULL) {
+        return 0;
+    }
+    const CabecalhoEventos* cabecalho = (const CabecalhoEventos*)dados;
+    if (tamanho < sizeof(CabecalhoEventos) || memcmp(cabecalho->assinatura, ASSINATURA_EVENTOS, 4) != 0 ||
+        cabecalho->versao != VERSAO_EVENTOS || cabecalho->tamanhoEvento != sizeof(Evento) ||
+        (tamanho - sizeof(CabecalhoEventos)) % sizeof(Evento) != 0) {
+        printf("Erro: Log de eventos invalido: %s.\n", caminho);
+        desmapearArquivo(dados, tamanho);
+        return 0;
+    }
+
+    const Evento* eventos = (const Evento*)((const unsigned char*)dados + sizeof(CabecalhoEventos));
+    size_t numEventos = (tamanho - sizeof(CabecalhoEventos)) / sizeof(Evento);
+    printf("sessao\ttipo\tsala\tvalor\tsuspeito\tdetalhe\n");
+    for (size_t i = 0; i < numEventos; i++) {
+        const Evento* evento = &eventos[i];
+        printf("%u\t%s\t", evento->sessao, nomeTipoEvento((TipoEvento)evento->tipo));
+        if (evento->sala != SEM_SALA) {
+            printf("%u", evento->sala);
+        } else {
+            printf("-");
+        }
+        // SEM_SALA e SEM_PISTA sao o mesmo valor: ausencia em qualquer campo
+        if (evento->valor != SEM_SALA) {
+            printf("\t%u\t", evento->valor);
+        } else {
+            printf("\t-\t");
+        }
+        if (evento->suspeito != SEM_SUSPEITO_EVENTO) {
+            printf("%u", evento->suspeito);
+        } else {
+            printf("-");
+        }
+        printf("\t%u\n", evento->detalhe);
+    }
+    desmapearArquivo(dados, tamanho);
+    return 1;
+}
+
+// --- Benchmark
+
+uint64_t agoraNanos() {
+    struct timespec instante;
+    timespec_get(&instante, TIME_UTC);
+    return (uint64_t)instante.tv_sec * 1000000000u + (uint64_t)instante.tv_nsec;
+}
+
+uint32_t proximoAleatorio(uint32_t* estado) {
+    // xorshift32: barato e suficiente para embaralhar as consultas
+    uint32_t x = *estado;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *estado = x;
+    return x;
+}
+
+void executarBenchmarkHash() {
+    const size_t tamanhos[] = {22, 1000, 10000, 100000, 1000000};
+    const size_t NUM_TAMANHOS = sizeof(tamanhos) / sizeof(tamanhos[0]);
+    const size_t CONSULTAS = 2000000;
+    const size_t CHAVES_AUSENTES = 4096;
+    
+    printf("entradas,capacidade,ns_insercao,ns_insercao_lote,ns_consulta_acerto,ns_consulta_falha\n");
+    
+    for (size_t t = 0; t < NUM_TAMANHOS; t++) {
+        size_t entradas = tamanhos[t];
+        Arena arena;
+        inicializarArena(&arena);
+        
+        char (*chaves)[40] = alocarNaArena(&arena, entradas * sizeof(*chaves));
+        char (*ausentes)[40] = alocarNaArena(&arena, CHAVES_AUSENTES * sizeof(*ausentes));
+        for (size_t i = 0; i < entradas; i++) {
+            snprintf(chaves[i], sizeof(chaves[i]), "Pista sintetica %zu", i);
+        }
+        for (size_t i = 0; i < CHAVES_AUSENTES; i++) {
+            snprintf(ausentes[i], sizeof(ausentes[i]), "Pista ausente %zu", i);
+        }
+        
+        TabelaHash* tabela = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+        uint64_t inicio = agoraNanos();
+        for (size_t i = 0; i < entradas; i++) {
+            inserirNaHash(tabela, chaves[i], "Suspeito");
+        }
+        uint64_t nsInsercao = agoraNanos() - inicio;
+        
+        // As mesmas chaves numa tabela nova, internadas de uma vez
+        const char** textos = (const char**)alocarNaArena(&arena, entradas * sizeof(char*));
+        for (size_t i = 0; i < entradas; i++) {
+            textos[i] = chaves[i];
+        }
+        TabelaHash* tabelaLote = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+        inicio = agoraNanos();
+        internarPistasEmLote(tabelaLote, textos, (uint32_t)entradas);
+        uint64_t nsLote = agoraNanos() - inicio;
+        
+        // Soma volatil impede que o compilador descarte as consultas
+        volatile size_t verificacao = 0;
+        uint32_t estado = 2463534242u;
+        
+        inicio = agoraNanos();
+        for (size_t i = 0; i < CONSULTAS; i++) {
+            size_t indice = proximoAleatorio(&estado) % entradas;
+            verificacao += (size_t)encontrarSuspeito(tabela, chaves[indice])[0];
+        }
+        uint64_t nsAcerto = agoraNanos() - inicio;
+        
+        inicio = agoraNanos();
+        for (size_t i = 0; i < CONSULTAS; i++) {
+            size_t indice = proximoAleatorio(&estado) % CHAVES_AUSENTES;
+            verificacao += (size_t)encontrarSuspeito(tabela, ausentes[indice])[0];
+        }
+        uint64_t nsFalha = agoraNanos() - inicio;
+        
+        printf("%zu,%zu,%.1f,%.1f,%.1f,%.1f\n", entradas, tabela->capacidade,
+               (double)nsInsercao / (double)entradas,
+               (double)nsLote / (double)entradas,
+               (double)nsAcerto / (double)CONSULTAS,
+               (double)nsFalha / (double)CONSULTAS);
+        
+        liberarArena(&arena);
+    }
+}
+
+// Maior altura possivel de uma AVL com numNos nos: a arvore mais esparsa de
+// altura h tem N(h) = N(h-1) + N(h-2) + 1 nos, limite que fica abaixo de
+// 1.44 * log2(numNos)
+int alturaMaximaAvl(uint32_t numNos) {
+    uint64_t anterior = 0;
+    uint64_t atual = 1;
+    int altura = 1;
+    while (anterior + atual + 1 <= numNos) {
+        uint64_t proximo = anterior + atual + 1;
+        anterior = atual;
+        atual = proximo;
+        altura++;
+    }
+    return numNos > 0 ? altura : 0;
+}
+
+int executarBenchmarkPistasOrdenadas() {
+    const int TOTAL = 1000000;
+    Arena arena;
+    inicializarArena(&arena);
+    
+    // Internadas fora da medicao, como na carga do jogo
+    char pista[100];
+    TabelaHash* tabela = criarTabelaHash(&arena, (size_t)TOTAL * CARGA_MAXIMA_HASH_DEN / CARGA_MAXIMA_HASH_NUM + 1);
+    for (int i = 0; i < TOTAL; i++) {
+        snprintf(pista, sizeof(pista), "Pista %07d", i);
+        internarPista(tabela, copiarTextoNaArena(&arena, pista));
+    }
+    ordenarPistasInternadas(tabela);
+    
+    // Entrada ja ordenada: o pior caso da BST sem balanceamento
+    PistaNode* raiz = NULL;
+    PistaNode* livres = NULL;
+    uint64_t inicio = agoraNanos();
+    for (int i = 0; i < TOTAL; i++) {
+        snprintf(pista, sizeof(pista), "Pista %07d", i);
+        PistaNode* novaRaiz = inserirPista(&arena, &livres, raiz, buscarIdPista(tabela, pista));
+        soltarPista(&livres, raiz);
+        raiz = novaRaiz;
+    }
+    uint64_t nsInsercao = agoraNanos() - inicio;
+    
+    int encontradas = 0;
+    inicio = agoraNanos();
+    for (int i = 0; i < TOTAL; i++) {
+        snprintf(pista, sizeof(pista), "Pista %07d", i);
+        encontradas += buscarPista(raiz, buscarIdPista(tabela, pista)) != NULL;
+    }
+    uint64_t nsBusca = agoraNanos() - inicio;
+    
+    // A mesma sequencia montada de uma vez a partir do vetor ordenado
+    uint32_t* ids = (uint32_t*)alocarNaArena(&arena, (size_t)TOTAL * sizeof(uint32_t));
+    for (int i = 0; i < TOTAL; i++) {
+        ids[i] = (uint32_t)i;
+    }
+    inicio = agoraNanos();
+    PistaNode* raizLote = construirPistasOrdenadas(&arena, ids, (uint32_t)TOTAL);
+    uint64_t nsLote = agoraNanos() - inicio;
+    
+    printf("pistas,altura,altura_lote,encontradas,ns_insercao,ns_lote,ns_busca\n");
+    printf("%d,%d,%d,%d,%.1f,%.1f,%.1f\n", TOTAL, alturaPista(raiz), alturaPista(raizLote), encontradas,
+           (double)nsInsercao / TOTAL, (double)nsLote / TOTAL, (double)nsBusca / TOTAL);
+    
+    // Numeros de uma arvore errada nao valem nada: falha a execucao
+    int sucesso = 1;
+    if (encontradas != TOTAL) {
+        printf("Erro: %d de %d pistas encontradas.\n", encontradas, TOTAL);
+        sucesso = 0;
+    }
+    int alturaMaxima = alturaMaximaAvl((uint32_t)TOTAL);
+    if (alturaPista(raiz) > alturaMaxima || alturaPista(raizLote) > alturaMaxima) {
+        printf("Erro: Altura acima do limite AVL de %d.\n", alturaMaxima);
+        sucesso = 0;
+    }
+    
+    liberarArena(&arena);
+    return sucesso;
+}
+
+// --- Carga sintetica
+
+const char* nomeFormaMansao(FormaMansao forma) {
+    const char* const nomes[NUM_FORMAS_MANSAO] = {"balanceada", "degenerada", "aleatoria", "labirinto"};
+    return nomes[forma];
+}
+
+int lerFormaMansao(const char* texto, FormaMansao* forma) {
+    for (int i = 0; i < NUM_FORMAS_MANSAO; i++) {
+        if (strcmp(texto, nomeFormaMansao((FormaMansao)i)) == 0) {
+            *forma = (FormaMansao)i;
+            return 1;
+        }
+    }
+    printf("Erro: Forma de mansao desconhecida: %s (use balanceada, degenerada, aleatoria ou labirinto).\n", texto);
+    return 0;
+}
+
+void gerarMansaoSintetica(Arena* arena, Mansao* mansao, FormaMansao forma, uint32_t numSalas, uint32_t numPistas, uint32_t semente) {
+    char nome[16];
+    char pista[32];
+    char suspeito[32];
+
+    // Pistas e suspeitos cabem em 32 bytes, nomes de sala em 16; as salas
+    // reaproveitam o texto da pista do par em vez de copia-lo de novo
+    size_t capacidadeTextos = (size_t)numSalas * 16 + ((size_t)numPistas * 2 + 1) * sizeof(pista);
+    uint32_t numPassagens = forma == FORMA_LABIRINTO ? numSalas / 2 : 0;
+    ConstrutorMansao construtor;
+    iniciarConstrucaoMansao(&construtor, arena, numSalas, numSalas - 1 + numPassagens, numPistas, capacidadeTextos);
+
+    for (uint32_t i = 0; i < numPistas; i++) {
+        snprintf(pista, sizeof(pista), "Pista sintetica %u", i);
+        snprintf(suspeito, sizeof(suspeito), "Suspeito %u", i % NUM_SUSPEITOS_SINTETICOS);
+        adicionarParPista(&construtor, pista, suspeito, 1.0f);
+    }
+    construtor.culpado = guardarTextoNaMansao(&construtor, "Suspeito 0");
+
+    for (uint32_t i = 0; i < numSalas; i++) {
+        if (i == 0) {
+            snprintf(nome, sizeof(nome), "Hall de Entrada");
+        } else {
+            snprintf(nome, sizeof(nome), "Sala %u", i);
+        }
+        uint32_t sala = criarSala(&construtor, nome, "");
+        construtor.salas[sala].pista = numPistas > 0 ? construtor.pares[i % numPistas].pista : 0;
+    }
+
+    uint32_t estado = semente != 0 ? semente : 2463534242u;
+    if (forma == FORMA_BALANCEADA) {
+        // Heap implicito: filhos de i em 2i+1 e 2i+2
+        for (uint32_t i = 1; i < numSalas; i++) {
+            ligarSalas(&construtor, (i - 1) / 2, (i & 1) ? 'e' : 'd', i, 1);
+        }
+    } else if (forma == FORMA_DEGENERADA) {
+        // Corredor: cada sala so tem caminho a esquerda
+        for (uint32_t i = 0; i + 1 < numSalas; i++) {
+            ligarSalas(&construtor, i, 'e', i + 1, 1);
+        }
+    } else {
+        // Cada sala nova ocupa um caminho livre sorteado entre as ja criadas
+        uint32_t* livres = (uint32_t*)alocarNaArena(arena, ((size_t)numSalas * 2 + 2) * sizeof(uint32_t));
+        size_t numLivres = 0;
+        livres[numLivres++] = 0;
+        livres[numLivres++] = 1;
+        for (uint32_t i = 1; i < numSalas; i++) {
+            size_t escolhido = proximoAleatorio(&estado) % numLivres;
+            uint32_t caminho = livres[escolhido];
+            livres[escolhido] = livres[--numLivres];
+            ligarSalas(&construtor, caminho >> 1, (caminho & 1) ? 'd' : 'e', i, 1);
+            livres[numLivres++] = i * 2;
+            livres[numLivres++] = i * 2 + 1;
+        }
+    }
+
+    // Passagens entre salas quaisquer, inclusive de volta ao Hall
+    for (uint32_t i = 0; i < numPassagens; i++) {
+        uint32_t origem = proximoAleatorio(&estado) % numSalas;
+        uint32_t destino = proximoAleatorio(&estado) % numSalas;
+        ligarSalas(&construtor, origem, 0, destino, 1 + proximoAleatorio(&estado) % 8);
+    }
+
+    if (!concluirMansao(&construtor, mansao)) {
+        exit(1);
+    }
+}
+
+int escreverCenarioTexto(const Mansao* mansao, const char* caminho) {
+    FILE* arquivo = fopen(caminho, "w");
+    if (arquivo == NULL) {
+        printf("Erro: Nao foi possivel criar o arquivo %s.\n", caminho);
+        return 0;
+    }
+
+    fprintf(arquivo, "# Cenario gerado: %u salas, %u pistas\n\n", mansao->numSalas, mansao->numPares);
+    for (uint32_t i = 0; i < mansao->numSalas; i++) {
+        fprintf(arquivo, "SALA|%s|%s\n", nomeSala(mansao, NULL, i), pistaSala(mansao, NULL, i));
+    }
+    for (uint32_t i = 0; i < mansao->numSalas; i++) {
+        const Saida* saidas = saidasDaSala(mansao, NULL, i);
+        for (uint32_t k = 0; k < grauDaSala(mansao, NULL, i); k++) {
+            fprintf(arquivo, "LIGACAO|%u|%c|%u", i, saidas[k].tecla != 0 ? saidas[k].tecla : '-', saidas[k].destino);
+            if (saidas[k].custo != 1) {
+                fprintf(arquivo, "|%u", (unsigned)saidas[k].custo);
+            }
+            fprintf(arquivo, "\n");
+        }
+    }
+    for (uint32_t i = 0; i < mansao->numPares; i++) {
+        fprintf(arquivo, "PISTA|%s|%s", textoDaMansao(mansao, mansao->pares[i].pista),
+                textoDaMansao(mansao, mansao->pares[i].suspeito));
+        if (mansao->pares[i].peso != 1.0f) {
+            fprintf(arquivo, "|%.9g", (double)mansao->pares[i].peso); // 9 digitos reproduzem o float
+        }
+        fprintf(arquivo, "\n");
+    }
+    if (mansao->culpado != 0) {
+        fprintf(arquivo, "CULPADO|%s\n", textoDaMansao(mansao, mansao->culpado));
+    }
+
+    int sucesso = !ferror(arquivo);
+    if (fclose(arquivo) != 0 || !sucesso) {
+        printf("Erro: Falha ao escrever o arquivo %s.\n", caminho);
+        return 0;
+    }
+    return 1;
+}
+
+// --- Suite de benchmark
+
+// Campo em KB de /proc/self/status (VmRSS, VmHWM); 0 onde nao existe
+long lerMemoriaDoProcesso(const char* campo) {
+#ifdef _WIN32
+    (void)campo;
+    return 0;
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status == NULL) {
+        return 0;
+    }
+    size_t tamanhoCampo = strlen(campo);
+    char linha[128];
+    long valor = 0;
+    while (fgets(linha, sizeof(linha), status) != NULL) {
+        if (strncmp(linha, campo, tamanhoCampo) == 0 && linha[tamanhoCampo] == ':') {
+            valor = strtol(linha + tamanhoCampo + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(status);
+    return valor;
+#endif
+}
+
+// O pico do processo inteiro so cresce: cada caso zera o VmHWM (escrita
+// de 5 em clear_refs) e informa quanto subiu acima do residente inicial
+void marcarCasoBenchmark(MarcoBenchmark* marco, const Arena* arena) {
+    marco->arena = *arena;
+#ifndef _WIN32
+    FILE* limpar = fopen("/proc/self/clear_refs", "w");
+    if (limpar != NULL) {
+        fputs("5", limpar);
+        fclose(limpar);
+    }
+#endif
+    marco->rssKb = lerMemoriaDoProcesso("VmRSS");
+}
+
+void imprimirLinhaBenchmark(const char* caso, FormaMansao forma, uint32_t numSalas, uint32_t numPistas,
+                            size_t operacoes, uint64_t nanos, const Arena* arena, const MarcoBenchmark* antes) {
+    long pico = lerMemoriaDoProcesso("VmHWM") - antes->rssKb;
+    printf("%s,%s,%u,%u,%zu,%.1f,%zu,%zu,%ld\n", caso, nomeFormaMansao(forma), numSalas, numPistas, operacoes,
+           operacoes > 0 ? (double)nanos / (double)operacoes : 0.0,
+           arena->alocacoes - antes->arena.alocacoes, arena->blocosAlocados - antes->arena.blocosAlocados,
+           pico > 0 ? pico : 0);
+}
+
+void executarSuiteBenchmark(FormaMansao forma, uint32_t numSalas, uint32_t numPistas) {
+    const size_t CONSULTAS = 1000000;
+    const long SESSOES = 2000;
+    const int PASSOS_ROTEIRO = 64;
+
+    Arena arena;
+    inicializarArena(&arena);
+    MarcoBenchmark antes;
+    marcarCasoBenchmark(&antes, &arena);
+
+    Mansao mansao;
+    uint64_t inicio = agoraNanos();
+    gerarMansaoSintetica(&arena, &mansao, forma, numSalas, numPistas, 12345);
+    imprimirLinhaBenchmark("gerarMansaoSintetica", forma, numSalas, numPistas, numSalas, agoraNanos() - inicio, &arena, &antes);
+
+    // Passada inteira pelo grafo: so a parte quente, lida em sequencia
+    marcarCasoBenchmark(&antes, &arena);
+    inicio = agoraNanos();
+    int saidasValidas = validarSaidas(mansao.inicioSaidas, mansao.saidas, mansao.numSalas, mansao.numSaidas, mansao.arvore);
+    imprimirLinhaBenchmark("validarSaidas", forma, numSalas, numPistas, saidasValidas ? mansao.numSaidas : 0, agoraNanos() - inicio, &arena, &antes);
+
+    // O mesmo calculo da compilacao de um cenario: BFS ou Dijkstra
+    marcarCasoBenchmark(&antes, &arena);
+    inicio = agoraNanos();
+    calcularRumosAoHall(&arena, &mansao);
+    imprimirLinhaBenchmark("calcularRumosAoHall", forma, numSalas, numPistas, (size_t)mansao.numSalas + mansao.numSaidas, agoraNanos() - inicio, &arena, &antes);
+
+    // Carga em lote: a tabela se dimensiona uma vez para o total de pistas
+    marcarCasoBenchmark(&antes, &arena);
+    TabelaHash* tabela = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+    inicio = agoraNanos();
+    carregarPistasDaMansao(tabela, &mansao);
+    imprimirLinhaBenchmark("carregarPistasDaMansao", forma, numSalas, numPistas, (size_t)numPistas + numSalas, agoraNanos() - inicio, &arena, &antes);
+    internarPistasDaMansao(tabela, &mansao);
+
+    // Pistas na ordem em que as salas sao descobertas, nao na ordem do pool
+    uint32_t estado = 2463534242u;
+    marcarCasoBenchmark(&antes, &arena);
+    // Cada insercao e uma versao nova; a anterior e solta e seus nos
+    // voltam para a lista livre, como no caderno sem historico
+    PistaNode* raiz = NULL;
+    PistaNode* livres = NULL;
+    inicio = agoraNanos();
+    for (uint32_t i = 0; i < numPistas; i++) {
+        PistaNode* novaRaiz = inserirPista(&arena, &livres, raiz, proximoAleatorio(&estado) % numPistas);
+        soltarPista(&livres, raiz);
+        raiz = novaRaiz;
+    }
+    imprimirLinhaBenchmark("inserirPista", forma, numSalas, numPistas, numPistas, agoraNanos() - inicio, &arena, &antes);
+
+    // Mesmo caderno montado de uma vez, como ao retomar um salvamento
+    uint32_t* idsOrdenados = (uint32_t*)alocarNaArena(&arena, (size_t)numPistas * sizeof(uint32_t));
+    for (uint32_t i = 0; i < numPistas; i++) {
+        idsOrdenados[i] = i;
+    }
+    marcarCasoBenchmark(&antes, &arena);
+    inicio = agoraNanos();
+    PistaNode* raizLote = construirPistasOrdenadas(&arena, idsOrdenados, numPistas);
+    imprimirLinhaBenchmark("construirPistasOrdenadas", forma, numSalas, numPistas, numPistas, agoraNanos() - inicio, &arena, &antes);
+
+    // Soma volatil impede que o compilador descarte as consultas
+    volatile size_t verificacao = (size_t)alturaPista(raizLote);
+    if (numPistas > 0) {
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (size_t i = 0; i < CONSULTAS; i++) {
+            uint32_t par = proximoAleatorio(&estado) % numPistas;
+            verificacao += (size_t)encontrarSuspeito(tabela, textoDaMansao(&mansao, mansao.pares[par].pista))[0];
+        }
+        imprimirLinhaBenchmark("encontrarSuspeito", forma, numSalas, numPistas, CONSULTAS, agoraNanos() - inicio, &arena, &antes);
+    }
+
+    Caderno caderno;
+    inicializarCaderno(&caderno, &arena, tabela);
+    for (uint32_t i = 0; i < numPistas; i++) {
+        registrarPistaNoCaderno(&arena, &caderno, i, SEM_SALA);
+    }
+    if (tabela->numSuspeitos > 0) {
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (size_t i = 0; i < CONSULTAS; i++) {
+            const char* suspeito = tabela->suspeitos[i % (size_t)tabela->numSuspeitos];
+            verificacao += (size_t)pontuacaoDoSuspeito(&caderno, tabela, suspeito);
+        }
+        imprimirLinhaBenchmark("pontuacaoDoSuspeito", forma, numSalas, numPistas, CONSULTAS, agoraNanos() - inicio, &arena, &antes);
+
+        // Veredito: recalculo do caderno cheio e classificacao dos suspeitos
+        const int VEREDITOS = 200;
+        float* pontuacao = criarVetorPontuacao(&arena, tabela);
+        PosicaoSuspeito* classificacao =
+            (PosicaoSuspeito*)alocarNaArena(&arena, (size_t)tabela->numSuspeitos * sizeof(PosicaoSuspeito));
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (int i = 0; i < VEREDITOS; i++) {
+            pontuarCaderno(&caderno, pontuacao);
+            verificacao += (size_t)pontuacao[i % tabela->numSuspeitos];
+        }
+        imprimirLinhaBenchmark("pontuarCaderno", forma, numSalas, numPistas, (size_t)VEREDITOS * numPistas,
+                               agoraNanos() - inicio, &arena, &antes);
+
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (int i = 0; i < VEREDITOS; i++) {
+            classificarSuspeitos(pontuacao, tabela->numSuspeitos, classificacao);
+            verificacao += (size_t)classificacao[0].indice;
+        }
+        imprimirLinhaBenchmark("classificarSuspeitos", forma, numSalas, numPistas, (size_t)VEREDITOS,
+                               agoraNanos() - inicio, &arena, &antes);
+    }
+
+    // Busca no caderno cheio: um termo comum a todas as pistas e um numero
+    // que so algumas tem; o limite de resultados e o mesmo do jogo
+    if (numPistas > 0) {
+        const size_t BUSCAS = 100000;
+        char consultas[256][40];
+        char prefixos[256][8];
+        for (int i = 0; i < 256; i++) {
+            uint32_t numero = proximoAleatorio(&estado) % numPistas;
+            snprintf(consultas[i], sizeof(consultas[i]), "sintetica %u", numero);
+            snprintf(prefixos[i], sizeof(prefixos[i]), "%u", numero % 100);
+        }
+        uint32_t ids[MAX_RESULTADOS_BUSCA];
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (size_t i = 0; i < BUSCAS; i++) {
+            verificacao += (size_t)consultarIndiceBusca(&caderno.palavras, consultas[i & 255], ids, MAX_RESULTADOS_BUSCA);
+        }
+        imprimirLinhaBenchmark("consultarIndiceBusca", forma, numSalas, numPistas, BUSCAS, agoraNanos() - inicio, &arena, &antes);
+
+        SugestaoBusca sugestoes[MAX_SUGESTOES_BUSCA];
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        for (size_t i = 0; i < BUSCAS; i++) {
+            const char* prefixo = prefixos[i & 255];
+            verificacao += (size_t)completarPalavra(&caderno.palavras, prefixo, (uint32_t)strlen(prefixo), sugestoes, MAX_SUGESTOES_BUSCA);
+        }
+        imprimirLinhaBenchmark("completarPalavra", forma, numSalas, numPistas, BUSCAS, agoraNanos() - inicio, &arena, &antes);
+    }
+
+    // Cada consulta vem depois de uma marcacao, como no laco do jogo
+    RegistroVisitas visitas;
+    inicializarRegistroVisitas(&visitas, &arena, numSalas);
+    marcarCasoBenchmark(&antes, &arena);
+    inicio = agoraNanos();
+    for (size_t i = 0; i < CONSULTAS; i++) {
+        marcarSalaComoVisitada(&visitas, (uint32_t)(i % numSalas));
+        verificacao += (size_t)todasSalasVisitadas(&visitas);
+    }
+    imprimirLinhaBenchmark("todasSalasVisitadas", forma, numSalas, numPistas, CONSULTAS, agoraNanos() - inicio, &arena, &antes);
+
+    // Planejador de rotas em uma thread: uma operacao por sala; so em arvores
+    if (mansao.arvore) {
+        marcarCasoBenchmark(&antes, &arena);
+        inicio = agoraNanos();
+        PlanoRotas plano;
+        prepararPlanoRotas(&plano, &arena, &mansao, tabela, 1);
+        MelhoresRotas* melhores = calcularMelhoresRotas(&plano, &arena, 1);
+        imprimirLinhaBenchmark("calcularMelhoresRotas", forma, numSalas, numPistas, numSalas, agoraNanos() - inicio, &arena, &antes);
+        verificacao += tabela->numSuspeitos > 0 ? melhores[0].parcial[0].custo : 0;
+    }
+
+    // Sessao completa: passeio aleatorio, saida e acusacao do culpado
+    char* roteiro = (char*)alocarNaArena(&arena, (size_t)PASSOS_ROTEIRO * 2 + 64);
+    size_t tamanhoRoteiro = 0;
+    for (int i = 0; i < PASSOS_ROTEIRO; i++) {
+        roteiro[tamanhoRoteiro++] = (proximoAleatorio(&estado) & 1) ? 'd' : 'e';
+        roteiro[tamanhoRoteiro++] = '\n';
+    }
+    tamanhoRoteiro += (size_t)sprintf(roteiro + tamanhoRoteiro, "s\ns\nSuspeito 0\nn\n");
+
+    Arena arenaSessao;
+    inicializarArena(&arenaSessao);
+    marcarCasoBenchmark(&antes, &arenaSessao);
+    long condenacoes = 0;
+    inicio = agoraNanos();
+    for (long i = 0; i < SESSOES; i++) {
+        Terminal terminal;
+        iniciarTerminal(&terminal, roteiro, tamanhoRoteiro, 0, NULL, NULL);
+        Sessao sessao;
+        iniciarSessao(&sessao, &arenaSessao, &mansao, NULL, tabela, &terminal);
+        condenacoes += jogarSessao(&sessao);
+    }
+    verificacao += (size_t)condenacoes;
+    imprimirLinhaBenchmark("sessao", forma, numSalas, numPistas, (size_t)SESSOES, agoraNanos() - inicio, &arenaSessao, &antes);
+
+    (void)verificacao;
+    liberarArena(&arenaSessao);
+    liberarMansao(&mansao);
+    liberarArena(&arena);
+}
+
+// --- Modo headless
+
+int executarRoteiro(const Mansao* mansao, const TabelaHash* tabelaHash, const char* roteiro, size_t tamanhoRoteiro,
+                    FILE* saida, FILE* transcricao, long repeticoes, Salvamento* salvamento,
+                    Estatisticas* estatisticas, FluxoEventos* eventos) {
+    long condenacoes = 0;
+    uint64_t inicio = agoraNanos();
+    // As salas geradas valem para todas as repeticoes: a semente e a mesma
+    Arena arenaCache;
+    inicializarArena(&arenaCache);
+    CacheSalas* cache = criarCacheSalas(&arenaCache, mansao);
+
+    for (long i = 0; i < repeticoes; i++) {
+        Terminal terminal;
+        iniciarTerminal(&terminal, roteiro, tamanhoRoteiro, 0, saida, transcricao);
+        Arena arenaSessao;
+        inicializarArena(&arenaSessao);
+
+        Sessao sessao;
+        iniciarSessao(&sessao, &arenaSessao, mansao, cache, tabelaHash, &terminal);
+        if (salvamento != NULL) {
+            sessao.salvamento = salvamento;
+            if (!retomarSessao(&sessao, saida)) {
+                liberarArena(&arenaSessao);
+                liberarArena(&arenaCache);
+                return 0;
+            }
+        }
+        if (estatisticas != NULL) {
+            instrumentarSessao(&sessao, estatisticas);
+        }
+        // Depois da retomada: a releitura do diario nao repete eventos
+        if (eventos != NULL) {
+            sessao.eventos = &eventos->aneis[0];
+            sessao.numero = (uint32_t)i;
+        }
+        condenacoes += jogarSessao(&sessao);
+    }
+
+    double segundos = (double)(agoraNanos() - inicio) / 1e9;
+    fprintf(stderr, "sessoes=%ld condenacoes=%ld segundos=%.3f sessoes_por_segundo=%.0f\n",
+            repeticoes, condenacoes, segundos, segundos > 0 ? (double)repeticoes / segundos : 0.0);
+    if (saida != NULL) {
+        relatarCacheSalas(saida, mansao, cache);
+    }
+    liberarArena(&arenaCache);
+    return 1;
+}
+
+void* trabalhadorSessoes(void* argumento) {
+    PoolSessoes* pool = (PoolSessoes*)argumento;
+    long condenacoes = 0;
+    AnelEventos* eventos = NULL;
+    if (pool->eventos != NULL) {
+        eventos = &pool->eventos->aneis[atomic_fetch_add_explicit(&pool->proximoAnel, 1, memory_order_relaxed)];
+    }
+    Arena arenaCache;
+    inicializarArena(&arenaCache);
+    CacheSalas* cache = criarCacheSalas(&arenaCache, pool->mansao);
+
+    long indice;
+    while ((indice = atomic_fetch_add_explicit(&pool->proximaSessao, 1, memory_order_relaxed)) < pool->totalSessoes) {
+        // Sem saida nem transcricao: o texto de varias sessoes se misturaria
+        Terminal terminal;
+        iniciarTerminal(&terminal, pool->roteiro, pool->tamanhoRoteiro, 0, NULL, NULL);
+        Arena arenaSessao;
+        inicializarArena(&arenaSessao);
+
+        Sessao sessao;
+        iniciarSessao(&sessao, &arenaSessao, pool->mansao, cache, pool->tabelaHash, &terminal);
+        sessao.eventos = eventos;
+        sessao.numero = (uint32_t)indice;
+        condenacoes += jogarSessao(&sessao);
+    }
+    liberarArena(&arenaCache);
+
+    atomic_fetch_add_explicit(&pool->condenacoes, condenacoes, memory_order_relaxed);
+    return NULL;
+}
+
+int executarSessoesParalelas(const Mansao* mansao, const TabelaHash* tabelaHash, const char* roteiro, size_t tamanhoRoteiro,
+                             long totalSessoes, int numThreads, FluxoEventos* eventos) {
+    PoolSessoes pool;
+    pool.mansao = mansao;
+    pool.tabelaHash = tabelaHash;
+    pool.roteiro = roteiro;
+    pool.tamanhoRoteiro = tamanhoRoteiro;
+    pool.totalSessoes = totalSessoes;
+    atomic_init(&pool.proximaSessao, 0);
+    atomic_init(&pool.condenacoes, 0);
+    pool.eventos = eventos;
+    atomic_init(&pool.proximoAnel, 0);
+
+    uint64_t inicio = agoraNanos();
+
+#ifdef _WIN32
+    // Sem pthreads: o proprio processo faz o papel de unico trabalhador
+    numThreads = 1;
+    trabalhadorSessoes(&pool);
+#else
+    pthread_t* threads = (pthread_t*)malloc((size_t)numThreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para as threads.\n");
+        exit(1);
+    }
+
+    int iniciadas = 0;
+    for (; iniciadas < numThreads; iniciadas++) {
+        if (pthread_create(&threads[iniciadas], NULL, trabalhadorSessoes, &pool) != 0) {
+            break;
+        }
+    }
+    if (iniciadas == 0) {
+        // Nenhuma thread criada: roda tudo na thread principal
+        trabalhadorSessoes(&pool);
+    }
+    for (int i = 0; i < iniciadas; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    numThreads = iniciadas > 0 ? iniciadas : 1;
+#endif
+
+    double segundos = (double)(agoraNanos() - inicio) / 1e9;
+    fprintf(stderr, "sessoes=%ld condenacoes=%ld threads=%d segundos=%.3f sessoes_por_segundo=%.0f\n",
+            totalSessoes, atomic_load(&pool.condenacoes), numThreads, segundos,
+            segundos > 0 ? (double)totalSessoes / segundos : 0.0);
+    return 1;
+}
+
+// --- Planejador de rotas
+//
+// Menor numero de movimentos (e/d) para reunir LIMIAR_CONDENACAO pistas
+// distintas de cada suspeito, em cenarios onde toda pista pesa 1. A pista
+// do Hall vem de graca e cada folha devolve o jogador ao Hall, entao uma
+// rota e uma sequencia de descidas a partir do Hall. Com limiar 2 so ha duas formas otimas: uma descida
+// que passa por duas pistas do suspeito, ou uma descida completa ate a
+// folha mais rasa abaixo de uma pista seguida de uma descida parcial ate
+// outra. Basta uma passada pelas salas com os melhores candidatos.
+
+int numeroDeNucleos() {
+#ifdef _WIN32
+    return 1;
+#else
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    return nucleos > 0 ? (int)nucleos : 1;
+#endif
+}
+
+int candidatoRotaMenor(const CandidatoRota* a, const CandidatoRota* b) {
+    // Empate decidido pela sala: o resultado nao depende das threads
+    return a->custo < b->custo || (a->custo == b->custo && a->sala < b->sala);
+}
+
+void inserirCandidatoRota(CandidatoRota melhores[2], CandidatoRota candidato) {
+    if (candidato.idPista == melhores[0].idPista) {
+        if (candidatoRotaMenor(&candidato, &melhores[0])) {
+            melhores[0] = candidato;
+        }
+    } else if (candidato.idPista == melhores[1].idPista) {
+        if (candidatoRotaMenor(&candidato, &melhores[1])) {
+            melhores[1] = candidato;
+            if (candidatoRotaMenor(&melhores[1], &melhores[0])) {
+                CandidatoRota troca = melhores[0];
+                melhores[0] = melhores[1];
+                melhores[1] = troca;
+            }
+        }
+    } else if (candidatoRotaMenor(&candidato, &melhores[0])) {
+        melhores[1] = melhores[0];
+        melhores[0] = candidato;
+    } else if (candidatoRotaMenor(&candidato, &melhores[1])) {
+        melhores[1] = candidato;
+    }
+}
+
+void prepararPlanoRotas(PlanoRotas* plano, Arena* arena, const Mansao* mansao, const TabelaHash* tabelaHash, int numThreads) {
+    uint32_t numSalas = mansao->numSalas;
+    plano->mansao = mansao;
+    plano->tabelaHash = tabelaHash;
+    plano->pai = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    plano->profundidade = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+    plano->folhaMaisProxima = (uint32_t*)alocarNaArena(arena, (size_t)numSalas * sizeof(uint32_t));
+
+    // De cima para baixo: na ordem BFS o pai sempre vem antes dos filhos
+    plano->pai[SALA_HALL] = SEM_SALA;
+    plano->profundidade[SALA_HALL] = 0;
+    for (uint32_t sala = 0; sala < numSalas; sala++) {
+        uint32_t esquerda = salaEsquerda(mansao, NULL, sala);
+        uint32_t direita = salaDireita(mansao, NULL, sala);
+        if (esquerda != SEM_SALA) {
+            plano->pai[esquerda] = sala;
+            plano->profundidade[esquerda] = plano->profundidade[sala] + 1;
+        }
+        if (direita != SEM_SALA) {
+            plano->pai[direita] = sala;
+            plano->profundidade[direita] = plano->profundidade[sala] + 1;
+        }
+    }
+
+    // De baixo para cima: a folha mais rasa de cada subarvore fica memorizada
+    for (uint32_t sala = numSalas; sala-- > 0;) {
+        uint32_t esquerda = salaEsquerda(mansao, NULL, sala);
+        uint32_t direita = salaDireita(mansao, NULL, sala);
+        uint32_t folha = UINT32_MAX;
+        if (esquerda != SEM_SALA) {
+            folha = plano->folhaMaisProxima[esquerda];
+        }
+        if (direita != SEM_SALA && plano->folhaMaisProxima[direita] < folha) {
+            folha = plano->folhaMaisProxima[direita];
+        }
+        plano->folhaMaisProxima[sala] = folha != UINT32_MAX ? folha : plano->profundidade[sala];
+    }
+
+    // Fronteira: desce nivel a nivel ate ter subarvores para todas as
+    // threads. Os filhos de um nivel sao o trecho seguinte do vetor
+    uint32_t alvo = (uint32_t)numThreads * FRONTEIRA_POR_THREAD;
+    uint32_t inicio = 0;
+    uint32_t fim = 1;
+    for (int nivel = 0; nivel < NIVEIS_MAXIMOS_FRONTEIRA && fim - inicio < alvo; nivel++) {
+        uint32_t proximoFim = fim;
+        for (uint32_t sala = inicio; sala < fim; sala++) {
+            uint32_t direita = salaDireita(mansao, NULL, sala);
+            uint32_t esquerda = salaEsquerda(mansao, NULL, sala);
+            if (direita != SEM_SALA) {
+                proximoFim = direita + 1;
+            } else if (esquerda != SEM_SALA) {
+                proximoFim = esquerda + 1;
+            }
+        }
+        if (proximoFim == fim) {
+            break; // nivel sem filhos: a fronteira fica nele
+        }
+        inicio = fim;
+        fim = proximoFim;
+    }
+    plano->inicioFronteira = inicio;
+    plano->fimFronteira = fim;
+    atomic_init(&plano->proximaRaiz, inicio);
+}
+
+void avaliarSalaNaRota(const PlanoRotas* plano, MelhoresRotas* rotas, uint32_t sala, uint32_t idPista, int temOutraPista) {
+    CandidatoRota parcial = {plano->profundidade[sala], sala, idPista};
+    CandidatoRota completa = {plano->folhaMaisProxima[sala], sala, idPista};
+    inserirCandidatoRota(rotas->parcial, parcial);
+    inserirCandidatoRota(rotas->completa, completa);
+    if (temOutraPista && candidatoRotaMenor(&parcial, &rotas->unica)) {
+        rotas->unica = parcial;
+    }
+}
+
+int caminhoTemOutraPista(const PlanoRotas* plano, uint32_t sala, uint32_t idPista, int suspeito) {
+    for (uint32_t atual = plano->pai[sala]; atual != SEM_SALA; atual = plano->pai[atual]) {
+        uint32_t id = plano->mansao->pistasInternadas[atual];
+        if (id != SEM_PISTA && id != idPista && indiceSuspeitoDaPista(plano->tabelaHash, id) == suspeito) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int anotarPistaNoCaminho(PistasNoCaminho* caminho, uint32_t idPista) {
+    // Duas pistas distintas ja bastam; as seguintes nao mudam nada
+    if (caminho->quantidade >= 2 || (caminho->quantidade == 1 && caminho->ids[0] == idPista)) {
+        return 0;
+    }
+    caminho->ids[caminho->quantidade++] = idPista;
+    return 1;
+}
+
+void* trabalhadorRotas(void* argumento) {
+    TrabalhadorRotas* trabalhador = (TrabalhadorRotas*)argumento;
+    PlanoRotas* plano = trabalhador->plano;
+    const Mansao* mansao = plano->mansao;
+    const TabelaHash* tabela = plano->tabelaHash;
+
+    size_t numSuspeitos = tabela->numSuspeitos > 0 ? (size_t)tabela->numSuspeitos : 1;
+    PistasNoCaminho* caminho = (PistasNoCaminho*)calloc(numSuspeitos, sizeof(PistasNoCaminho));
+    size_t capacidadePilha = 256;
+    uint32_t* pilha = (uint32_t*)malloc(capacidadePilha * sizeof(uint32_t));
+    if (caminho == NULL || pilha == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para o planejador.\n");
+        exit(1);
+    }
+
+    uint32_t raiz;
+    while ((raiz = atomic_fetch_add_explicit(&plano->proximaRaiz, 1, memory_order_relaxed)) < plano->fimFronteira) {
+        // Pistas acima da raiz; a ordem nao importa, so quais sao distintas
+        for (uint32_t atual = plano->pai[raiz]; atual != SEM_SALA; atual = plano->pai[atual]) {
+            uint32_t id = mansao->pistasInternadas[atual];
+            int suspeito = indiceSuspeitoDaPista(tabela, id);
+            if (suspeito >= 0) {
+                anotarPistaNoCaminho(&caminho[suspeito], id);
+            }
+        }
+
+        // Busca em profundidade com pilha explicita; o bit baixo marca a
+        // saida de uma sala que anotou pista, para desfazer a anotacao
+        size_t topo = 0;
+        pilha[topo++] = raiz << 1;
+        while (topo > 0) {
+            uint32_t entrada = pilha[--topo];
+            uint32_t sala = entrada >> 1;
+            uint32_t idPista = mansao->pistasInternadas[sala];
+            int suspeito = indiceSuspeitoDaPista(tabela, idPista);
+            if (entrada & 1) {
+                caminho[suspeito].quantidade--;
+                continue;
+            }
+
+            if (topo + 3 > capacidadePilha) {
+                capacidadePilha *= 2;
+                uint32_t* maior = (uint32_t*)realloc(pilha, capacidadePilha * sizeof(uint32_t));
+                if (maior == NULL) {
+                    printf("Erro: Nao foi possivel alocar memoria para o planejador.\n");
+                    exit(1);
+                }
+                pilha = maior;
+            }
+
+            if (suspeito >= 0) {
+                PistasNoCaminho* pistas = &caminho[suspeito];
+                int temOutraPista = pistas->quantidade == 2 || (pistas->quantidade == 1 && pistas->ids[0] != idPista);
+                avaliarSalaNaRota(plano, &trabalhador->melhores[suspeito], sala, idPista, temOutraPista);
+                if (anotarPistaNoCaminho(pistas, idPista)) {
+                    pilha[topo++] = (sala << 1) | 1;
+                }
+            }
+
+            uint32_t direita = salaDireita(mansao, NULL, sala);
+            uint32_t esquerda = salaEsquerda(mansao, NULL, sala);
+            if (direita != SEM_SALA) {
+                pilha[topo++] = direita << 1;
+            }
+            if (esquerda != SEM_SALA) {
+                pilha[topo++] = esquerda << 1;
+            }
+        }
+
+        // Desfaz as pistas dos ancestrais antes da proxima subarvore
+        for (uint32_t atual = plano->pai[raiz]; atual != SEM_SALA; atual = plano->pai[atual]) {
+            int suspeito = indiceSuspeitoDaPista(tabela, mansao->pistasInternadas[atual]);
+            if (suspeito >= 0) {
+                caminho[suspeito].quantidade = 0;
+            }
+        }
+    }
+
+    free(pilha);
+    free(caminho);
+    return NULL;
+}
+
+MelhoresRotas* calcularMelhoresRotas(PlanoRotas* plano, Arena* arena, int numThreads) {
+    const Mansao* mansao = plano->mansao;
+    const TabelaHash* tabela = plano->tabelaHash;
+    size_t numSuspeitos = (size_t)tabela->numSuspeitos;
+
+    // Posicao 0 e o resultado; as seguintes, uma por trabalhador
+    size_t totalRotas = ((size_t)numThreads + 1) * numSuspeitos;
+    MelhoresRotas* melhores = (MelhoresRotas*)alocarNaArena(arena, (totalRotas > 0 ? totalRotas : 1) * sizeof(MelhoresRotas));
+    CandidatoRota vazio = {UINT32_MAX, SEM_SALA, SEM_PISTA};
+    for (size_t i = 0; i < totalRotas; i++) {
+        melhores[i].unica = vazio;
+        melhores[i].parcial[0] = melhores[i].parcial[1] = vazio;
+        melhores[i].completa[0] = melhores[i].completa[1] = vazio;
+    }
+
+    // Salas acima da fronteira: poucos niveis, avaliadas aqui subindo pelos pais
+    for (uint32_t sala = 0; sala < plano->inicioFronteira; sala++) {
+        uint32_t idPista = mansao->pistasInternadas[sala];
+        int suspeito = indiceSuspeitoDaPista(tabela, idPista);
+        if (suspeito >= 0) {
+            avaliarSalaNaRota(plano, &melhores[suspeito], sala, idPista,
+                              caminhoTemOutraPista(plano, sala, idPista, suspeito));
+        }
+    }
+
+    TrabalhadorRotas* trabalhadores = (TrabalhadorRotas*)malloc((size_t)numThreads * sizeof(TrabalhadorRotas));
+    if (trabalhadores == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para as threads.\n");
+        exit(1);
+    }
+    for (int i = 0; i < numThreads; i++) {
+        trabalhadores[i].plano = plano;
+        trabalhadores[i].melhores = melhores + (size_t)(i + 1) * numSuspeitos;
+    }
+
+#ifdef _WIN32
+    // Sem pthreads: o primeiro trabalhador percorre todas as subarvores
+    trabalhadorRotas(&trabalhadores[0]);
+#else
+    pthread_t* threads = (pthread_t*)malloc((size_t)numThreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para as threads.\n");
+        exit(1);
+    }
+
+    int iniciadas = 0;
+    for (; iniciadas < numThreads; iniciadas++) {
+        if (pthread_create(&threads[iniciadas], NULL, trabalhadorRotas, &trabalhadores[iniciadas]) != 0) {
+            break;
+        }
+    }
+    if (iniciadas == 0) {
+        // Nenhuma thread criada: roda tudo na thread principal
+        trabalhadorRotas(&trabalhadores[0]);
+    }
+    for (int i = 0; i < iniciadas; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+#endif
+
+    // Os dois melhores de cada trabalhador bastam para achar os dois melhores no total
+    for (int i = 0; i < numThreads; i++) {
+        for (size_t s = 0; s < numSuspeitos; s++) {
+            const MelhoresRotas* parcial = &trabalhadores[i].melhores[s];
+            MelhoresRotas* total = &melhores[s];
+            if (candidatoRotaMenor(&parcial->unica, &total->unica)) {
+                total->unica = parcial->unica;
+            }
+            for (int j = 0; j < 2; j++) {
+                if (parcial->parcial[j].sala != SEM_SALA) {
+                    inserirCandidatoRota(total->parcial, parcial->parcial[j]);
+                }
+                if (parcial->completa[j].sala != SEM_SALA) {
+                    inserirCandidatoRota(total->completa, parcial->completa[j]);
+                }
+            }
+        }
+    }
+    free(trabalhadores);
+    return melhores;
+}
+
+void anexarCaminhoAteSala(BufferTexto* rota, const PlanoRotas* plano, uint32_t sala) {
+    // Sobe ate o Hall anotando os passos e depois inverte o trecho
+    size_t inicio = rota->tamanho;
+    for (uint32_t atual = sala; plano->pai[atual] != SEM_SALA; atual = plano->pai[atual]) {
+        char passo = salaEsquerda(plano->mansao, NULL, plano->pai[atual]) == atual ? 'e' : 'd';
+        anexarTexto(rota, &passo, 1);
+    }
+    for (size_t i = inicio, j = rota->tamanho; i + 1 < j; i++, j--) {
+        char troca = rota->dados[i];
+        rota->dados[i] = rota->dados[j - 1];
+        rota->dados[j - 1] = troca;
+    }
+}
+
+void anexarDescidaAteFolha(BufferTexto* rota, const PlanoRotas* plano, uint32_t sala) {
+    // Segue o filho cuja subarvore guarda a folha mais rasa
+    while (!verificarFimDoCaminho(plano->mansao, NULL, sala)) {
+        uint32_t esquerda = salaEsquerda(plano->mansao, NULL, sala);
+        char passo;
+        if (esquerda != SEM_SALA && plano->folhaMaisProxima[esquerda] == plano->folhaMaisProxima[sala]) {
+            passo = 'e';
+            sala = esquerda;
+        } else {
+            passo = 'd';
+            sala = salaDireita(plano->mansao, NULL, sala);
+        }
+        anexarTexto(rota, &passo, 1);
+    }
+}
+
+long montarRota(const PlanoRotas* plano, const MelhoresRotas* rotas, BufferTexto* rota) {
+    if (LIMIAR_CONDENACAO == 1) {
+        if (rotas->parcial[0].sala == SEM_SALA) {
+            return -1;
+        }
+        anexarCaminhoAteSala(rota, plano, rotas->parcial[0].sala);
+        return rotas->parcial[0].custo;
+    }
+
+    uint64_t melhor = rotas->unica.sala != SEM_SALA ? rotas->unica.custo : UINT64_MAX;
+    int escolhaCompleta = -1;
+    int escolhaParcial = -1;
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            const CandidatoRota* completa = &rotas->completa[i];
+            const CandidatoRota* parcial = &rotas->parcial[j];
+            if (completa->sala == SEM_SALA || parcial->sala == SEM_SALA || completa->idPista == parcial->idPista) {
+                continue;
+            }
+            uint64_t custo = (uint64_t)completa->custo + parcial->custo;
+            if (custo < melhor) {
+                melhor = custo;
+                escolhaCompleta = i;
+                escolhaParcial = j;
+            }
+        }
+    }
+    if (melhor == UINT64_MAX) {
+        return -1;
+    }
+
+    if (escolhaCompleta < 0) {
+        anexarCaminhoAteSala(rota, plano, rotas->unica.sala);
+    } else {
+        // '/' marca a volta automatica ao Hall ao fim da primeira descida
+        uint32_t sala = rotas->completa[escolhaCompleta].sala;
+        anexarCaminhoAteSala(rota, plano, sala);
+        anexarDescidaAteFolha(rota, plano, sala);
+        anexarTexto(rota, "/", 1);
+        anexarCaminhoAteSala(rota, plano, rotas->parcial[escolhaParcial].sala);
+    }
+    return (long)melhor;
+}
+
+// O planejador conta pistas distintas do suspeito principal, o que so
+// coincide com o veredito quando cada pista pesa exatamente 1 para ele
+// e 0 para os demais
+int pesosSaoUnitarios(const TabelaHash* tabelaHash) {
+    for (uint32_t id = 0; id < (uint32_t)tabelaHash->quantidade; id++) {
+        int principal = indiceSuspeitoDaPista(tabelaHash, id);
+        const float* linha = linhaDePesos(tabelaHash, id);
+        if (linha == NULL) {
+            if (principal >= 0) {
+                return 0;
+            }
+            continue;
+        }
+        for (int s = 0; s < tabelaHash->numSuspeitos; s++) {
+            float esperado = s == principal ? 1.0f : 0.0f;
+            if (linha[s] < esperado || linha[s] > esperado) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int planejarRotas(const Mansao* mansao, const TabelaHash* tabelaHash, int numThreads) {
+    if (!mansao->arvore) {
+        printf("Erro: O planejador de rotas so trata mansoes em arvore (saidas e/d e uma entrada por sala).\n");
+        return 0;
+    }
+    if (mansao->procedural != NULL) {
+        printf("Erro: O planejador de rotas percorre todas as salas; uma mansao procedural so as gera sob demanda.\n");
+        return 0;
+    }
+    if (!pesosSaoUnitarios(tabelaHash)) {
+        printf("Erro: O planejador de rotas conta pistas; o cenario tem pistas com peso diferente de 1 ou de mais de um suspeito.\n");
+        return 0;
+    }
+
+    Arena arena;
+    inicializarArena(&arena);
+    uint64_t inicio = agoraNanos();
+
+    PlanoRotas plano;
+    prepararPlanoRotas(&plano, &arena, mansao, tabelaHash, numThreads);
+    MelhoresRotas* melhores = calcularMelhoresRotas(&plano, &arena, numThreads);
+
+    printf("suspeito,movimentos,rota\n");
+    BufferTexto rota = {NULL, 0, 0};
+    for (int s = 0; s < tabelaHash->numSuspeitos; s++) {
+        rota.tamanho = 0;
+        long movimentos = montarRota(&plano, &melhores[s], &rota);
+        printf("%s,%ld,", tabelaHash->suspeitos[s], movimentos);
+        fwrite(rota.dados != NULL ? rota.dados : "", 1, rota.tamanho, stdout);
+        printf("\n");
+    }
+    free(rota.dados);
+
+    double segundos = (double)(agoraNanos() - inicio) / 1e9;
+    fprintf(stderr, "salas=%u suspeitos=%d threads=%d fronteira=%u segundos=%.3f\n", mansao->numSalas,
+            tabelaHash->numSuspeitos, numThreads, plano.fimFronteira - plano.inicioFronteira, segundos);
+    liberarArena(&arena);
+    return 1;
+}
+
+// --- Simulacao Monte Carlo
+//
+// Joga milhoes de partidas contra a mesma logica do jogo interativo
+// (processarNavegacaoComPistas, coletarPista, verificarSuspeitoFinal),
+// sem texto: o terminal descarta a saida e as respostas de cada pergunta
+// sao postas nele antes da jogada. Serve para balancear um caso: quantas
+// pistas um jogador costuma reunir e com que frequencia cada suspeito
+// acaba condenado.
+
+const char* nomePoliticaSimulacao(PoliticaSimulacao politica) {
+    static const char* const nomes[NUM_POLITICAS_SIMULACAO] = {"aleatoria", "gulosa"};
+    return nomes[politica];
+}
+
+int lerPoliticaSimulacao(const char* texto, PoliticaSimulacao* politica) {
+    for (int i = 0; i < NUM_POLITICAS_SIMULACAO; i++) {
+        if (strcmp(texto, nomePoliticaSimulacao((PoliticaSimulacao)i)) == 0) {
+            *politica = (PoliticaSimulacao)i;
+            return 1;
+        }
+    }
+    printf("Erro: Politica de simulacao desconhecida: %s (use aleatoria ou gulosa).\n", texto);
+    return 0;
+}
+
+uint64_t empacotarFaixa(uint32_t inicio, uint32_t fim) {
+    return ((uint64_t)inicio << 32) | fim;
+}
+
+int retirarLote(FaixaSimulacao* faixa, uint32_t* inicio, uint32_t* fim) {
+    uint64_t atual = atomic_load_explicit(&faixa->faixa, memory_order_relaxed);
+    for (;;) {
+        uint32_t primeiro = (uint32_t)(atual >> 32);
+        uint32_t ultimo = (uint32_t)atual;
+        if (primeiro >= ultimo) {
+            return 0;
+        }
+        uint32_t corte = ultimo - primeiro > LOTE_SIMULACAO ? primeiro + LOTE_SIMULACAO : ultimo;
+        if (atomic_compare_exchange_weak_explicit(&faixa->faixa, &atual, empacotarFaixa(corte, ultimo),
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            *inicio = primeiro;
+            *fim = corte;
+            return 1;
+        }
+    }
+}
+
+int roubarLotes(Simulacao* simulacao, int ladrao, uint32_t* inicio, uint32_t* fim) {
+    // Percorre os outros trabalhadores a partir do vizinho e leva a metade
+    // do fim da primeira faixa com trabalho; uma sobra de ate um lote vai inteira
+    for (int k = 1; k < simulacao->numTrabalhadores; k++) {
+        FaixaSimulacao* vitima = &simulacao->faixas[(ladrao + k) % simulacao->numTrabalhadores];
+        uint64_t atual = atomic_load_explicit(&vitima->faixa, memory_order_relaxed);
+        for (;;) {
+            uint32_t primeiro = (uint32_t)(atual >> 32);
+            uint32_t ultimo = (uint32_t)atual;
+            if (primeiro >= ultimo) {
+                break;
+            }
+            uint32_t restante = ultimo - primeiro;
+            uint32_t corte = restante > LOTE_SIMULACAO ? ultimo - restante / 2 : primeiro;
+            if (atomic_compare_exchange_weak_explicit(&vitima->faixa, &atual, empacotarFaixa(primeiro, corte),
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *inicio = corte;
+                *fim = ultimo;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+uint32_t escolherSaida(const Sessao* sessao, PoliticaSimulacao politica, uint32_t* estado) {
+    // Devolve a posicao da saida na lista da sala, ou SEM_SALA sem saidas
+    const Saida* saidas = saidasDaSala(sessao->mansao, sessao->cache, sessao->salaAtual);
+    uint32_t grau = grauDaSala(sessao->mansao, sessao->cache, sessao->salaAtual);
+    if (grau == 0) {
+        return SEM_SALA;
+    }
+
+    if (politica == POLITICA_GULOSA) {
+        uint32_t novas = 0;
+        for (uint32_t k = 0; k < grau; k++) {
+            novas += !salaFoiVisitada(&sessao->visitas, saidas[k].destino);
+        }
+        if (novas > 0) {
+            uint32_t sorteada = proximoAleatorio(estado) % novas;
+            for (uint32_t k = 0; k < grau; k++) {
+                if (!salaFoiVisitada(&sessao->visitas, saidas[k].destino) && sorteada-- == 0) {
+                    return k;
+                }
+            }
+        }
+    }
+    return proximoAleatorio(estado) % grau;
+}
+
+void responderNoTerminal(Terminal* terminal, const char* resposta, size_t tamanho) {
+    terminal->roteiro = resposta;
+    terminal->tamanhoRoteiro = tamanho;
+    terminal->posicao = 0;
+}
+
+void simularSessao(Simulacao* simulacao, Arena* arena, CacheSalas* cache, uint32_t indice, AnelEventos* eventos, ResultadoSimulacao* resultado) {
+    const Mansao* mansao = simulacao->mansao;
+    const TabelaHash* tabela = simulacao->tabelaHash;
+
+    // Roteiro vazio, nunca NULL: sem resposta preparada a leitura acaba,
+    // em vez de esperar pela entrada padrao
+    Terminal terminal;
+    iniciarTerminal(&terminal, "", 0, 0, NULL, NULL);
+    Sessao sessao;
+    iniciarSessao(&sessao, arena, mansao, cache, tabela, &terminal);
+    sessao.eventos = eventos;
+    sessao.numero = indice;
+
+    // Multiplicacao de Fibonacci espalha indices vizinhos pelo estado
+    uint32_t estado = (uint32_t)((((uint64_t)indice + 1) * 0x9E3779B97F4A7C15ull) >> 32) ^ simulacao->semente;
+    if (estado == 0) {
+        estado = 2463534242u;
+    }
+
+    registrarEvento(&sessao, EVENTO_SALA, SALA_HALL, SEM_SALA, -1, 0);
+    marcarSalaComoVisitada(&sessao.visitas, SALA_HALL);
+    coletarPista(&sessao);
+
+    char comando[16];
+    uint32_t passo = 0;
+    for (; passo < simulacao->passos && !todasSalasVisitadas(&sessao.visitas); passo++) {
+        uint32_t saida = escolherSaida(&sessao, simulacao->politica, &estado);
+        if (saida == SEM_SALA) {
+            break;
+        }
+        // O numero vale para qualquer saida; o "s" confirma a volta a uma sala ja vista
+        snprintf(comando, sizeof(comando), "%u", saida + 1);
+        responderNoTerminal(&terminal, "s\n", 2);
+        processarNavegacaoComPistas(&sessao, comando);
+    }
+
+    // Julgamento: acusa o lider do placar, como faria um jogador atento
+    const float* pontuacao = sessao.caderno.pontuacao;
+    int acusado = -1;
+    for (int s = 0; s < tabela->numSuspeitos; s++) {
+        if (acusado < 0 || pontuacao[s] > pontuacao[acusado]) {
+            acusado = s;
+        }
+    }
+    char resposta[128];
+    int tamanho = snprintf(resposta, sizeof(resposta), "%s\n", acusado >= 0 ? tabela->suspeitos[acusado] : "");
+    responderNoTerminal(&terminal, resposta, tamanho < (int)sizeof(resposta) ? (size_t)tamanho : sizeof(resposta) - 1);
+    int condenado = verificarSuspeitoFinal(&sessao);
+    registrarEvento(&sessao, EVENTO_FIM_SESSAO, SEM_SALA, (uint32_t)sessao.caderno.totalPistas, -1, condenado);
+
+    resultado->sessoes++;
+    resultado->movimentos += passo;
+    resultado->salasVisitadas += sessao.visitas.salasVisitadas;
+    resultado->pistasPorSessao[sessao.caderno.totalPistas]++;
+    resultado->condenacoes += (uint64_t)condenado;
+    if (acusado >= 0) {
+        resultado->acusacoes[acusado]++;
+        resultado->condenados[acusado] += (uint64_t)condenado;
+        resultado->acertos += (uint64_t)(condenado && acusado == simulacao->indiceCulpado);
+    }
+    for (int s = 0; s < tabela->numSuspeitos; s++) {
+        resultado->condenaveis[s] += pontuacao[s] >= (float)LIMIAR_CONDENACAO - TOLERANCIA_PESO;
+    }
+
+    // Caderno, visitas e placar do julgamento: tudo na arena do trabalhador
+    reiniciarArena(arena);
+}
+
+void* trabalhadorSimulacao(void* argumento) {
+    TrabalhadorSimulacao* trabalhador = (TrabalhadorSimulacao*)argumento;
+    Simulacao* simulacao = trabalhador->simulacao;
+    FaixaSimulacao* propria = &simulacao->faixas[trabalhador->indice];
+
+    // Contadores numa copia local: o vetor de trabalhadores fica intocado ate o fim
+    ResultadoSimulacao resultado = trabalhador->resultado;
+    AnelEventos* eventos = simulacao->eventos != NULL ? &simulacao->eventos->aneis[trabalhador->indice] : NULL;
+    Arena arena;
+    inicializarArena(&arena);
+    Arena arenaCache;
+    inicializarArena(&arenaCache);
+    CacheSalas* cache = criarCacheSalas(&arenaCache, simulacao->mansao);
+
+    for (;;) {
+        uint32_t inicio;
+        uint32_t fim;
+        if (!retirarLote(propria, &inicio, &fim)) {
+            if (!roubarLotes(simulacao, trabalhador->indice, &inicio, &fim)) {
+                break;
+            }
+            // O roubo vira a faixa propria, e dela outros podem roubar de novo
+            resultado.roubos++;
+            atomic_store_explicit(&propria->faixa, empacotarFaixa(inicio, fim), memory_order_relaxed);
+            continue;
+        }
+        for (uint32_t i = inicio; i < fim; i++) {
+            simularSessao(simulacao, &arena, cache, i, eventos, &resultado);
+        }
+    }
+
+    liberarArena(&arenaCache);
+    liberarArena(&arena);
+    trabalhador->resultado = resultado;
+    return NULL;
+}
+
+uint32_t percentilPistas(const uint64_t* pistasPorSessao, uint32_t maximo, uint64_t sessoes, double fracao) {
+    uint64_t acumulado = 0;
+    for (uint32_t k = 0; k <= maximo; k++) {
+        acumulado += pistasPorSessao[k];
+        if ((double)acumulado >= fracao * (double)sessoes) {
+            return k;
+        }
+    }
+    return maximo;
+}
+
+void exibirResultadoSimulacao(const Simulacao* simulacao, const ResultadoSimulacao* total, uint32_t maximoPistas) {
+    const TabelaHash* tabela = simulacao->tabelaHash;
+    double sessoes = (double)total->sessoes;
+
+    uint32_t maiorObtido = 0;
+    uint64_t somaPistas = 0;
+    for (uint32_t k = 0; k <= maximoPistas; k++) {
+        somaPistas += (uint64_t)k * total->pistasPorSessao[k];
+        if (total->pistasPorSessao[k] > 0) {
+            maiorObtido = k;
+        }
+    }
+
+    printf("=== SIMULACAO: %llu sessoes, politica %s, ate %u movimentos ===\n",
+           (unsigned long long)total->sessoes, nomePoliticaSimulacao(simulacao->politica), simulacao->passos);
+    printf("Movimentos por sessao: %.1f | Salas visitadas: %.1f de %u\n", (double)total->movimentos / sessoes,
+           (double)total->salasVisitadas / sessoes, simulacao->mansao->numSalas);
+    printf("\nPistas no caderno ao fim (de %u nas salas): media %.2f | p10 %u | p50 %u | p90 %u | maximo %u\n",
+           maximoPistas, (double)somaPistas / sessoes,
+           percentilPistas(total->pistasPorSessao, maximoPistas, total->sessoes, 0.10),
+           percentilPistas(total->pistasPorSessao, maximoPistas, total->sessoes, 0.50),
+           percentilPistas(total->pistasPorSessao, maximoPistas, total->sessoes, 0.90), maiorObtido);
+
+    // Poucas pistas: uma linha por quantidade; muitas: dez faixas iguais
+    uint32_t numFaixas = maximoPistas < 16 ? maximoPistas + 1 : 10;
+    for (uint32_t f = 0; f < numFaixas; f++) {
+        uint32_t primeira = numFaixas == maximoPistas + 1 ? f : (uint32_t)((uint64_t)maximoPistas * f / numFaixas);
+        uint32_t ultima = numFaixas == maximoPistas + 1 ? f : (uint32_t)((uint64_t)maximoPistas * (f + 1) / numFaixas) - 1;
+        if (f == numFaixas - 1) {
+            ultima = maximoPistas;
+        }
+        uint64_t contagem = 0;
+        for (uint32_t k = primeira; k <= ultima; k++) {
+            contagem += total->pistasPorSessao[k];
+        }
+        double parcela = (double)contagem / sessoes;
+        char barra[41];
+        int largura = (int)(parcela * 40.0 + 0.5);
+        memset(barra, '#', (size_t)largura);
+        barra[largura] = '\0';
+        if (primeira == ultima) {
+            printf("  %9u: %6.2f%% %s\n", primeira, parcela * 100.0, barra);
+        } else {
+            printf("  %4u-%-4u: %6.2f%% %s\n", primeira, ultima, parcela * 100.0, barra);
+        }
+    }
+
+    // Condenavel: a pontuacao ao fim bastaria, fosse ele o acusado
+    printf("\n%-24s %10s %10s %11s\n", "Suspeito", "acusado", "condenado", "condenavel");
+    for (int s = 0; s < tabela->numSuspeitos; s++) {
+        printf("%-24s %9.2f%% %9.2f%% %10.2f%%%s\n", tabela->suspeitos[s], 100.0 * (double)total->acusacoes[s] / sessoes,
+               100.0 * (double)total->condenados[s] / sessoes, 100.0 * (double)total->condenaveis[s] / sessoes,
+               s == simulacao->indiceCulpado ? "  (culpado)" : "");
+    }
+    printf("\nCondenacoes: %.2f%%", 100.0 * (double)total->condenacoes / sessoes);
+    if (simulacao->indiceCulpado >= 0) {
+        printf(" | culpado real condenado: %.2f%%", 100.0 * (double)total->acertos / sessoes);
+    }
+    printf("\n");
+}
+
+int simularPartidas(const Mansao* mansao, const TabelaHash* tabelaHash, long totalSessoes, PoliticaSimulacao politica,
+                    uint32_t passos, uint32_t semente, int numThreads, FluxoEventos* eventos) {
+    if (totalSessoes < 1 || (unsigned long)totalSessoes > UINT32_MAX) {
+        printf("Erro: Numero de sessoes simuladas invalido.\n");
+        return 0;
+    }
+
+    Arena arena;
+    inicializarArena(&arena);
+
+    Simulacao simulacao;
+    simulacao.mansao = mansao;
+    simulacao.tabelaHash = tabelaHash;
+    simulacao.politica = politica;
+    simulacao.passos = passos;
+    simulacao.semente = semente;
+    simulacao.numTrabalhadores = numThreads;
+    simulacao.eventos = eventos;
+    simulacao.indiceCulpado = mansao->culpado != 0 ? buscarIndiceSuspeitoPorNome(tabelaHash, textoDaMansao(mansao, mansao->culpado))
+                                                   : tabelaHash->indiceCulpado;
+    simulacao.faixas = (FaixaSimulacao*)alocarAlinhadoNaArena(&arena, (size_t)numThreads * sizeof(FaixaSimulacao), LINHA_DE_CACHE);
+
+    // Pistas distintas que as salas oferecem: o teto do caderno. Numa
+    // mansao procedural qualquer pista do conjunto pode aparecer
+    uint32_t quantidade = (uint32_t)tabelaHash->quantidade;
+    unsigned char* presente = (unsigned char*)alocarNaArena(&arena, (size_t)quantidade + 1);
+    memset(presente, 0, (size_t)quantidade + 1);
+    uint32_t maximoPistas = mansao->procedural != NULL ? quantidade : 0;
+    for (uint32_t sala = 0; mansao->procedural == NULL && sala < mansao->numSalas; sala++) {
+        uint32_t idPista = mansao->pistasInternadas[sala];
+        if (idPista != SEM_PISTA && !presente[idPista]) {
+            presente[idPista] = 1;
+            maximoPistas++;
+        }
+    }
+
+    // Faixas iguais de partida; o roubo corrige o desequilibrio
+    size_t numSuspeitos = (size_t)tabelaHash->numSuspeitos;
+    TrabalhadorSimulacao* trabalhadores =
+        (TrabalhadorSimulacao*)alocarNaArena(&arena, (size_t)numThreads * sizeof(TrabalhadorSimulacao));
+    for (int t = 0; t < numThreads; t++) {
+        uint32_t inicio = (uint32_t)((uint64_t)totalSessoes * (uint64_t)t / (uint64_t)numThreads);
+        uint32_t fim = (uint32_t)((uint64_t)totalSessoes * (uint64_t)(t + 1) / (uint64_t)numThreads);
+        atomic_init(&simulacao.faixas[t].faixa, empacotarFaixa(inicio, fim));
+
+        TrabalhadorSimulacao* trabalhador = &trabalhadores[t];
+        memset(trabalhador, 0, sizeof(TrabalhadorSimulacao));
+        trabalhador->simulacao = &simulacao;
+        trabalhador->indice = t;
+        // Vetores de cada trabalhador em linhas de cache proprias
+        size_t tamanho = ((size_t)quantidade + 1 + numSuspeitos * 3) * sizeof(uint64_t);
+        uint64_t* contadores = (uint64_t*)alocarAlinhadoNaArena(&arena, tamanho + LINHA_DE_CACHE, LINHA_DE_CACHE);
+        memset(contadores, 0, tamanho);
+        trabalhador->resultado.pistasPorSessao = contadores;
+        trabalhador->resultado.acusacoes = contadores + quantidade + 1;
+        trabalhador->resultado.condenados = trabalhador->resultado.acusacoes + numSuspeitos;
+        trabalhador->resultado.condenaveis = trabalhador->resultado.condenados + numSuspeitos;
+    }
+
+    uint64_t inicio = agoraNanos();
+
+#ifdef _WIN32
+    // Sem pthreads: um trabalhador so, que rouba as faixas dos outros
+    trabalhadorSimulacao(&trabalhadores[0]);
+    int iniciadas = 1;
+#else
+    pthread_t* threads = (pthread_t*)malloc((size_t)numThreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        printf("Erro: Nao foi possivel alocar memoria para as threads.\n");
+        exit(1);
+    }
+
+    int iniciadas = 0;
+    for (; iniciadas < numThreads; iniciadas++) {
+        if (pthread_create(&threads[iniciadas], NULL, trabalhadorSimulacao, &trabalhadores[iniciadas]) != 0) {
+            break;
+        }
+    }
+    if (iniciadas == 0) {
+        // Nenhuma thread criada: a principal rouba todas as faixas
+        trabalhadorSimulacao(&trabalhadores[0]);
+    }
+    for (int i = 0; i < iniciadas; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    iniciadas = iniciadas > 0 ? iniciadas : 1;
+#endif
+
+    double segundos = (double)(agoraNanos() - inicio) / 1e9;
+
+    // Soma na ordem dos trabalhadores: o total nao depende do escalonamento
+    ResultadoSimulacao total = trabalhadores[0].resultado;
+    for (int t = 1; t < numThreads; t++) {
+        const ResultadoSimulacao* parcial = &trabalhadores[t].resultado;
+        total.sessoes += parcial->sessoes;
+        total.condenacoes += parcial->condenacoes;
+        total.acertos += parcial->acertos;
+        total.salasVisitadas += parcial->salasVisitadas;
+        total.movimentos += parcial->movimentos;
+        total.roubos += parcial->roubos;
+        for (uint32_t k = 0; k <= quantidade; k++) {
+            total.pistasPorSessao[k] += parcial->pistasPorSessao[k];
+        }
+        for (size_t s = 0; s < numSuspeitos; s++) {
+            total.acusacoes[s] += parcial->acusacoes[s];
+            total.condenados[s] += parcial->condenados[s];
+            total.condenaveis[s] += parcial->condenaveis[s];
+        }
+    }
+
+    exibirResultadoSimulacao(&simulacao, &total, maximoPistas);
+    fprintf(stderr, "sessoes=%llu condenacoes=%llu threads=%d roubos=%llu segundos=%.3f sessoes_por_segundo=%.0f sessoes_por_minuto=%.0f\n",
+            (unsigned long long)total.sessoes, (unsigned long long)total.condenacoes, iniciadas,
+            (unsigned long long)total.roubos, segundos, segundos > 0 ? (double)total.sessoes / segundos : 0.0,
+            segundos > 0 ? 60.0 * (double)total.sessoes / segundos : 0.0);
+
+    liberarArena(&arena);
+    return 1;
+}
+
+// --- Principal
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench-hash") == 0) {
+        executarBenchmarkHash();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-pistas") == 0) {
+        return executarBenchmarkPistasOrdenadas() ? 0 : 1;
+    }
+    
+    // Suite: --bench [--forma f] [--salas N] [--pistas M]; sem forma roda as tres
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        long numSalas = 100000;
+        long numPistas = 10000;
+        int formaEscolhida = -1;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "--salas") == 0) {
+                numSalas = strtol(argv[i + 1], NULL, 10);
+            } else if (strcmp(argv[i], "--pistas") == 0) {
+                numPistas = strtol(argv[i + 1], NULL, 10);
+            } else if (strcmp(argv[i], "--forma") == 0) {
+                FormaMansao forma;
+                if (!lerFormaMansao(argv[i + 1], &forma)) {
+                    return 1;
+                }
+                formaEscolhida = (int)forma;
+            }
+        }
+        if (numSalas < 1 || numSalas > INT32_MAX || numPistas < 0 || numPistas > INT32_MAX) {
+            printf("Erro: Tamanho de mansao invalido.\n");
+            return 1;
+        }
+
+        printf("caso,forma,salas,pistas,operacoes,ns_por_op,alocacoes,mallocs,rss_pico_caso_kb\n");
+        for (int f = 0; f < NUM_FORMAS_MANSAO; f++) {
+            if (formaEscolhida < 0 || formaEscolhida == f) {
+                executarSuiteBenchmark((FormaMansao)f, (uint32_t)numSalas, (uint32_t)numPistas);
+            }
+        }
+        return 0;
+    }
+
+    // Gerador: --gerar forma salas pistas saida.txt escreve um cenario de texto
+    if (argc > 5 && strcmp(argv[1], "--gerar") == 0) {
+        FormaMansao forma;
+        long numSalas = strtol(argv[3], NULL, 10);
+        long numPistas = strtol(argv[4], NULL, 10);
+        if (!lerFormaMansao(argv[2], &forma)) {
+            return 1;
+        }
+        if (numSalas < 1 || numSalas > INT32_MAX || numPistas < 0 || numPistas > INT32_MAX) {
+            printf("Erro: Tamanho de mansao invalido.\n");
+            return 1;
+        }
+
+        Arena arena;
+        inicializarArena(&arena);
+        Mansao mansao;
+        gerarMansaoSintetica(&arena, &mansao, forma, (uint32_t)numSalas, (uint32_t)numPistas, 12345);
+        int sucesso = escreverCenarioTexto(&mansao, argv[5]);
+        liberarArena(&arena);
+        return sucesso ? 0 : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "--compilar") == 0) {
+        return compilarCenario(argv[2], argv[3]) ? 0 : 1;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "--ler-eventos") == 0) {
+        return exibirLogEventos(argv[2]) ? 0 : 1;
+    }
+
+    // Tabelas do caso embutido, para colar no trecho gerado deste arquivo
+    if (argc > 1 && strcmp(argv[1], "--gerar-caso-embutido") == 0) {
+        return gerarCasoEmbutido(stdout) ? 0 : 1;
+    }
+    
+    // Modo headless: --roteiro arquivo [--transcricao saida] [--repetir N] [--verboso] [--threads T]
+    // Com mais de uma thread as sessoes rodam em paralelo, sem texto nem transcricao.
+    // Rotas: --rotas [--threads T] imprime a rota mais curta ate condenar cada
+    // suspeito; sem --threads usa todos os nucleos. So em arvores com pesos 1.
+    // Salvamento: --salvar base grava base.dqs e base.dqj e, se ja existirem,
+    // retoma a investigacao de onde parou.
+    // Instrumentacao: --estatisticas arquivo.json ("-" para a saida de erro)
+    // grava o JSON ao fim de cada sessao e a cada SIGUSR1
+    // Simulacao: --simular N [--politica aleatoria|gulosa] [--passos P]
+    // [--semente S] [--threads T] joga N partidas sem texto e resume como
+    // as pistas e as condenacoes se distribuem; sem --threads usa todos os nucleos.
+    // Procedural: --procedural semente [--salas N] [--cache C] joga numa
+    // mansao de ate N salas (por padrao, mais de 4 bilhoes) geradas so
+    // quando alcancadas, com no maximo C salas guardadas de cada vez.
+    // Eventos: --eventos arquivo grava salas, pistas, revisitas, acusacoes e
+    // fins de sessao num log binario, lido com --ler-eventos arquivo.
+    const char* caminhoRoteiro = NULL;
+    const char* caminhoTranscricao = NULL;
+    const char* caminhoCenario = NULL;
+    const char* caminhoSalvamento = NULL;
+    const char* caminhoEstatisticas = NULL;
+    const char* caminhoEventos = NULL;
+    long repeticoes = 1;
+    int verboso = 0;
+    int numThreads = 1;
+    int threadsInformadas = 0;
+    int planejar = 0;
+    long simulacoes = 0;
+    PoliticaSimulacao politica = POLITICA_GULOSA;
+    long passos = PASSOS_SIMULACAO;
+    uint32_t semente = 12345;
+    int procedural = 0;
+    uint32_t sementeProcedural = 0;
+    unsigned long long salasProcedurais = SALAS_PROCEDURAIS;
+    long capacidadeCache = CAPACIDADE_CACHE_PROCEDURAL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--roteiro") == 0 && i + 1 < argc) {
+            caminhoRoteiro = argv[++i];
+        } else if (strcmp(argv[i], "--transcricao") == 0 && i + 1 < argc) {
+            caminhoTranscricao = argv[++i];
+        } else if (strcmp(argv[i], "--repetir") == 0 && i + 1 < argc) {
+            repeticoes = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+            threadsInformadas = 1;
+        } else if (strcmp(argv[i], "--salvar") == 0 && i + 1 < argc) {
+            caminhoSalvamento = argv[++i];
+        } else if (strcmp(argv[i], "--estatisticas") == 0 && i + 1 < argc) {
+            caminhoEstatisticas = argv[++i];
+        } else if (strcmp(argv[i], "--eventos") == 0 && i + 1 < argc) {
+            caminhoEventos = argv[++i];
+        } else if (strcmp(argv[i], "--rotas") == 0) {
+            planejar = 1;
+        } else if (strcmp(argv[i], "--simular") == 0 && i + 1 < argc) {
+            simulacoes = strtol(argv[++i], NULL, 10);
+            if (simulacoes < 1) {
+                printf("Erro: Numero de sessoes simuladas invalido.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--politica") == 0 && i + 1 < argc) {
+            if (!lerPoliticaSimulacao(argv[++i], &politica)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--passos") == 0 && i + 1 < argc) {
+            passos = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--semente") == 0 && i + 1 < argc) {
+            semente = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--procedural") == 0 && i + 1 < argc) {
+            procedural = 1;
+            sementeProcedural = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--salas") == 0 && i + 1 < argc) {
+            salasProcedurais = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            capacidadeCache = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--verboso") == 0) {
+            verboso = 1;
+        } else {
+            caminhoCenario = argv[i];
+        }
+    }
+    if (repeticoes < 1 || numThreads < 1) {
+        printf("Erro: Numero de repeticoes ou de threads invalido.\n");
+        return 1;
+    }
+    if (caminhoSalvamento != NULL && (repeticoes > 1 || numThreads > 1)) {
+        printf("Erro: --salvar vale para uma unica sessao.\n");
+        return 1;
+    }
+    if (caminhoEstatisticas != NULL && numThreads > 1) {
+        printf("Erro: --estatisticas nao vale para sessoes em paralelo.\n");
+        return 1;
+    }
+    if (simulacoes > 0 && (caminhoRoteiro != NULL || caminhoSalvamento != NULL || caminhoEstatisticas != NULL || planejar)) {
+        printf("Erro: --simular nao combina com --roteiro, --salvar, --estatisticas nem --rotas.\n");
+        return 1;
+    }
+    if (caminhoEventos != NULL && planejar) {
+        printf("Erro: --eventos nao combina com --rotas.\n");
+        return 1;
+    }
+    if (passos < 0 || passos > INT32_MAX) {
+        printf("Erro: Numero de passos invalido.\n");
+        return 1;
+    }
+    if (procedural) {
+        if (caminhoCenario != NULL || caminhoSalvamento != NULL) {
+            printf("Erro: --procedural nao combina com um cenario nem com --salvar.\n");
+            return 1;
+        }
+        if (salasProcedurais < 1 || salasProcedurais > SALAS_PROCEDURAIS || capacidadeCache < VIAS_CACHE_PROCEDURAL ||
+            capacidadeCache > MAXIMO_SALAS) {
+            printf("Erro: Tamanho de mansao procedural ou de cache invalido.\n");
+            return 1;
+        }
+    }
+
+    Arena arena;
+    inicializarArena(&arena);
+    Estatisticas estatisticas;
+    iniciarEstatisticas(&estatisticas, caminhoEstatisticas, &arena);
+    Estatisticas* instrumentacao = caminhoEstatisticas != NULL ? &estatisticas : NULL;
+
+    // Sem cenario joga o caso embutido; com um caminho, carrega o cenario
+    // (texto ou compilado, detectado pela assinatura do arquivo)
+    Mansao mansao;
+    TabelaHash* tabelaHash;
+    if (procedural) {
+        criarMansaoProcedural(&arena, &mansao, sementeProcedural, (uint32_t)salasProcedurais, (uint32_t)capacidadeCache);
+        tabelaHash = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+        carregarPistasDaMansao(tabelaHash, &mansao);
+    } else if (caminhoCenario != NULL) {
+        if (!carregarCenario(&arena, caminhoCenario, &mansao)) {
+            liberarArena(&arena);
+            return 1;
+        }
+        // O compilado traz a tabela pronta; no texto, a carga em lote
+        // dimensiona a tabela para o total de pistas
+        if (mansao.mapeamento != NULL) {
+            tabelaHash = abrirTabelaDoCenario(&arena, &mansao);
+        } else {
+            tabelaHash = criarTabelaHash(&arena, CAPACIDADE_INICIAL_HASH);
+            carregarPistasDaMansao(tabelaHash, &mansao);
+        }
+    } else {
+        montarMapaMansao(&arena, &mansao);
+        tabelaHash = abrirTabelaEmbutida(&arena);
+    }
+    internarPistasDaMansao(tabelaHash, &mansao);
+    // So depois da carga: as sondagens medidas sao as das consultas do jogo
+    tabelaHash->estatisticas = instrumentacao;
+
+    // A transcricao vai para a saida padrao no modo headless, salvo se pedida em arquivo
+    FILE* transcricao = NULL;
+    if (caminhoTranscricao != NULL) {
+        transcricao = fopen(caminhoTranscricao, "w");
+        if (transcricao == NULL) {
+            printf("Erro: Nao foi possivel criar a transcricao %s.\n", caminhoTranscricao);
+            liberarMansao(&mansao);
+            liberarArena(&arena);
+            return 1;
+        }
+    } else if (caminhoRoteiro != NULL) {
+        transcricao = stdout;
+    }
+
+    Salvamento salvamento;
+    if (caminhoSalvamento != NULL) {
+        abrirSalvamento(&salvamento, &arena, caminhoSalvamento, &mansao);
+    }
+
+    // Um anel por thread de jogo: o simulador sem --threads usa todos os nucleos
+    int threadsDeJogo = simulacoes > 0 && !threadsInformadas ? numeroDeNucleos() : numThreads;
+    FluxoEventos fluxoEventos;
+    FluxoEventos* eventos = NULL;
+    if (caminhoEventos != NULL) {
+        if (!abrirFluxoEventos(&fluxoEventos, &arena, caminhoEventos, threadsDeJogo)) {
+            if (transcricao != NULL && transcricao != stdout) {
+                fclose(transcricao);
+            }
+            liberarMansao(&mansao);
+            liberarArena(&arena);
+            return 1;
+        }
+        eventos = &fluxoEventos;
+    }
+
+    int sucesso = 1;
+    if (simulacoes > 0) {
+        sucesso = simularPartidas(&mansao, tabelaHash, simulacoes, politica, (uint32_t)passos, semente, threadsDeJogo, eventos);
+    } else if (planejar) {
+        sucesso = planejarRotas(&mansao, tabelaHash, threadsInformadas ? numThreads : numeroDeNucleos());
+    } else if (caminhoRoteiro != NULL) {
+        size_t tamanhoRoteiro;
+        char* roteiro = lerArquivoNaArena(&arena, caminhoRoteiro, &tamanhoRoteiro);
+        if (roteiro != NULL && numThreads > 1) {
+            sucesso = executarSessoesParalelas(&mansao, tabelaHash, roteiro, tamanhoRoteiro, repeticoes, numThreads, eventos);
+        } else {
+            sucesso = roteiro != NULL &&
+                      executarRoteiro(&mansao, tabelaHash, roteiro, tamanhoRoteiro,
+                                      verboso ? stderr : NULL, transcricao, repeticoes,
+                                      caminhoSalvamento != NULL ? &salvamento : NULL, instrumentacao, eventos);
+        }
+    } else {
+        Terminal terminal;
+        iniciarTerminal(&terminal, NULL, 0, 1, stdout, transcricao);
+        Arena arenaSessao;
+        inicializarArena(&arenaSessao);
+        CacheSalas* cache = criarCacheSalas(&arena, &mansao);
+
+        Sessao sessao;
+        iniciarSessao(&sessao, &arenaSessao, &mansao, cache, tabelaHash, &terminal);
+        if (caminhoSalvamento != NULL) {
+            sessao.salvamento = &salvamento;
+            sucesso = retomarSessao(&sessao, verboso ? stderr : NULL);
+        }
+        if (sucesso) {
+            if (instrumentacao != NULL) {
+                instrumentarSessao(&sessao, instrumentacao);
+            }
+            sessao.eventos = eventos != NULL ? &eventos->aneis[0] : NULL;
+            jogarSessao(&sessao);
+        } else {
+            liberarArena(&arenaSessao);
+        }
+        if (verboso) {
+            relatarCacheSalas(stderr, &mansao, cache);
+        }
+        liberarTerminal(&terminal);
+    }
+
+    if (caminhoSalvamento != NULL) {
+        fecharSalvamento(&salvamento);
+    }
+    if (eventos != NULL && !fecharFluxoEventos(eventos, stderr)) {
+        sucesso = 0;
+    }
+
+    if (transcricao != NULL && transcricao != stdout) {
+        fclose(transcricao);
+    }
+    liberarMansao(&mansao);
+    liberarArena(&arena);
+    return sucesso ? 0 : 1;
+}